@@ -0,0 +1,311 @@
+/*
+ * captura.h
+ *
+ * Formato de captura do enlace: bytes com instante e sentido, em blocos
+ * com indice, para reproduzir no PC o trafego (e o ritmo) que deu
+ * problema em campo. O arquivo e lido por mmap, sem copia: os registros
+ * apontam direto para o mapa.
+ *
+ * Layout (little-endian, sem alinhamento garantido dentro dos blocos):
+ *
+ *  cabecalho (32 bytes)
+ *    "FSMCAP1\0"  u16 versao  u16 reservado  u32 unidade_ns
+ *    u64 t0 (instante do 1o registro, em unidades)  u64 indice_off
+ *  bloco, repetido (ate CAP_BLOCO bytes cada)
+ *    u32 "BLOC"  u32 tam (bloco inteiro)  u32 regs  u32 bytes  u64 t_ini
+ *    registro, repetido:
+ *      u32 dt (unidades desde o registro anterior; o 1o e relativo a t_ini)
+ *      u16 n | sentido << 15 (n ate CAP_REG_MAX)
+ *      n bytes do enlace
+ *  indice (em indice_off), uma entrada por bloco
+ *    u64 off  u64 t_ini  u64 byte_ini (bytes antes do bloco)  u32 regs  u32 bytes
+ *
+ * indice_off e gravado no fechamento; se a gravacao foi interrompida ele
+ * fica 0 e cap_mapeia() refaz o indice percorrendo os blocos inteiros.
+ * Um dt que nao cabe em 32 bits abre um bloco novo (t_ini e absoluto).
+ */
+
+#ifndef CAPTURA_H_
+#define CAPTURA_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CAP_MAGICO     "FSMCAP1"
+#define CAP_VERSAO     1
+#define CAP_CAB        32
+#define CAP_BLOCO_CAB  24
+#define CAP_REG_CAB    6
+#define CAP_BLOCO      (64u * 1024u)
+#define CAP_REG_MAX    0x7FFF
+#define CAP_IDX_TAM    32
+
+enum { CAP_RX = 0, CAP_TX = 1 };   // sentido: recebido / enviado pelo alvo
+
+typedef struct {
+    uint64_t off, t_ini, byte_ini;
+    uint32_t regs, bytes;
+} CapIndice;
+
+static inline void cap_poe16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static inline void cap_poe32(uint8_t* p, uint32_t v) { cap_poe16(p, (uint16_t)v); cap_poe16(p + 2, (uint16_t)(v >> 16)); }
+static inline void cap_poe64(uint8_t* p, uint64_t v) { cap_poe32(p, (uint32_t)v); cap_poe32(p + 4, (uint32_t)(v >> 32)); }
+static inline uint16_t cap_le16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+static inline uint32_t cap_le32(const uint8_t* p) { return cap_le16(p) | (uint32_t)cap_le16(p + 2) << 16; }
+static inline uint64_t cap_le64(const uint8_t* p) { return cap_le32(p) | (uint64_t)cap_le32(p + 4) << 32; }
+
+// ---------------- Gravacao ----------------
+
+typedef struct {
+    FILE* f;
+    uint32_t unidade_ns;
+    uint64_t off;           // posicao do bloco aberto no arquivo
+    uint64_t t_ult;         // instante do ultimo registro
+    uint64_t bytes;         // bytes do enlace ja gravados
+    bool vazio;             // nenhum registro ainda (t0 pendente)
+    uint8_t bloco[CAP_BLOCO];
+    size_t usado;           // 0 = nenhum bloco aberto
+    CapIndice* idx;
+    size_t qtd, max;
+} CapEscritor;
+
+static inline bool cap_abre(CapEscritor* w, const char* nome, uint32_t unidade_ns) {
+    uint8_t c[CAP_CAB] = {0};
+    w->idx = NULL;
+    w->qtd = w->max = w->usado = 0;
+    w->t_ult = w->bytes = 0;
+    w->vazio = true;
+    w->unidade_ns = unidade_ns;
+    w->off = CAP_CAB;
+    if (!(w->f = fopen(nome, "wb"))) return false;
+    memcpy(c, CAP_MAGICO, 8);
+    cap_poe16(&c[8], CAP_VERSAO);
+    cap_poe32(&c[12], unidade_ns);
+    return fwrite(c, 1, CAP_CAB, w->f) == CAP_CAB;
+}
+
+static inline bool cap_fecha_bloco(CapEscritor* w) {
+    if (w->usado == 0) return true;
+    CapIndice* e = &w->idx[w->qtd - 1];
+    cap_poe32(&w->bloco[4], (uint32_t)w->usado);
+    cap_poe32(&w->bloco[8], e->regs);
+    cap_poe32(&w->bloco[12], e->bytes);
+    bool ok = fwrite(w->bloco, 1, w->usado, w->f) == w->usado;
+    w->off += w->usado;
+    w->usado = 0;
+    return ok;
+}
+
+static inline bool cap_abre_bloco(CapEscritor* w, uint64_t t) {
+    if (!cap_fecha_bloco(w)) return false;
+    if (w->qtd == w->max) {
+        w->max = w->max ? 2 * w->max : 256;
+        CapIndice* n = realloc(w->idx, w->max * sizeof(CapIndice));
+        if (!n) return false;
+        w->idx = n;
+    }
+    w->idx[w->qtd++] = (CapIndice){w->off, t, w->bytes, 0, 0};
+    memcpy(w->bloco, "BLOC", 4);
+    cap_poe64(&w->bloco[16], t);
+    w->usado = CAP_BLOCO_CAB;
+    w->t_ult = t;
+    return true;
+}
+
+// Grava "n" bytes que passaram pelo enlace no instante "t" (unidades,
+// nao decrescente). Rajadas maiores que CAP_REG_MAX viram varios registros.
+static inline bool cap_grava(CapEscritor* w, uint64_t t, int sentido,
+                             const uint8_t* d, size_t n) {
+    if (w->vazio) {
+        uint8_t t0[8];
+        cap_poe64(t0, t);
+        if (fseek(w->f, 16, SEEK_SET) || fwrite(t0, 1, 8, w->f) != 8 || fseek(w->f, 0, SEEK_END)) return false;
+        w->vazio = false;
+    }
+    if (t < w->t_ult) t = w->t_ult;
+    do {
+        size_t k = (n < CAP_REG_MAX) ? n : CAP_REG_MAX;
+        if (w->usado == 0 || w->usado + CAP_REG_CAB + k > CAP_BLOCO || t - w->t_ult > UINT32_MAX) {
+            if (!cap_abre_bloco(w, t)) return false;
+        }
+        uint8_t* r = &w->bloco[w->usado];
+        cap_poe32(r, (uint32_t)(t - w->t_ult));
+        cap_poe16(r + 4, (uint16_t)(k | (sentido ? 0x8000u : 0)));
+        memcpy(r + CAP_REG_CAB, d, k);
+        w->usado += CAP_REG_CAB + k;
+        w->t_ult = t;
+        w->idx[w->qtd - 1].regs++;
+        w->idx[w->qtd - 1].bytes += (uint32_t)k;
+        w->bytes += k;
+        d += k;
+        n -= k;
+    } while (n);
+    return true;
+}
+
+// Fecha o ultimo bloco, grava o indice e o aponta no cabecalho.
+static inline bool cap_fecha(CapEscritor* w) {
+    bool ok = cap_fecha_bloco(w);
+    uint64_t idx_off = w->off;
+    for (size_t i = 0; ok && i < w->qtd; i++) {
+        uint8_t e[CAP_IDX_TAM];
+        cap_poe64(&e[0], w->idx[i].off);
+        cap_poe64(&e[8], w->idx[i].t_ini);
+        cap_poe64(&e[16], w->idx[i].byte_ini);
+        cap_poe32(&e[24], w->idx[i].regs);
+        cap_poe32(&e[28], w->idx[i].bytes);
+        ok = fwrite(e, 1, CAP_IDX_TAM, w->f) == CAP_IDX_TAM;
+    }
+    uint8_t o[8];
+    cap_poe64(o, idx_off);
+    ok = ok && fseek(w->f, 24, SEEK_SET) == 0 && fwrite(o, 1, 8, w->f) == 8;
+    ok = (fclose(w->f) == 0) && ok;
+    free(w->idx);
+    return ok;
+}
+
+// ---------------- Leitura (mmap) ----------------
+
+typedef struct {
+    const uint8_t* mapa;
+    size_t tam;
+    uint32_t unidade_ns;
+    uint64_t t0;
+    CapIndice* idx;
+    size_t qtd;
+    bool refeito;           // indice refeito (gravacao interrompida)
+} CapLeitor;
+
+// Um registro, apontando para dentro do mapa.
+typedef struct {
+    uint64_t t;
+    int sentido;
+    const uint8_t* d;
+    uint16_t n;
+} CapRegistro;
+
+typedef struct {
+    size_t bloco;           // indice do bloco atual
+    size_t off;             // proximo registro, relativo ao bloco
+    uint64_t t;             // instante do registro anterior
+} CapCursor;
+
+// Bloco valido em "off"? Retorna o tamanho, ou 0.
+static inline uint32_t cap_bloco_ok(const CapLeitor* l, uint64_t off) {
+    if (off + CAP_BLOCO_CAB > l->tam || memcmp(&l->mapa[off], "BLOC", 4) != 0) return 0;
+    uint32_t tam = cap_le32(&l->mapa[off + 4]);
+    return (tam >= CAP_BLOCO_CAB && off + tam <= l->tam) ? tam : 0;
+}
+
+static inline void cap_desmapeia(CapLeitor* l) {
+    if (l->mapa) munmap((void*)l->mapa, l->tam);
+    free(l->idx);
+    memset(l, 0, sizeof(*l));
+}
+
+static inline bool cap_mapeia(CapLeitor* l, const char* nome) {
+    memset(l, 0, sizeof(*l));
+    int fd = open(nome, O_RDONLY);
+    struct stat st;
+    if (fd < 0) return false;
+    if (fstat(fd, &st) != 0 || st.st_size < CAP_CAB) {
+        close(fd);
+        return false;
+    }
+    l->tam = (size_t)st.st_size;
+    void* m = mmap(NULL, l->tam, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return false;
+    l->mapa = m;
+    if (memcmp(l->mapa, CAP_MAGICO, 8) != 0 || cap_le16(&l->mapa[8]) != CAP_VERSAO) {
+        cap_desmapeia(l);
+        return false;
+    }
+    l->unidade_ns = cap_le32(&l->mapa[12]);
+    l->t0 = cap_le64(&l->mapa[16]);
+    uint64_t idx_off = cap_le64(&l->mapa[24]);
+
+    if (idx_off && idx_off <= l->tam && (l->tam - idx_off) % CAP_IDX_TAM == 0) {
+        l->qtd = (l->tam - idx_off) / CAP_IDX_TAM;
+        l->idx = malloc((l->qtd ? l->qtd : 1) * sizeof(CapIndice));
+        for (size_t i = 0; l->idx && i < l->qtd; i++) {
+            const uint8_t* e = &l->mapa[idx_off + i * CAP_IDX_TAM];
+            l->idx[i] = (CapIndice){cap_le64(e), cap_le64(e + 8), cap_le64(e + 16),
+                                    cap_le32(e + 24), cap_le32(e + 28)};
+            if (!cap_bloco_ok(l, l->idx[i].off)) l->qtd = 0;   // indice nao bate: refaz
+        }
+        if (l->idx && l->qtd) return true;
+        free(l->idx);
+        l->idx = NULL;
+    }
+
+    // sem indice: percorre os blocos ate o primeiro invalido
+    size_t max = 0;
+    uint64_t off = CAP_CAB, bytes = 0;
+    uint32_t tam;
+    l->qtd = 0;
+    l->refeito = true;
+    while ((tam = cap_bloco_ok(l, off)) != 0) {
+        if (l->qtd == max) {
+            max = max ? 2 * max : 256;
+            CapIndice* n = realloc(l->idx, max * sizeof(CapIndice));
+            if (!n) {
+                cap_desmapeia(l);
+                return false;
+            }
+            l->idx = n;
+        }
+        const uint8_t* b = &l->mapa[off];
+        l->idx[l->qtd++] = (CapIndice){off, cap_le64(b + 16), bytes, cap_le32(b + 8), cap_le32(b + 12)};
+        bytes += cap_le32(b + 12);
+        off += tam;
+    }
+    return true;
+}
+
+// Primeiro bloco que pode conter o instante "t" (busca binaria no indice).
+static inline size_t cap_bloco_em(const CapLeitor* l, uint64_t t) {
+    size_t a = 0, b = l->qtd;
+    while (b - a > 1) {
+        size_t m = (a + b) / 2;
+        if (l->idx[m].t_ini <= t) a = m; else b = m;
+    }
+    return a;
+}
+
+static inline void cap_cursor(const CapLeitor* l, CapCursor* c, size_t bloco) {
+    c->bloco = bloco;
+    c->off = CAP_BLOCO_CAB;
+    c->t = (bloco < l->qtd) ? l->idx[bloco].t_ini : 0;
+}
+
+// Proximo registro; false no fim da captura (ou num bloco truncado).
+static inline bool cap_proximo(const CapLeitor* l, CapCursor* c, CapRegistro* r) {
+    while (c->bloco < l->qtd) {
+        const uint8_t* b = &l->mapa[l->idx[c->bloco].off];
+        uint32_t tam = cap_le32(b + 4);
+        if (c->off + CAP_REG_CAB <= tam) {
+            const uint8_t* p = b + c->off;
+            uint16_t nd = cap_le16(p + 4);
+            r->n = nd & CAP_REG_MAX;
+            if (c->off + CAP_REG_CAB + r->n > tam) return false;
+            c->t += cap_le32(p);
+            r->t = c->t;
+            r->sentido = nd >> 15;
+            r->d = p + CAP_REG_CAB;
+            c->off += CAP_REG_CAB + r->n;
+            return true;
+        }
+        cap_cursor(l, c, c->bloco + 1);
+    }
+    return false;
+}
+
+#endif /* CAPTURA_H_ */
@@ -0,0 +1,151 @@
+/*
+ * grava.c
+ *
+ * Grava capturas no formato de captura.h e mostra o conteudo de uma.
+ *
+ * Uso:
+ *  gcc -O2 Captura/grava.c -o grava
+ *  ./grava [-d rx|tx] saida.cap < /dev/ttyUSB0
+ *      ao vivo: cada read() vira um registro com o instante de chegada
+ *      (CLOCK_MONOTONIC, em us). Ctrl-C fecha o arquivo com o indice.
+ *      A porta deve estar em modo cru (stty -F /dev/ttyUSB0 raw 115200).
+ *  ./grava -c fluxo.bin [-B baud] [-F fifo] saida.cap
+ *      converte um fluxo cru (Fuzz/pior/media.bin, captura do paralelo...)
+ *      com o ritmo de uma UART de "baud" 8N1 (padrao 115200) lida em
+ *      rajadas de "fifo" bytes (padrao 16), em ns.
+ *  ./grava -i captura.cap
+ *      cabecalho, blocos, registros, bytes por sentido e duracao.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include "captura.h"
+
+static volatile sig_atomic_t para;
+
+static void ao_sinal(int s) {
+    (void)s;
+    para = 1;
+}
+
+static int ao_vivo(const char* saida, int sentido) {
+    static CapEscritor w;
+    static uint8_t buf[4096];
+    if (!cap_abre(&w, saida, 1000)) {
+        perror(saida);
+        return 1;
+    }
+    struct sigaction sa = {0};
+    sa.sa_handler = ao_sinal;   // sem SA_RESTART: o read() volta com EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    uint64_t total = 0;
+    while (!para) {
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        if (!cap_grava(&w, (uint64_t)t.tv_sec * 1000000u + (uint64_t)t.tv_nsec / 1000u,
+                       sentido, buf, (size_t)n)) {
+            perror("gravando");
+            break;
+        }
+        total += (uint64_t)n;
+    }
+    if (!cap_fecha(&w)) {
+        perror("fechando");
+        return 1;
+    }
+    fprintf(stderr, "%s: %llu bytes\n", saida, (unsigned long long)total);
+    return 0;
+}
+
+static int converte(const char* entrada, const char* saida, uint32_t baud, uint32_t fifo) {
+    static CapEscritor w;
+    FILE* f = fopen(entrada, "rb");
+    if (!f) {
+        perror(entrada);
+        return 1;
+    }
+    if (!cap_abre(&w, saida, 1)) {
+        perror(saida);
+        fclose(f);
+        return 1;
+    }
+    uint8_t buf[CAP_REG_MAX];
+    uint64_t t = 0, total = 0;
+    size_t n;
+    bool ok = true;
+    if (fifo == 0 || fifo > sizeof(buf)) fifo = 16;
+    while ((n = fread(buf, 1, fifo, f)) > 0) {
+        t += (uint64_t)n * 10u * 1000000000u / baud;   // 10 bits por byte
+        if (!cap_grava(&w, t, CAP_RX, buf, n)) {
+            perror("gravando");
+            ok = false;
+            break;
+        }
+        total += n;
+    }
+    fclose(f);
+    if (!cap_fecha(&w)) {
+        perror(saida);
+        return 1;
+    }
+    if (!ok) return 1;                 // captura truncada, mas com indice
+    printf("%s: %llu bytes, %.3f s a %u baud\n", saida, (unsigned long long)total, t * 1e-9, baud);
+    return 0;
+}
+
+static int mostra(const char* nome) {
+    CapLeitor l;
+    if (!cap_mapeia(&l, nome)) {
+        fprintf(stderr, "%s: nao e uma captura\n", nome);
+        return 1;
+    }
+    CapCursor c;
+    CapRegistro r;
+    uint64_t regs = 0, bytes[2] = {0, 0}, t_fim = l.t0;
+    cap_cursor(&l, &c, 0);
+    while (cap_proximo(&l, &c, &r)) {
+        regs++;
+        bytes[r.sentido] += r.n;
+        t_fim = r.t;
+    }
+    printf("%s: %zu bytes, unidade %u ns%s\n", nome, l.tam, l.unidade_ns,
+           l.refeito ? " (sem indice: gravacao interrompida, indice refeito)" : "");
+    printf("  %zu blocos, %llu registros, rx %llu bytes, tx %llu bytes\n", l.qtd,
+           (unsigned long long)regs, (unsigned long long)bytes[CAP_RX], (unsigned long long)bytes[CAP_TX]);
+    printf("  duracao %.6f s\n", (double)(t_fim - l.t0) * l.unidade_ns * 1e-9);
+    cap_desmapeia(&l);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* cru = NULL;
+    uint32_t baud = 115200, fifo = 16;
+    int sentido = CAP_RX, opt;
+    bool info = false, uso = false;
+    while ((opt = getopt(argc, argv, "d:c:B:F:i")) != -1) {
+        switch (opt) {
+            case 'd': sentido = strcmp(optarg, "tx") == 0 ? CAP_TX : CAP_RX; break;
+            case 'c': cru = optarg; break;
+            case 'B': baud = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'F': fifo = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'i': info = true; break;
+            default: uso = true; break;
+        }
+    }
+    if (uso || optind != argc - 1 || baud == 0) {
+        fprintf(stderr, "uso: %s [-d rx|tx] saida.cap < porta\n"
+                        "     %s -c fluxo.bin [-B baud] [-F fifo] saida.cap\n"
+                        "     %s -i captura.cap\n", argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    if (info) return mostra(argv[optind]);
+    if (cru) return converte(cru, argv[optind], baud, fifo);
+    return ao_vivo(argv[optind], sentido);
+}
@@ -0,0 +1,256 @@
+/*
+ * reproduz.c
+ *
+ * Reproduz uma captura (captura.h) num dos receptores do repositorio, no
+ * ritmo original ou na velocidade maxima. Serve para medir os receptores
+ * com trafego real e para achar, por bissecao, o commit ou o trecho da
+ * captura onde o comportamento mudou (compare as saidas de -l).
+ *
+ * Alvos (um por binario):
+ *  - rx_handle_byte() de FSM.c (padrao), byte a byte. ALVO_MODO escolhe o
+ *    CHK, ALVO_EXT=1 liga quadros estendidos e ALVO_BLOCO=1 entrega cada
+ *    registro inteiro a rx_handle_bytes(), como um driver de UART/DMA.
+ *  - fsm_process() de "FSM e ponteiro/fsm.c" (-DALVO_PONTEIRO); a maquina
+ *    e reiniciada em DONE/ERROR.
+ *  - fila ch_data e rx_thread() de Protothreads/main.c
+ *    (-DALVO_PROTOTHREADS); os quadros OK sao os ACKs em ch_ctrl, falhas
+ *    nao sao visiveis.
+ *
+ * Uso:
+ *  gcc -O2 Captura/reproduz.c -o reproduz
+ *  gcc -O2 -DALVO_PONTEIRO Captura/reproduz.c -o reproduz_ponteiro
+ *  gcc -O2 -pthread -DALVO_PROTOTHREADS Captura/reproduz.c -o reproduz_pt
+ *  ./reproduz [opcoes] captura.cap
+ * Opcoes:
+ *  -r        ritmo original (padrao: velocidade maxima)
+ *  -x fator  com -r, acelera (2 = duas vezes mais rapido)
+ *  -d s      rx | tx | ambos: sentido entregue ao receptor (padrao rx)
+ *  -i s      comeca s segundos depois do inicio da captura (usa o indice)
+ *  -f s      para s segundos depois do inicio da captura
+ *  -n N      repete N vezes (velocidade maxima; para medir)
+ *  -l        lista os eventos: instante(s) OK|FAIL
+ */
+
+#define _GNU_SOURCE
+#include <time.h>
+
+#include "captura.h"
+
+#define FSM_SEM_MAIN
+#if defined(ALVO_PONTEIRO)
+#include "../FSM e ponteiro/fsm.c"
+#elif defined(ALVO_PROTOTHREADS)
+#include "../Protothreads/main.c"
+#else
+#include "../FSM.c"
+#ifndef ALVO_MODO
+#define ALVO_MODO CHK_XOR
+#endif
+#ifndef ALVO_EXT
+#define ALVO_EXT 0
+#endif
+#ifndef ALVO_BLOCO
+#define ALVO_BLOCO 0
+#endif
+#endif
+
+typedef struct {
+    uint64_t ok, falhas, bytes;
+    bool lista;
+    double seg;             // instante do registro atual (para -l)
+} Contagem;
+
+static void conta(Contagem* c, bool ok) {
+    if (ok) c->ok++; else c->falhas++;
+    if (c->lista) printf("%.9f %s\n", c->seg, ok ? "OK" : "FAIL");
+}
+
+// ---------------- Alvos ----------------
+#if defined(ALVO_PONTEIRO)
+#define ALVO_NOME "fsm_process (FSM e ponteiro)"
+static FSM alvo;
+
+static void alvo_inicia(void) { fsm_init(&alvo); }
+
+static void alvo_registro(const uint8_t* d, size_t n, Contagem* c) {
+    for (size_t i = 0; i < n; i++) {
+        fsm_process(&alvo, d[i]);
+        if (alvo.state == ST_DONE || alvo.state == ST_ERROR) {
+            conta(c, alvo.state == ST_DONE);
+            fsm_libera(&alvo);
+            fsm_init(&alvo);
+        }
+    }
+}
+#elif defined(ALVO_PROTOTHREADS)
+#define ALVO_NOME "rx_thread (Protothreads, ch_data)"
+static rx_ctx_t alvo;
+
+static void alvo_inicia(void) {
+    q_init(&ch_data);
+    q_init(&ch_ctrl);
+    rx_init(&alvo);
+}
+
+// O registro entra na fila em trechos (q_reserve/q_commit) e a protothread
+// roda ate esvaziar a fila; cada ACK e um quadro OK.
+static void alvo_registro(const uint8_t* d, size_t n, Contagem* c) {
+    uint8_t ack;
+    while (n) {
+        uint8_t* p;
+        int k = q_reserve(&ch_data, &p);
+        if ((size_t)k > n) k = (int)n;
+        memcpy(p, d, (size_t)k);
+        q_commit(&ch_data, k);
+        d += k;
+        n -= (size_t)k;
+        while (q_size(&ch_data) > 0) {
+            rx_thread(&alvo);
+            while (ctrl_recv_ack(&ack)) conta(c, true);
+        }
+    }
+}
+#else
+#define ALVO_NOME (ALVO_BLOCO ? "rx_handle_bytes (FSM.c)" : "rx_handle_byte (FSM.c)")
+static FSM_Rx alvo;
+#if ALVO_EXT
+static uint8_t alvo_ext[FRAME_EXT_MAX];
+#endif
+
+static void alvo_inicia(void) {
+    rx_reset(&alvo);
+    rx_configura_chk(&alvo, ALVO_MODO);
+#if ALVO_EXT
+    rx_configura_ext(&alvo, alvo_ext, sizeof(alvo_ext));
+#endif
+}
+
+#if ALVO_BLOCO
+static void alvo_evento(void* ctx, FrameResult r, size_t offset,
+                        const uint8_t* dados, uint16_t n) {
+    (void)offset; (void)dados; (void)n;
+    conta(ctx, r == FRAME_OK);
+}
+
+static void alvo_registro(const uint8_t* d, size_t n, Contagem* c) {
+    rx_handle_bytes(&alvo, d, n, alvo_evento, c);
+}
+#else
+static void alvo_registro(const uint8_t* d, size_t n, Contagem* c) {
+    for (size_t i = 0; i < n; i++) {
+        FrameResult r = rx_handle_byte(&alvo, d[i]);
+        if (r != FRAME_PROGRESS) conta(c, r == FRAME_OK);
+    }
+}
+#endif
+#endif
+
+// ---------------- Reproducao ----------------
+
+static uint64_t agora_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+typedef struct {
+    bool ritmo;
+    double fator;
+    int sentido;            // CAP_RX, CAP_TX ou -1 (ambos)
+    uint64_t t_ini, t_fim;  // janela, em unidades da captura (absoluto)
+} Opcoes;
+
+typedef struct {
+    uint64_t ns;            // tempo dentro do receptor
+    uint64_t atraso_max;    // com -r: maior atraso de entrega sobre o ritmo
+    uint64_t atraso_soma, registros;
+} Medida;
+
+static void reproduz(const CapLeitor* l, const Opcoes* o, Contagem* c, Medida* m) {
+    CapCursor cur;
+    CapRegistro r;
+    uint64_t w0 = 0, t_base = 0;
+    bool primeiro = true;
+    cap_cursor(l, &cur, cap_bloco_em(l, o->t_ini));
+    alvo_inicia();
+    while (cap_proximo(l, &cur, &r)) {
+        if (r.t < o->t_ini) continue;
+        if (r.t > o->t_fim) break;
+        if (o->sentido >= 0 && r.sentido != o->sentido) continue;
+        if (o->ritmo) {
+            if (primeiro) {
+                w0 = agora_ns();
+                t_base = r.t;
+                primeiro = false;
+            }
+            uint64_t alvo_ns = w0 + (uint64_t)((r.t - t_base) * (double)l->unidade_ns / o->fator);
+            struct timespec ts = {(time_t)(alvo_ns / 1000000000u), (long)(alvo_ns % 1000000000u)};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            uint64_t atraso = agora_ns() - alvo_ns;
+            if (atraso > m->atraso_max) m->atraso_max = atraso;
+            m->atraso_soma += atraso;
+        }
+        c->seg = (double)(r.t - l->t0) * l->unidade_ns * 1e-9;
+        uint64_t t0 = agora_ns();
+        alvo_registro(r.d, r.n, c);
+        m->ns += agora_ns() - t0;
+        c->bytes += r.n;
+        m->registros++;
+    }
+}
+
+int main(int argc, char** argv) {
+    Opcoes o = {false, 1.0, CAP_RX, 0, UINT64_MAX};
+    double ini_s = 0, fim_s = -1;
+    int repete = 1, opt;
+    bool lista = false, uso = false;
+    while ((opt = getopt(argc, argv, "rx:d:i:f:n:l")) != -1) {
+        switch (opt) {
+            case 'r': o.ritmo = true; break;
+            case 'x': o.fator = atof(optarg); break;
+            case 'd':
+                o.sentido = strcmp(optarg, "tx") == 0 ? CAP_TX : strcmp(optarg, "ambos") == 0 ? -1 : CAP_RX;
+                break;
+            case 'i': ini_s = atof(optarg); break;
+            case 'f': fim_s = atof(optarg); break;
+            case 'n': repete = atoi(optarg); break;
+            case 'l': lista = true; break;
+            default: uso = true; break;
+        }
+    }
+    if (uso || optind != argc - 1 || o.fator <= 0 || repete < 1) {
+        fprintf(stderr, "uso: %s [-r [-x fator]] [-d rx|tx|ambos] [-i s] [-f s] [-n N] [-l] captura.cap\n", argv[0]);
+        return 1;
+    }
+    CapLeitor l;
+    if (!cap_mapeia(&l, argv[optind])) {
+        fprintf(stderr, "%s: nao e uma captura\n", argv[optind]);
+        return 1;
+    }
+    if (l.refeito) fprintf(stderr, "%s: sem indice (gravacao interrompida), indice refeito\n", argv[optind]);
+    double por_s = 1e9 / l.unidade_ns;
+    o.t_ini = l.t0 + (uint64_t)(ini_s * por_s);
+    if (fim_s >= 0) o.t_fim = l.t0 + (uint64_t)(fim_s * por_s);
+    if (o.ritmo) repete = 1;
+
+    Contagem c = {0, 0, 0, lista, 0};
+    Medida m = {0, 0, 0, 0};
+    for (int i = 0; i < repete; i++) {
+        c.lista = lista && i == 0;
+        reproduz(&l, &o, &c, &m);
+    }
+    fflush(stdout);
+    fprintf(stderr, "%s: %llu registros, %llu bytes, %llu OK, %llu FAIL\n", ALVO_NOME,
+            (unsigned long long)m.registros, (unsigned long long)c.bytes,
+            (unsigned long long)c.ok, (unsigned long long)c.falhas);
+    if (c.bytes) {
+        fprintf(stderr, "  no receptor: %.3f ms, %.2f ns/byte, %.1f MB/s\n", m.ns * 1e-6,
+                (double)m.ns / c.bytes, c.bytes * 1e3 / (m.ns ? m.ns : 1));
+    }
+    if (o.ritmo && m.registros) {
+        fprintf(stderr, "  ritmo x%.2f: atraso de entrega medio %.1f us, maximo %.1f us\n", o.fator,
+                m.atraso_soma * 1e-3 / m.registros, m.atraso_max * 1e-3);
+    }
+    cap_desmapeia(&l);
+    return 0;
+}
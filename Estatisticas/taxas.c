@@ -0,0 +1,148 @@
+/*
+ * taxas.c
+ *
+ * Mostra como taxas os contadores do receptor (FSM.c compilado com
+ * RX_ESTAT=1). Le as linhas CSV de rx_estat_cabecalho()/rx_estat_imprime()
+ * (da UART de depuracao, de um arquivo ou de "./fsm estat") e, para cada
+ * linha, imprime a diferenca para a linha anterior do mesmo canal:
+ *  - B/s e quadros OK/s
+ *  - lixo: % dos bytes descartados procurando SOF
+ *  - falhas/s de CHK, EOF, LEN e quadros abortados por silencio
+ *  - % dos bytes e, se o alvo tem RX_ESTAT_RELOGIO, % do tempo por estado
+ *
+ * Contadores de 32 bits: a diferenca sem sinal atravessa o estouro. Se
+ * bytes e OK diminuem juntos, o alvo foi zerado e os contadores da linha
+ * nova valem inteiros. O intervalo continua contado da linha anterior
+ * (rx_estat_zera(): o relogio segue), ou de t_ms = 0 se o relogio tambem
+ * voltou (reinicio).
+ *
+ * Uso:
+ *  gcc -O2 Estatisticas/taxas.c -o taxas
+ *  ./taxas [arquivo]          (sem arquivo: entrada padrao)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define COLUNAS_MAX 64
+#define CANAIS_MAX 1024
+#define ESTADOS 6
+
+static const char* nome_estado[ESTADOS] = {"sof", "len", "dado", "chk", "eof", "lenx"};
+
+typedef struct {
+    bool visto;
+    uint32_t t_ms, bytes, lixo, ok, falha_chk, falha_eof, falha_tam, falha_ocioso;
+    uint32_t bytes_e[ESTADOS], tempo_e[ESTADOS];
+} Linha;
+
+// indice de cada campo no CSV (-1 = ausente)
+typedef struct {
+    int t_ms, canal, bytes, lixo, ok, falha_chk, falha_eof, falha_tam, falha_ocioso;
+    int bytes_e[ESTADOS], tempo_e[ESTADOS];
+} Layout;
+
+static Linha anterior[CANAIS_MAX];
+
+static int separa(char* s, char** campo) {
+    int n = 0;
+    for (char* p = strtok(s, ",\r\n"); p && n < COLUNAS_MAX; p = strtok(NULL, ",\r\n")) campo[n++] = p;
+    return n;
+}
+
+static bool le_layout(char* cabecalho, Layout* l) {
+    char* campo[COLUNAS_MAX];
+    int n = separa(cabecalho, campo);
+    int* alvo[] = {&l->t_ms, &l->canal, &l->bytes, &l->lixo, &l->ok,
+                   &l->falha_chk, &l->falha_eof, &l->falha_tam, &l->falha_ocioso};
+    const char* nomes[] = {"t_ms", "canal", "bytes", "lixo", "ok",
+                           "falha_chk", "falha_eof", "falha_tam", "falha_ocioso"};
+    memset(l, -1, sizeof(*l));
+    for (int i = 0; i < n; i++) {
+        for (size_t k = 0; k < sizeof(nomes) / sizeof(nomes[0]); k++) {
+            if (strcmp(campo[i], nomes[k]) == 0) *alvo[k] = i;
+        }
+        int e;
+        if (sscanf(campo[i], "bytes_e%d", &e) == 1 && e >= 0 && e < ESTADOS) l->bytes_e[e] = i;
+        if (sscanf(campo[i], "tempo_e%d", &e) == 1 && e >= 0 && e < ESTADOS) l->tempo_e[e] = i;
+    }
+    return l->t_ms >= 0 && l->canal >= 0 && l->bytes >= 0 && l->ok >= 0;
+}
+
+static uint32_t valor(char** campo, int n, int idx) {
+    return (idx >= 0 && idx < n) ? (uint32_t)strtoul(campo[idx], NULL, 10) : 0;
+}
+
+static void cabecalho_saida(void) {
+    printf("%8s %5s %9s %9s %6s %8s %8s %8s %8s", "t(s)", "canal", "B/s", "OK/s", "lixo%",
+           "chk/s", "eof/s", "len/s", "ocio/s");
+    for (int e = 0; e < ESTADOS; e++) printf(" %5s%%", nome_estado[e]);
+    printf("\n");
+}
+
+static void mostra(uint16_t canal, const Linha* a, const Linha* b) {
+    bool zerado = b->bytes < a->bytes && b->ok <= a->ok;
+    Linha z = {0};
+    if (zerado) {
+        if (b->t_ms >= a->t_ms) z.t_ms = a->t_ms;  // so os contadores zeraram
+        a = &z;
+    }
+    double dt = (b->t_ms - a->t_ms) / 1000.0;
+    if (dt <= 0) return;
+    uint32_t bytes = b->bytes - a->bytes;
+    printf("%8.2f %5u %9.0f %9.1f %6.2f %8.2f %8.2f %8.2f %8.2f", b->t_ms / 1000.0, canal,
+           bytes / dt, (b->ok - a->ok) / dt,
+           bytes ? 100.0 * (b->lixo - a->lixo) / bytes : 0.0,
+           (b->falha_chk - a->falha_chk) / dt, (b->falha_eof - a->falha_eof) / dt,
+           (b->falha_tam - a->falha_tam) / dt, (b->falha_ocioso - a->falha_ocioso) / dt);
+    for (int e = 0; e < ESTADOS; e++) {
+        printf(" %6.1f", bytes ? 100.0 * (b->bytes_e[e] - a->bytes_e[e]) / bytes : 0.0);
+    }
+    uint32_t tempo = 0;
+    for (int e = 0; e < ESTADOS; e++) tempo += b->tempo_e[e] - a->tempo_e[e];
+    if (tempo) {
+        printf("  tempo%%");
+        for (int e = 0; e < ESTADOS; e++) {
+            printf(" %s %.1f", nome_estado[e], 100.0 * (b->tempo_e[e] - a->tempo_e[e]) / tempo);
+        }
+    }
+    printf("%s\n", zerado ? "  (zerado)" : "");
+}
+
+int main(int argc, char** argv) {
+    FILE* in = stdin;
+    if (argc > 1 && !(in = fopen(argv[1], "r"))) {
+        fprintf(stderr, "nao abriu %s\n", argv[1]);
+        return 1;
+    }
+    char linha[1024];
+    Layout l;
+    bool tem_layout = false;
+    while (fgets(linha, sizeof(linha), in)) {
+        char* campo[COLUNAS_MAX];
+        if (strncmp(linha, "t_ms,", 5) == 0) {   // cabecalho (pode repetir apos reinicio)
+            tem_layout = le_layout(linha, &l);
+            if (tem_layout) cabecalho_saida();
+            continue;
+        }
+        if (!tem_layout) continue;               // texto solto da UART antes do cabecalho
+        int n = separa(linha, campo);
+        if (n <= l.ok) continue;
+        uint32_t canal = valor(campo, n, l.canal);
+        if (canal >= CANAIS_MAX) continue;
+        Linha b = {true, valor(campo, n, l.t_ms), valor(campo, n, l.bytes), valor(campo, n, l.lixo),
+                   valor(campo, n, l.ok), valor(campo, n, l.falha_chk), valor(campo, n, l.falha_eof),
+                   valor(campo, n, l.falha_tam), valor(campo, n, l.falha_ocioso), {0}, {0}};
+        for (int e = 0; e < ESTADOS; e++) {
+            b.bytes_e[e] = valor(campo, n, l.bytes_e[e]);
+            b.tempo_e[e] = valor(campo, n, l.tempo_e[e]);
+        }
+        if (anterior[canal].visto) mostra((uint16_t)canal, &anterior[canal], &b);
+        anterior[canal] = b;
+    }
+    if (in != stdin) fclose(in);
+    return 0;
+}
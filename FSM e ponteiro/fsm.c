@@ -4,9 +4,13 @@
 #include <string.h>
 #include <assert.h>
 
-#define STX 0x02
-#define ETX 0x03
-#define MAX_DADOS 256
+#include "../dialetos.h"
+#include "../pool.h"
+
+// Dialeto "ponteiro" de dialetos.h: o XOR cobre QTD e dados
+#define STX ESPEC_SOF(ESPEC_PONTEIRO)
+#define ETX ESPEC_EOF(ESPEC_PONTEIRO)
+#define MAX_DADOS (ESPEC_MAX(ESPEC_PONTEIRO) + 1)
 
 typedef enum {
     ST_STX,
@@ -18,10 +22,25 @@ typedef enum {
     ST_ERROR
 } State;
 
+// Com FSM_POOL os dados ficam num bloco de fsm_pool, pego em ST_QTD, em
+// vez de MAX_DADOS bytes em cada FSM. Em ST_ERROR o bloco volta na hora;
+// em ST_DONE fica até fsm_libera() (chamar antes do próximo fsm_init()).
+#ifdef FSM_POOL
+#ifndef FSM_POOL_BLOCOS
+#define FSM_POOL_BLOCOS 2
+#endif
+static uint8_t fsm_pool_mem[FSM_POOL_BLOCOS][MAX_DADOS];
+Pool fsm_pool = POOL_INICIALIZA(fsm_pool_mem, MAX_DADOS, FSM_POOL_BLOCOS);
+#endif
+
 typedef struct {
     State state;
     uint8_t qtd;
+#ifdef FSM_POOL
+    uint8_t *dados;
+#else
     uint8_t dados[MAX_DADOS];
+#endif
     uint8_t pos;
     uint8_t checksum;
 } FSM;
@@ -40,6 +59,9 @@ State st_stx(FSM *fsm, uint8_t byte) {
 }
 
 State st_qtd(FSM *fsm, uint8_t byte) {
+#ifdef FSM_POOL
+    if (!fsm->dados && !(fsm->dados = pool_pega(&fsm_pool))) return ST_ERROR;  // pool esgotado
+#endif
     fsm->qtd = byte;
     fsm->checksum ^= byte;
     fsm->pos = 0;
@@ -95,12 +117,30 @@ void fsm_init(FSM *fsm) {
     fsm->state = ST_STX;
 }
 
+// Devolve o bloco de dados ao pool (sem FSM_POOL não faz nada)
+void fsm_libera(FSM *fsm) {
+#ifdef FSM_POOL
+    if (fsm->dados) {
+        pool_devolve(&fsm_pool, fsm->dados);
+        fsm->dados = NULL;
+    }
+#else
+    (void)fsm;
+#endif
+}
+
 // --- Execução ---
 void fsm_process(FSM *fsm, uint8_t byte) {
     fsm->state = state_table[fsm->state](fsm, byte);
+#ifdef FSM_POOL
+    if (fsm->state == ST_ERROR) fsm_libera(fsm);
+#endif
 }
 
 // --- Testes ---
+// FSM_SEM_MAIN: só a máquina, para incluir em outro programa (Fuzz/).
+#ifndef FSM_SEM_MAIN
+
 void test_valid_message() {
     FSM fsm;
     fsm_init(&fsm);
@@ -113,6 +153,7 @@ void test_valid_message() {
     assert(fsm.dados[0] == 'A');
     assert(fsm.dados[1] == 'B');
     assert(fsm.dados[2] == 'C');
+    fsm_libera(&fsm);
 }
 
 void test_invalid_checksum() {
@@ -126,9 +167,34 @@ void test_invalid_checksum() {
     assert(fsm.state == ST_ERROR);
 }
 
+// Três FSMs com o pool de dois blocos: a terceira falha no QTD e nenhuma
+// segura bloco depois de liberada. Sem FSM_POOL todas recebem.
+void test_pool() {
+    FSM f[3];
+    uint8_t msg[] = {STX, 1, 'Z', (1 ^ 'Z'), ETX};
+    for (int i = 0; i < 3; i++) fsm_init(&f[i]);
+    for (size_t k = 0; k < sizeof(msg); k++) {
+        for (int i = 0; i < 3; i++) fsm_process(&f[i], msg[k]);
+    }
+    assert(f[0].state == ST_DONE && f[1].state == ST_DONE);
+#ifdef FSM_POOL
+    assert(f[2].state == ST_ERROR && f[2].dados == NULL);
+    assert(fsm_pool.est.esgotado == 1 && fsm_pool.est.em_uso == 2);
+#else
+    assert(f[2].state == ST_DONE);
+#endif
+    for (int i = 0; i < 3; i++) fsm_libera(&f[i]);
+#ifdef FSM_POOL
+    assert(fsm_pool.est.em_uso == 0);
+#endif
+}
+
 int main() {
     test_valid_message();
     test_invalid_checksum();
+    test_pool();
     printf("Todos os testes passaram!\n");
     return 0;
 }
+
+#endif // FSM_SEM_MAIN
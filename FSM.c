@@ -1,20 +1,40 @@
+// clock_gettime/CLOCK_MONOTONIC no host tambm com -std=c11
+#if !defined(__ARM_ARCH_6M__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+
+#include "checksum.h"
+#include "dialetos.h"
+#include "cobs.h"
+#include "lzss.h"
+#include "pool.h"
 
 // ---------------- Mini Framework de Testes ----------------
 #define checa(msg, cond) do { if (!(cond)) return msg; } while (0)
-#define roda_teste(fn) do { char *msg = fn(); total_testes++; \
+#define roda_teste(fn) do { char *msg = (teste_prepara(), fn()); total_testes++; \
                             if (msg) return msg; } while (0)
 
 int total_testes = 0;
 
 // ---------------- Definies do Protocolo ----------------
-#define FRAME_SOF 0x02
-#define FRAME_EOF 0x03
-#define FRAME_MAX 255
+// Dialeto "enlace" de dialetos.h (o mesmo de Protothreads/main.c)
+#define FRAME_SOF ESPEC_SOF(ESPEC_ENLACE)
+#define FRAME_EOF ESPEC_EOF(ESPEC_ENLACE)
+#define FRAME_MAX ESPEC_MAX(ESPEC_ENLACE)
+
+// Quadro estendido (negociado): SOF_EXT LEN_lo LEN_hi payload CHK EOF.
+// Receptores que no o habilitaram tratam SOF_EXT como lixo.
+#define FRAME_SOF_EXT 0x01
+#ifndef FRAME_EXT_MAX
+#define FRAME_EXT_MAX 4096
+#endif
 
 typedef enum {
     FRAME_PROGRESS,
@@ -22,13 +42,9 @@ typedef enum {
     FRAME_FAIL
 } FrameResult;
 
-// Checksum simples: XOR
+// Checksum simples: XOR (kernels por palavra/SIMD em checksum.h)
 uint8_t gera_chk(const uint8_t* dados, uint8_t n) {
-    uint8_t c = 0;
-    for (int i = 0; i < n; i++) {
-        c ^= dados[i];
-    }
-    return c;
+    return chk_xor(dados, n);
 }
 
 // ---------------- Receptor (FSM) ----------------
@@ -37,126 +53,1678 @@ typedef enum {
     RX_WAIT_LEN,
     RX_READ_DATA,
     RX_WAIT_CHK,
-    RX_WAIT_EOF
+    RX_WAIT_EOF,
+    RX_WAIT_LEN_EXT     // 2 bytes de LEN, LSB primeiro (quadro estendido)
 } RxState;
 
+#define RX_ESTADOS (RX_WAIT_LEN_EXT + 1)
+
+// Estatsticas do receptor, ligadas com RX_ESTAT=1. Desligadas no custam
+// nada: nem campo no FSM_Rx nem instruo no caminho do byte.
+#ifndef RX_ESTAT
+#define RX_ESTAT 0
+#endif
+
+#if RX_ESTAT
+typedef struct {
+    uint32_t bytes;                     // todos os bytes entregues ao receptor
+    uint32_t lixo;                      // descartados procurando SOF
+    uint32_t ok;
+    uint32_t falha_chk;
+    uint32_t falha_eof;
+    uint32_t falha_tam;                 // LEN maior que o buffer
+    uint32_t falha_ocioso;              // quadros abortados por silncio (rx_marca_tempo)
+    uint32_t bytes_estado[RX_ESTADOS];  // bytes consumidos em cada estado
+    uint32_t tempo_estado[RX_ESTADOS];  // tempo parado em cada estado (RX_ESTAT_RELOGIO)
+} RxEstatDados;
+
+// Escrito s pelo receptor; lido por rx_estat_copia() de outra tarefa ou
+// de uma ISR, com seqlock: "seq" mpar = atualizao em curso.
+typedef struct {
+    volatile uint32_t seq;
+    volatile bool zera;     // pedido de rx_estat_zera(), atendido pelo receptor
+    uint32_t t_ultimo;
+    RxEstatDados d;
+} RxEstat;
+#endif
+
+// Tempo para o limite de silncio entre bytes, na unidade do chamador:
+// marcas do rtos/ (tick_t, 16 bits) ou ms de um relgio monotnico.
+#ifndef RX_TEMPO_T
+#define RX_TEMPO_T uint32_t
+#endif
+
+// Payload num bloco de um pool (pool.h) em vez de buf[FRAME_MAX] em cada
+// receptor, ligado com RX_POOL=1. O bloco  pego no LEN vlido e devolvido
+// quando o quadro termina. Depois de um FRAME_OK ele fica com o receptor
+// at o prximo byte (ou bloco) ou rx_libera(), para o chamador ler o
+// payload; rx_handle_bytes() com callback devolve logo aps ela. Um enlace
+// que fica mudo depois de um quadro segura o bloco at rx_libera(). Com o pool
+// esgotado o quadro falha j no LEN (contado em Pool.est.esgotado).
+#ifndef RX_POOL
+#define RX_POOL 0
+#endif
+
+#if RX_POOL
+#ifndef RX_POOL_BLOCOS
+#define RX_POOL_BLOCOS 4
+#endif
+static uint8_t rx_pool_mem[RX_POOL_BLOCOS][FRAME_MAX];
+// Pool de rx_reset(); outro com rx_configura_pool()
+Pool rx_pool_padrao = POOL_INICIALIZA(rx_pool_mem, FRAME_MAX, RX_POOL_BLOCOS);
+#endif
+
 typedef struct {
     RxState estado;
+#if RX_POOL
+    uint8_t* buf;       // bloco de "pool"; NULL entre quadros
+    Pool* pool;
+#else
     uint8_t buf[FRAME_MAX];
-    uint8_t pos;
-    uint8_t tamanho;
-    uint8_t calc_chk;
+#endif
+    uint16_t pos;
+    uint16_t tamanho;
+    uint32_t calc_chk;  // XOR ou registrador do CRC, conforme "modo"
+    ChkModo modo;       // integridade negociada (padro CHK_XOR)
+    uint8_t chk_idx;    // bytes do campo CHK j conferidos
+    bool ressinc;       // reanalisa os bytes de um quadro que falhou
+    bool estendido;     // quadro em curso  estendido (payload em "ext")
+    uint8_t* ext;       // buffer do chamador para quadros estendidos
+    uint16_t ext_cap;   // 0 = quadros estendidos desabilitados
+#if RX_ESTAT
+    RxEstat est;
+#endif
+    struct RxDespacho* despacho;   // tratadores por tipo (NULL = nenhum)
+    RX_TEMPO_T t_ultimo;    // chegada do ltimo byte (rx_marca_tempo)
+    RX_TEMPO_T ocioso_max;  // silncio mximo dentro de um quadro (0 = sem limite)
 } FSM_Rx;
 
-void rx_reset(FSM_Rx* f) {
+// Fim de um quadro OK: como rx_rearma(), mas com RX_POOL o bloco fica com
+// o receptor para o chamador ler o payload.
+static void rx_conclui(FSM_Rx* f) {
     f->estado = RX_WAIT_SOF;
     f->pos = 0;
     f->tamanho = 0;
     f->calc_chk = 0;
+    f->chk_idx = 0;
+    f->estendido = false;
+}
+
+// Prepara para o prximo quadro, mantendo a configurao (modo).
+// O buf no  apagado: s os "tamanho" primeiros bytes tm significado.
+static void rx_rearma(FSM_Rx* f) {
+    rx_conclui(f);
+#if RX_POOL
+    if (f->buf) {
+        pool_devolve(f->pool, f->buf);
+        f->buf = NULL;
+    }
+#endif
+}
+
+// Buffer para o quadro curto que comea; false = pool esgotado.
+static inline bool rx_pega_buf(FSM_Rx* f) {
+#if RX_POOL
+    if (!f->buf) f->buf = pool_pega(f->pool);
+    return f->buf != NULL;
+#else
+    (void)f;
+    return true;
+#endif
+}
+
+// Reinicia tudo, inclusive a configurao. Tambm serve como inicializao.
+void rx_reset(FSM_Rx* f) {
+    f->modo = CHK_XOR;
+    f->ressinc = false;
+    f->ext = NULL;
+    f->ext_cap = 0;
+    f->despacho = NULL;
+    f->t_ultimo = 0;
+    f->ocioso_max = 0;
+#if RX_POOL
+    f->buf = NULL;          // sem devolver: o FSM_Rx pode no estar inicializado
+    f->pool = &rx_pool_padrao;
+    rx_rearma(f);
+#else
+    rx_rearma(f);
     memset(f->buf, 0, FRAME_MAX);
+#endif
+#if RX_ESTAT
+    memset(&f->est, 0, sizeof(f->est));
+#endif
 }
 
-FrameResult rx_handle_byte(FSM_Rx* f, uint8_t b) {
+// Escolhe a integridade do quadro (XOR, CRC-16 ou CRC-32). Chamar aps
+// rx_reset(); os dois lados do enlace devem usar o mesmo modo.
+void rx_configura_chk(FSM_Rx* f, ChkModo modo) {
+    f->modo = modo;
+    rx_rearma(f);
+}
+
+// Devolve j o bloco do receptor: o retido depois de um FRAME_OK (o
+// payload deixa de valer) ou o do quadro em curso, que  abandonado.
+// Chamar tambm antes de rx_reset() num receptor em uso ou ao fechar o
+// enlace. Sem RX_POOL s abandona o quadro.
+void rx_libera(FSM_Rx* f) {
+    rx_rearma(f);
+}
+
+#if RX_POOL
+// Troca o pool do receptor (padro: rx_pool_padrao), ex. um por grupo de
+// UARTs com a mesma prioridade de interrupo.
+void rx_configura_pool(FSM_Rx* f, Pool* pool) {
+    rx_rearma(f);
+    f->pool = pool;
+}
+#endif
+
+// Habilita quadros estendidos (LEN de 16 bits) com payload em "buf", de
+// at "cap" bytes (limitado a FRAME_EXT_MAX). Quadros curtos continuam
+// aceitos. buf = NULL desabilita.
+void rx_configura_ext(FSM_Rx* f, uint8_t* buf, uint16_t cap) {
+    f->ext = buf;
+    f->ext_cap = buf ? (cap < FRAME_EXT_MAX ? cap : FRAME_EXT_MAX) : 0;
+    rx_rearma(f);
+}
+
+#if RX_ESTAT
+// Relgio opcional para tempo_estado, definido antes de incluir (ex.:
+// ticks do sistema). Sem ele s os bytes por estado so contados.
+// #define RX_ESTAT_RELOGIO() sys_ticks()
+
+#ifndef RX_ESTAT_TENTATIVAS
+#define RX_ESTAT_TENTATIVAS 64
+#endif
+
+// Lado do receptor: "n" bytes consumidos no estado "estado", dos quais
+// "lixo" descartados antes de um SOF; "r"  o resultado do ltimo deles.
+static inline void rx_estat_conta(RxEstat* e, RxState estado, uint32_t n,
+                                  uint32_t lixo, FrameResult r) {
+    e->seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (e->zera) {
+        memset(&e->d, 0, sizeof(e->d));
+        e->zera = false;
+    }
+#ifdef RX_ESTAT_RELOGIO
+    uint32_t t = (uint32_t)RX_ESTAT_RELOGIO();
+    if (e->d.bytes) e->d.tempo_estado[estado] += t - e->t_ultimo;
+    e->t_ultimo = t;
+#endif
+    e->d.bytes += n;
+    e->d.lixo += lixo;
+    e->d.bytes_estado[estado] += n;
+    if (r == FRAME_OK) {
+        e->d.ok++;
+    } else if (r == FRAME_FAIL) {
+        if (estado == RX_WAIT_CHK) e->d.falha_chk++;
+        else if (estado == RX_WAIT_EOF) e->d.falha_eof++;
+        else if (estado == RX_WAIT_LEN || estado == RX_WAIT_LEN_EXT) e->d.falha_tam++;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->seq++;
+}
+
+#define RX_ESTAT_CONTA(e, estado, n, lixo, r) \
+    rx_estat_conta((e), (estado), (uint32_t)(n), (uint32_t)(lixo), (r))
+
+static inline void rx_estat_aborto(RxEstat* e) {
+    e->seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (e->zera) {
+        memset(&e->d, 0, sizeof(e->d));
+        e->zera = false;
+    }
+    e->d.falha_ocioso++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->seq++;
+}
+
+// Cpia consistente dos contadores, de outra tarefa ou de uma ISR. Falso
+// se o receptor esteve no meio de uma atualizao em todas as tentativas
+// (ISR que interrompeu o prprio receptor): tentar de novo mais tarde.
+bool rx_estat_copia(const RxEstat* e, RxEstatDados* out) {
+    for (int t = 0; t < RX_ESTAT_TENTATIVAS; t++) {
+        uint32_t s = e->seq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (s & 1u) continue;
+        bool zera = e->zera;
+        memcpy(out, &e->d, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (e->seq == s) {
+            if (zera) memset(out, 0, sizeof(*out));
+            return true;
+        }
+    }
+    return false;
+}
+
+// Zera os contadores. Quem zera  o receptor, no prximo byte; at l
+// rx_estat_copia() j devolve zeros. Para taxas no  preciso zerar: a
+// ferramenta de host trabalha com diferenas entre cpias.
+void rx_estat_zera(RxEstat* e) {
+    e->zera = true;
+}
+
+// Uma linha CSV por cpia, para a ferramenta de host (Estatisticas/taxas.c)
+void rx_estat_cabecalho(FILE* s) {
+    fprintf(s, "t_ms,canal,bytes,lixo,ok,falha_chk,falha_eof,falha_tam,falha_ocioso");
+    for (int k = 0; k < RX_ESTADOS; k++) fprintf(s, ",bytes_e%d", k);
+    for (int k = 0; k < RX_ESTADOS; k++) fprintf(s, ",tempo_e%d", k);
+    fprintf(s, "\n");
+}
+
+void rx_estat_imprime(FILE* s, uint32_t t_ms, uint16_t canal, const RxEstatDados* d) {
+    fprintf(s, "%lu,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu", (unsigned long)t_ms, canal,
+            (unsigned long)d->bytes, (unsigned long)d->lixo, (unsigned long)d->ok,
+            (unsigned long)d->falha_chk, (unsigned long)d->falha_eof, (unsigned long)d->falha_tam,
+            (unsigned long)d->falha_ocioso);
+    for (int k = 0; k < RX_ESTADOS; k++) fprintf(s, ",%lu", (unsigned long)d->bytes_estado[k]);
+    for (int k = 0; k < RX_ESTADOS; k++) fprintf(s, ",%lu", (unsigned long)d->tempo_estado[k]);
+    fprintf(s, "\n");
+}
+#else
+#define RX_ESTAT_CONTA(e, estado, n, lixo, r) ((void)0)
+#endif
+
+// Silncio entre bytes. Se o transmissor morre no meio de um quadro, o
+// receptor ficaria em RX_READ_DATA at bytes de outro quadro completarem o
+// LEN, e esse outro quadro se perderia tambm. Com um limite configurado,
+// um quadro parado por mais que "max" unidades  abortado e o receptor
+// volta a procurar SOF antes de ver o prximo byte.
+//
+// Fonte de tempo, na mesma unidade de "max":
+//  - rtos/: ContadorDeMarcas() (marca de ExecutaMarcaDeTempo(), 1 ms),
+//    com RX_TEMPO_T = tick_t (o limite tem de ficar bem abaixo de 65 s)
+//  - host: rx_tempo_ms(), relgio monotnico em ms
+void rx_configura_ocioso(FSM_Rx* f, RX_TEMPO_T max) {
+    f->ocioso_max = max;
+}
+
+// S consulta: aborta o quadro em curso se o silncio desde o ltimo byte
+// passou do limite. Retorna FRAME_FAIL se abortou. Pode ser chamada
+// periodicamente pela tarefa do receptor (nunca de outra tarefa ou ISR:
+// ela mexe no estado do receptor).
+FrameResult rx_verifica_ocioso(FSM_Rx* f, RX_TEMPO_T agora) {
+    if (!f->ocioso_max || f->estado == RX_WAIT_SOF) return FRAME_PROGRESS;
+    if ((RX_TEMPO_T)(agora - f->t_ultimo) <= f->ocioso_max) return FRAME_PROGRESS;
+    rx_rearma(f);
+#if RX_ESTAT
+    rx_estat_aborto(&f->est);
+#endif
+    return FRAME_FAIL;
+}
+
+// Chamar com o instante de chegada antes de entregar bytes ao receptor
+// (um byte a rx_handle_byte() ou um bloco a rx_handle_bytes()).
+FrameResult rx_marca_tempo(FSM_Rx* f, RX_TEMPO_T agora) {
+    FrameResult r = rx_verifica_ocioso(f, agora);
+    f->t_ultimo = agora;
+    return r;
+}
+
+#if !defined(__ARM_ARCH_6M__)
+static inline uint32_t rx_tempo_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)((uint64_t)t.tv_sec * 1000u + (uint64_t)t.tv_nsec / 1000000u);
+}
+#endif
+
+// Payload do quadro em curso (ou do que acabou de fechar)
+static inline uint8_t* rx_payload(FSM_Rx* f) {
+    return f->estendido ? f->ext : f->buf;
+}
+
+// Um byte de LEN estendido; "pos" conta os bytes de LEN j lidos.
+static inline FrameResult rx_len_ext(FSM_Rx* f, uint8_t b) {
+    f->tamanho |= (uint16_t)(b << (8 * f->pos));
+    if (++f->pos < 2) return FRAME_PROGRESS;
+    if (f->tamanho > f->ext_cap) {
+        rx_rearma(f);
+        return FRAME_FAIL;
+    }
+    f->pos = 0;
+    f->estendido = true;
+    f->calc_chk = chk_inicia(f->modo);
+    f->chk_idx = 0;
+    f->estado = (f->tamanho == 0) ? RX_WAIT_CHK : RX_READ_DATA;
+    return FRAME_PROGRESS;
+}
+
+// Em FRAME_OK os motores chamam o despacho (se configurado) antes do
+// rx_rearma(), com o payload e o tamanho ainda vlidos.
+struct RxDespacho;
+static inline void rx_despacha(struct RxDespacho* d, const uint8_t* p, uint16_t n);
+
+// Motor "switch": a gramtica escrita  mo, um case por estado.
+static inline FrameResult rx_byte_switch(FSM_Rx* f, uint8_t b) {
     switch (f->estado) {
         case RX_WAIT_SOF:
             if (b == FRAME_SOF) {
                 f->estado = RX_WAIT_LEN;
+            } else if (b == FRAME_SOF_EXT && f->ext_cap) {
+                f->estado = RX_WAIT_LEN_EXT;
             }
             break;
 
+        case RX_WAIT_LEN_EXT:
+            return rx_len_ext(f, b);
+
         case RX_WAIT_LEN:
-            if (b > FRAME_MAX) {
-                rx_reset(f);
+            if (b > FRAME_MAX || !rx_pega_buf(f)) {
+                rx_rearma(f);
                 return FRAME_FAIL;
             }
             f->tamanho = b;
             f->pos = 0;
-            f->calc_chk = 0;
+            f->calc_chk = chk_inicia(f->modo);
+            f->chk_idx = 0;
             f->estado = (b == 0) ? RX_WAIT_CHK : RX_READ_DATA;
             break;
 
         case RX_READ_DATA:
-            f->buf[f->pos++] = b;
-            f->calc_chk ^= b;
+            rx_payload(f)[f->pos++] = b;
+            f->calc_chk = chk_atualiza_byte(f->modo, f->calc_chk, b);
             if (f->pos == f->tamanho) {
                 f->estado = RX_WAIT_CHK;
             }
             break;
 
-        case RX_WAIT_CHK:
-            if (b == f->calc_chk) {
+        case RX_WAIT_CHK: {
+            // CHK chega LSB primeiro; falha j no primeiro byte divergente
+            uint32_t esperado = chk_finaliza(f->modo, f->calc_chk);
+            if (b != (uint8_t)(esperado >> (8 * f->chk_idx))) {
+                rx_rearma(f);
+                return FRAME_FAIL;
+            }
+            if (++f->chk_idx == chk_bytes(f->modo)) {
                 f->estado = RX_WAIT_EOF;
-            } else {
-                rx_reset(f);
+            }
+            break;
+        }
+
+        case RX_WAIT_EOF:
+            if (b != FRAME_EOF) {
+                rx_rearma(f);
+                return FRAME_FAIL;
+            }
+            if (f->despacho) rx_despacha(f->despacho, rx_payload(f), f->tamanho);
+            rx_conclui(f);
+            return FRAME_OK;
+    }
+    return FRAME_PROGRESS;
+}
+
+// ---------------- Despacho por tipo ----------------
+// O 1o byte do payload  o tipo da mensagem. Em FRAME_OK o receptor chama
+// direto o tratador do tipo, com ponteiro para o resto do payload dentro
+// do prprio buffer do receptor (sem cpia, vlido s durante a chamada).
+// Tabela de 256 entradas: um ndice e uma chamada, sem switch no consumidor.
+typedef void (*RxTratador)(void* ctx, uint8_t tipo, const uint8_t* corpo, uint16_t n);
+
+// Contadores e carimbos de tempo por tipo, ligados com RX_DESPACHO_ESTAT=1.
+// Os tempos usam RX_DESPACHO_RELOGIO(), se definido (ex.: ticks).
+#ifndef RX_DESPACHO_ESTAT
+#define RX_DESPACHO_ESTAT 0
+#endif
+
+// Sem RX_DESPACHO_ESTAT a tabela pode ser const (em flash, no SAMD21):
+//   static const RxDespacho d = {.trat = {[0x10] = trata_leitura}};
+typedef struct RxDespacho {
+    RxTratador trat[256];
+    void* ctx;                      // passado a todos os tratadores
+#if RX_DESPACHO_ESTAT
+    uint32_t qtd[256];              // mensagens entregues por tipo
+    uint32_t sem_tratador;          // tipo sem tratador ou payload vazio
+#ifdef RX_DESPACHO_RELOGIO
+    uint32_t chegada[256];          // instante da ltima mensagem do tipo
+    uint32_t duracao_max[256];      // maior tempo dentro do tratador
+#endif
+#endif
+} RxDespacho;
+
+void rx_despacho_init(RxDespacho* d, void* ctx) {
+    memset(d, 0, sizeof(*d));
+    d->ctx = ctx;
+}
+
+// fn = NULL remove o tratador do tipo
+void rx_despacho_registra(RxDespacho* d, uint8_t tipo, RxTratador fn) {
+    d->trat[tipo] = fn;
+}
+
+// Passa a despachar os quadros OK deste receptor (d = NULL desliga).
+void rx_configura_despacho(FSM_Rx* f, RxDespacho* d) {
+    f->despacho = d;
+}
+
+static inline void rx_despacha(RxDespacho* d, const uint8_t* p, uint16_t n) {
+    RxTratador fn = n ? d->trat[p[0]] : NULL;
+    if (!fn) {
+#if RX_DESPACHO_ESTAT
+        d->sem_tratador++;
+#endif
+        return;
+    }
+#if RX_DESPACHO_ESTAT && defined(RX_DESPACHO_RELOGIO)
+    uint32_t t0 = (uint32_t)RX_DESPACHO_RELOGIO();
+    d->chegada[p[0]] = t0;
+    fn(d->ctx, p[0], &p[1], (uint16_t)(n - 1));
+    uint32_t dt = (uint32_t)RX_DESPACHO_RELOGIO() - t0;
+    if (dt > d->duracao_max[p[0]]) d->duracao_max[p[0]] = dt;
+#else
+    fn(d->ctx, p[0], &p[1], (uint16_t)(n - 1));
+#endif
+#if RX_DESPACHO_ESTAT
+    d->qtd[p[0]]++;
+#endif
+}
+
+// ---------------- Receptor por tabela ----------------
+// A mesma gramtica descrita como dados. Cada linha de RX_GRAMATICA 
+// (estado, classe do byte, prximo estado, ao); as tabelas abaixo so
+// geradas dela em tempo de compilao. O lao faz duas consultas e um
+// nico salto pela ao, com custo igual em qualquer estado.
+// Aes que dependem do valor do byte (tamanho, fim dos dados, CHK)
+// corrigem o prximo estado dentro do prprio case.
+typedef enum {
+    CLS_DADO,
+    CLS_SOF,
+    CLS_EOF,
+    CLS_SOF_EXT,
+    CLS_QTD
+} RxClasse;
+
+#define RX_ACOES(X) \
+    X(ACAO_NADA)    \
+    X(ACAO_TAMANHO) \
+    X(ACAO_SOF_EXT) \
+    X(ACAO_TAMANHO_EXT) \
+    X(ACAO_DADO)    \
+    X(ACAO_CHK)     \
+    X(ACAO_OK)      \
+    X(ACAO_FALHA)
+
+#define RX_GRAMATICA(X) \
+    X(RX_WAIT_SOF,     CLS_DADO,    RX_WAIT_SOF,     ACAO_NADA)        \
+    X(RX_WAIT_SOF,     CLS_SOF,     RX_WAIT_LEN,     ACAO_NADA)        \
+    X(RX_WAIT_SOF,     CLS_EOF,     RX_WAIT_SOF,     ACAO_NADA)        \
+    X(RX_WAIT_SOF,     CLS_SOF_EXT, RX_WAIT_SOF,     ACAO_SOF_EXT)     \
+    X(RX_WAIT_LEN,     CLS_DADO,    RX_READ_DATA,    ACAO_TAMANHO)     \
+    X(RX_WAIT_LEN,     CLS_SOF,     RX_READ_DATA,    ACAO_TAMANHO)     \
+    X(RX_WAIT_LEN,     CLS_EOF,     RX_READ_DATA,    ACAO_TAMANHO)     \
+    X(RX_WAIT_LEN,     CLS_SOF_EXT, RX_READ_DATA,    ACAO_TAMANHO)     \
+    X(RX_READ_DATA,    CLS_DADO,    RX_READ_DATA,    ACAO_DADO)        \
+    X(RX_READ_DATA,    CLS_SOF,     RX_READ_DATA,    ACAO_DADO)        \
+    X(RX_READ_DATA,    CLS_EOF,     RX_READ_DATA,    ACAO_DADO)        \
+    X(RX_READ_DATA,    CLS_SOF_EXT, RX_READ_DATA,    ACAO_DADO)        \
+    X(RX_WAIT_CHK,     CLS_DADO,    RX_WAIT_CHK,     ACAO_CHK)         \
+    X(RX_WAIT_CHK,     CLS_SOF,     RX_WAIT_CHK,     ACAO_CHK)         \
+    X(RX_WAIT_CHK,     CLS_EOF,     RX_WAIT_CHK,     ACAO_CHK)         \
+    X(RX_WAIT_CHK,     CLS_SOF_EXT, RX_WAIT_CHK,     ACAO_CHK)         \
+    X(RX_WAIT_EOF,     CLS_DADO,    RX_WAIT_SOF,     ACAO_FALHA)       \
+    X(RX_WAIT_EOF,     CLS_SOF,     RX_WAIT_SOF,     ACAO_FALHA)       \
+    X(RX_WAIT_EOF,     CLS_EOF,     RX_WAIT_SOF,     ACAO_OK)          \
+    X(RX_WAIT_EOF,     CLS_SOF_EXT, RX_WAIT_SOF,     ACAO_FALHA)       \
+    X(RX_WAIT_LEN_EXT, CLS_DADO,    RX_WAIT_LEN_EXT, ACAO_TAMANHO_EXT) \
+    X(RX_WAIT_LEN_EXT, CLS_SOF,     RX_WAIT_LEN_EXT, ACAO_TAMANHO_EXT) \
+    X(RX_WAIT_LEN_EXT, CLS_EOF,     RX_WAIT_LEN_EXT, ACAO_TAMANHO_EXT) \
+    X(RX_WAIT_LEN_EXT, CLS_SOF_EXT, RX_WAIT_LEN_EXT, ACAO_TAMANHO_EXT)
+
+#define RX_ACAO_ENUM(a) a,
+typedef enum { RX_ACOES(RX_ACAO_ENUM) ACAO_QTD } RxAcao;
+#undef RX_ACAO_ENUM
+
+// Entrada: prximo estado no nibble alto, ao no baixo
+#define RX_ENTRADA(prox, acao) (uint8_t)(((prox) << 4) | (acao))
+#define RX_LINHA(e, c, prox, acao) [e][c] = RX_ENTRADA(prox, acao),
+static const uint8_t rx_transicao[RX_ESTADOS][CLS_QTD] = { RX_GRAMATICA(RX_LINHA) };
+#undef RX_LINHA
+
+// A gramtica tem de cobrir todos os pares (estado, classe)
+#define RX_CONTA(e, c, prox, acao) + 1
+_Static_assert(0 RX_GRAMATICA(RX_CONTA) == RX_ESTADOS * CLS_QTD, "RX_GRAMATICA incompleta");
+_Static_assert(ACAO_QTD <= 16 && RX_ESTADOS <= 16, "RX_ENTRADA usa nibbles");
+#undef RX_CONTA
+
+static const uint8_t rx_classe[256] = {
+    [FRAME_SOF] = CLS_SOF,
+    [FRAME_EOF] = CLS_EOF,
+    [FRAME_SOF_EXT] = CLS_SOF_EXT,
+};
+
+// Motor "tabela": mesmo contrato de rx_byte_switch().
+static inline FrameResult rx_byte_tabela(FSM_Rx* f, uint8_t b) {
+    uint8_t t = rx_transicao[f->estado][rx_classe[b]];
+    f->estado = (RxState)(t >> 4);
+    switch ((RxAcao)(t & 0x0F)) {
+        case ACAO_NADA:
+            break;
+
+        case ACAO_TAMANHO:
+            if (b > FRAME_MAX || !rx_pega_buf(f)) {
+                rx_rearma(f);
+                return FRAME_FAIL;
+            }
+            f->tamanho = b;
+            f->pos = 0;
+            f->calc_chk = chk_inicia(f->modo);
+            f->chk_idx = 0;
+            f->estado = (b == 0) ? RX_WAIT_CHK : RX_READ_DATA;
+            break;
+
+        case ACAO_SOF_EXT:
+            if (f->ext_cap) f->estado = RX_WAIT_LEN_EXT;
+            break;
+
+        case ACAO_TAMANHO_EXT:
+            return rx_len_ext(f, b);
+
+        case ACAO_DADO:
+            rx_payload(f)[f->pos++] = b;
+            f->calc_chk = chk_atualiza_byte(f->modo, f->calc_chk, b);
+            f->estado = (f->pos == f->tamanho) ? RX_WAIT_CHK : RX_READ_DATA;
+            break;
+
+        case ACAO_CHK: {
+            uint32_t esperado = chk_finaliza(f->modo, f->calc_chk);
+            if (b != (uint8_t)(esperado >> (8 * f->chk_idx))) {
+                rx_rearma(f);
+                return FRAME_FAIL;
+            }
+            f->estado = (++f->chk_idx == chk_bytes(f->modo)) ? RX_WAIT_EOF : RX_WAIT_CHK;
+            break;
+        }
+
+        case ACAO_OK:
+            if (f->despacho) rx_despacha(f->despacho, rx_payload(f), f->tamanho);
+            rx_conclui(f);
+            return FRAME_OK;
+
+        case ACAO_FALHA:
+        default:
+            rx_rearma(f);
+            return FRAME_FAIL;
+    }
+    return FRAME_PROGRESS;
+}
+
+// Motor usado por rx_handle_byte(): 0 = switch, 1 = tabela
+#ifndef RX_MOTOR_TABELA
+#define RX_MOTOR_TABELA 0
+#endif
+
+// O motor escolhido, sem estatstica (a ressincronizao reanalisa bytes
+// que j foram contados).
+static inline FrameResult rx_motor(FSM_Rx* f, uint8_t b) {
+#if RX_MOTOR_TABELA
+    return rx_byte_tabela(f, b);
+#else
+    return rx_byte_switch(f, b);
+#endif
+}
+
+FrameResult rx_handle_byte(FSM_Rx* f, uint8_t b) {
+#if RX_POOL
+    if (f->buf && f->estado == RX_WAIT_SOF) rx_rearma(f);   // retido do ltimo OK
+#endif
+#if RX_ESTAT
+    RxState antes = f->estado;
+    FrameResult r = rx_motor(f, b);
+    RX_ESTAT_CONTA(&f->est, antes, 1, antes == RX_WAIT_SOF && f->estado == RX_WAIT_SOF, r);
+    return r;
+#else
+    return rx_motor(f, b);
+#endif
+}
+
+// ---------------- Recepo em bloco ----------------
+// Chamada a cada quadro concludo (FRAME_OK) ou descartado (FRAME_FAIL).
+// offset: ndice, dentro do bloco, do byte que encerrou o quadro.
+// Em FRAME_OK, dados/n apontam para o payload (vlido s durante a chamada).
+typedef void (*RxQuadroFn)(void* ctx, FrameResult r, size_t offset,
+                           const uint8_t* dados, uint16_t n);
+
+// Prximo candidato a SOF em d[0..n); com quadros estendidos habilitados,
+// SOF_EXT tambm conta.
+static inline const uint8_t* rx_busca_sof(const FSM_Rx* f, const uint8_t* d, size_t n) {
+    if (!f->ext_cap) return memchr(d, FRAME_SOF, n);
+    for (size_t i = 0; i < n; i++) {
+        if (d[i] == FRAME_SOF || d[i] == FRAME_SOF_EXT) return &d[i];
+    }
+    return NULL;
+}
+
+// Liga/desliga a ressincronizao por retrocesso. Quando um quadro falha
+// no CHK ou no EOF, os bytes dele (LEN, payload, CHK j conferido e o byte
+// que falhou) so varridos de novo atrs de um SOF; assim um quadro bom que
+// comeou dentro de um truncado no se perde. Vale s para rx_handle_bytes()
+// e s para quadros curtos que falham.
+void rx_configura_ressinc(FSM_Rx* f, bool ligado) {
+    f->ressinc = ligado;
+}
+
+// Chamada com o receptor ainda no estado da falha; "b"  o byte que falhou.
+// Quadros recuperados so entregues com o offset desse byte. Candidatos a
+// SOF que falham durante a reanlise no geram FRAME_FAIL.
+static size_t rx_ressincroniza(FSM_Rx* f, uint8_t b, size_t offset,
+                               RxQuadroFn cb, void* ctx) {
+    uint8_t h[1 + FRAME_MAX + 4 + 1];
+    size_t n = 0;
+    if (f->estendido) {
+        rx_rearma(f);
+        return 0;
+    }
+    h[n++] = f->tamanho;
+    memcpy(&h[n], f->buf, f->pos);
+    n += f->pos;
+    uint32_t esperado = chk_finaliza(f->modo, f->calc_chk);
+    for (uint8_t k = 0; k < f->chk_idx; k++) h[n++] = (uint8_t)(esperado >> (8 * k));
+    h[n++] = b;
+    rx_rearma(f);
+
+    size_t i = 0, sof = 0, ok = 0;
+    while (i < n) {
+        if (f->estado == RX_WAIT_SOF) {
+            const uint8_t* p = rx_busca_sof(f, &h[i], n - i);
+            if (!p) break;
+            sof = (size_t)(p - h);
+            i = sof + 1;
+            rx_motor(f, *p);
+        } else if (f->estado == RX_WAIT_EOF && h[i] == FRAME_EOF) {
+            ok++;
+            if (f->despacho) rx_despacha(f->despacho, rx_payload(f), f->tamanho);
+            if (cb) cb(ctx, FRAME_OK, offset, rx_payload(f), f->tamanho);
+            rx_rearma(f);
+            i++;
+        } else if (rx_motor(f, h[i]) == FRAME_FAIL) {
+            i = sof + 1;  // candidato falso: tenta o prximo SOF
+        } else {
+            i++;
+        }
+    }
+    return ok;
+}
+
+// Consome um bloco inteiro (buffer de UART/DMA) de uma vez. O resultado  o
+// mesmo de chamar rx_handle_byte() byte a byte, mas o lixo antes do SOF 
+// pulado com memchr e o payload  copiado em bloco.
+// Retorna o nmero de quadros OK encontrados no bloco.
+size_t rx_handle_bytes(FSM_Rx* f, const uint8_t* dados, size_t n,
+                       RxQuadroFn cb, void* ctx) {
+    size_t i = 0, ok = 0;
+    while (i < n) {
+        switch (f->estado) {
+            case RX_WAIT_SOF: {
+#if RX_POOL
+                if (f->buf) rx_rearma(f);
+#endif
+                const uint8_t* p = rx_busca_sof(f, &dados[i], n - i);
+                if (!p) {
+                    RX_ESTAT_CONTA(&f->est, RX_WAIT_SOF, n - i, n - i, FRAME_PROGRESS);
+                    return ok;
+                }
+                RX_ESTAT_CONTA(&f->est, RX_WAIT_SOF, p - &dados[i] + 1, p - &dados[i], FRAME_PROGRESS);
+                i = (size_t)(p - dados) + 1;
+                f->estado = (*p == FRAME_SOF) ? RX_WAIT_LEN : RX_WAIT_LEN_EXT;
+                break;
+            }
+
+            case RX_READ_DATA: {
+                size_t k = (size_t)(f->tamanho - f->pos);
+                if (k > n - i) k = n - i;
+                memcpy(&rx_payload(f)[f->pos], &dados[i], k);
+                f->calc_chk = chk_atualiza(f->modo, f->calc_chk, &dados[i], k);
+                f->pos += (uint16_t)k;
+                i += k;
+                RX_ESTAT_CONTA(&f->est, RX_READ_DATA, k, 0, FRAME_PROGRESS);
+                if (f->pos == f->tamanho) {
+                    f->estado = RX_WAIT_CHK;
+                }
+                break;
+            }
+
+            case RX_WAIT_CHK: {
+                // tratado aqui para a ressincronizao ver o quadro que falhou
+                uint32_t esperado = chk_finaliza(f->modo, f->calc_chk);
+                if (dados[i] != (uint8_t)(esperado >> (8 * f->chk_idx))) {
+                    RX_ESTAT_CONTA(&f->est, RX_WAIT_CHK, 1, 0, FRAME_FAIL);
+                    if (cb) cb(ctx, FRAME_FAIL, i, NULL, 0);
+                    if (f->ressinc) ok += rx_ressincroniza(f, dados[i], i, cb, ctx);
+                    else rx_rearma(f);
+                } else {
+                    RX_ESTAT_CONTA(&f->est, RX_WAIT_CHK, 1, 0, FRAME_PROGRESS);
+                    if (++f->chk_idx == chk_bytes(f->modo)) f->estado = RX_WAIT_EOF;
+                }
+                i++;
+                break;
+            }
+
+            case RX_WAIT_EOF:
+                // tratado aqui para entregar o payload antes do rx_rearma()
+                if (dados[i] == FRAME_EOF) {
+                    ok++;
+                    RX_ESTAT_CONTA(&f->est, RX_WAIT_EOF, 1, 0, FRAME_OK);
+                    if (f->despacho) rx_despacha(f->despacho, rx_payload(f), f->tamanho);
+                    if (cb) cb(ctx, FRAME_OK, i, rx_payload(f), f->tamanho);
+                    if (cb) rx_rearma(f);   // payload consumido: devolve o bloco
+                    else rx_conclui(f);
+                } else {
+                    RX_ESTAT_CONTA(&f->est, RX_WAIT_EOF, 1, 0, FRAME_FAIL);
+                    if (cb) cb(ctx, FRAME_FAIL, i, NULL, 0);
+                    if (f->ressinc) ok += rx_ressincroniza(f, dados[i], i, cb, ctx);
+                    else rx_rearma(f);
+                }
+                i++;
+                break;
+
+            default: {
+                FrameResult r = rx_handle_byte(f, dados[i]);
+                if (r == FRAME_FAIL && cb) cb(ctx, FRAME_FAIL, i, NULL, 0);
+                i++;
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+// ---------------- Recepo sem cpia (anel) ----------------
+// O chamador  dono do anel circular onde a UART/DMA escreve. O receptor
+// no copia o payload: anota onde ele est no anel e, em FRAME_OK, entrega
+// uma vista de at dois segmentos. Os bytes da vista ficam reservados at
+// o consumidor chamar rx_anel_libera(). Produtor, receptor e consumidor
+// rodam no mesmo contexto (ou o chamador serializa o acesso).
+
+typedef struct {
+    uint8_t* mem;
+    size_t cap;        // potncia de 2
+    size_t escrita;    // total de bytes escritos pelo produtor (s cresce)
+    size_t leitura;    // total de bytes j analisados pelo receptor
+    size_t liberado;   // bytes antes desta posio podem ser sobrescritos
+    size_t pendentes;  // vistas entregues e ainda no liberadas
+} RxAnel;
+
+typedef struct {
+    const uint8_t* seg[2];  // payload = seg[0][0..len[0]) + seg[1][0..len[1])
+    size_t len[2];
+    size_t inicio;          // posio absoluta do 1o byte do payload
+    size_t fim;             // posio absoluta logo aps o EOF
+} RxVista;
+
+// Receptor do modo anel: s o estado do quadro, sem buffer de payload.
+typedef struct {
+    RxState estado;
+    uint8_t pos;
+    uint8_t tamanho;
+    uint32_t calc_chk;
+    ChkModo modo;
+    uint8_t chk_idx;
+    size_t inicio;     // posio absoluta do payload do quadro em curso
+} FSM_RxAnel;
+
+// Em FRAME_OK "v"  a vista do payload; em FRAME_FAIL  NULL.
+typedef void (*RxVistaFn)(void* ctx, FrameResult r, const RxVista* v);
+
+// Capacidade mnima: o maior quadro (payload mximo com CRC-32). Num anel
+// menor esse quadro nunca cabe inteiro: o produtor espera espao e o
+// receptor espera o resto do quadro.
+#define RX_ANEL_MIN (FRAME_MAX + 3u + 4u)
+
+// Retorna false, e o anel fica com capacidade 0, se "cap" no  potncia
+// de 2 ou  menor que RX_ANEL_MIN.
+bool rx_anel_init(RxAnel* a, uint8_t* mem, size_t cap) {
+    bool ok = cap >= RX_ANEL_MIN && (cap & (cap - 1)) == 0;
+    a->mem = mem;
+    a->cap = ok ? cap : 0;
+    a->escrita = a->leitura = a->liberado = a->pendentes = 0;
+    return ok;
+}
+
+size_t rx_anel_livre(const RxAnel* a) {
+    return a->cap - (a->escrita - a->liberado);
+}
+
+// Lado do produtor (ISR/DMA). Copia o que couber e retorna quantos bytes.
+size_t rx_anel_escreve(RxAnel* a, const uint8_t* d, size_t n) {
+    size_t livre = rx_anel_livre(a);
+    if (n > livre) n = livre;
+    size_t idx = a->escrita & (a->cap - 1);
+    size_t k = (n < a->cap - idx) ? n : a->cap - idx;
+    memcpy(&a->mem[idx], d, k);
+    memcpy(a->mem, d + k, n - k);
+    a->escrita += n;
+    return n;
+}
+
+// Devolve ao produtor os bytes de uma vista. Liberar na ordem de entrega.
+void rx_anel_libera(RxAnel* a, const RxVista* v) {
+    a->pendentes--;
+    a->liberado = v->fim;
+}
+
+void rx_anel_reset(FSM_RxAnel* f, ChkModo modo) {
+    f->estado = RX_WAIT_SOF;
+    f->pos = f->tamanho = f->chk_idx = 0;
+    f->calc_chk = 0;
+    f->modo = modo;
+    f->inicio = 0;
+}
+
+// Processa "n" bytes contguos do anel cujo 1o byte est na posio
+// absoluta "abs". Retorna o nmero de quadros OK.
+static size_t rx_anel_trecho(FSM_RxAnel* f, RxAnel* a, const uint8_t* d,
+                             size_t n, size_t abs, RxVistaFn cb, void* ctx) {
+    size_t i = 0, ok = 0;
+    while (i < n) {
+        uint8_t b = d[i];
+        switch (f->estado) {
+            case RX_WAIT_SOF: {
+                const uint8_t* p = memchr(&d[i], FRAME_SOF, n - i);
+                if (!p) return ok;
+                i = (size_t)(p - d) + 1;
+                f->estado = RX_WAIT_LEN;
+                continue;
+            }
+
+            case RX_WAIT_LEN:
+                f->tamanho = b;
+                f->pos = 0;
+                f->calc_chk = chk_inicia(f->modo);
+                f->chk_idx = 0;
+                f->inicio = abs + i + 1;
+                f->estado = (b == 0) ? RX_WAIT_CHK : RX_READ_DATA;
+                break;
+
+            case RX_READ_DATA: {
+                // s dobra o checksum; o payload fica onde est
+                size_t k = (size_t)(f->tamanho - f->pos);
+                if (k > n - i) k = n - i;
+                f->calc_chk = chk_atualiza(f->modo, f->calc_chk, &d[i], k);
+                f->pos += (uint8_t)k;
+                i += k;
+                if (f->pos == f->tamanho) {
+                    f->estado = RX_WAIT_CHK;
+                }
+                continue;
+            }
+
+            case RX_WAIT_CHK: {
+                uint32_t esperado = chk_finaliza(f->modo, f->calc_chk);
+                if (b != (uint8_t)(esperado >> (8 * f->chk_idx))) {
+                    f->estado = RX_WAIT_SOF;
+                    if (cb) cb(ctx, FRAME_FAIL, NULL);
+                } else if (++f->chk_idx == chk_bytes(f->modo)) {
+                    f->estado = RX_WAIT_EOF;
+                }
+                break;
+            }
+
+            case RX_WAIT_EOF:
+                f->estado = RX_WAIT_SOF;
+                if (b == FRAME_EOF) {
+                    size_t idx = f->inicio & (a->cap - 1);
+                    RxVista v;
+                    v.len[0] = (f->tamanho < a->cap - idx) ? f->tamanho : a->cap - idx;
+                    v.len[1] = f->tamanho - v.len[0];
+                    v.seg[0] = &a->mem[idx];
+                    v.seg[1] = a->mem;
+                    v.inicio = f->inicio;
+                    v.fim = abs + i + 1;
+                    ok++;
+                    if (a->pendentes++ == 0) {
+                        a->liberado = v.inicio;  // lixo e cabealho j podem sair
+                    }
+                    if (cb) cb(ctx, FRAME_OK, &v);
+                } else if (cb) {
+                    cb(ctx, FRAME_FAIL, NULL);
+                }
+                break;
+
+            default:  // quadros estendidos no existem no modo anel
+                f->estado = RX_WAIT_SOF;
+                break;
+        }
+        i++;
+    }
+    return ok;
+}
+
+// Analisa tudo o que o produtor escreveu desde a ltima chamada. O callback
+// pode liberar a vista na hora ou guard-la para liberar depois.
+size_t rx_anel_processa(FSM_RxAnel* f, RxAnel* a, RxVistaFn cb, void* ctx) {
+    size_t ok = 0;
+    while (a->leitura != a->escrita) {
+        size_t idx = a->leitura & (a->cap - 1);
+        size_t n = a->escrita - a->leitura;
+        if (n > a->cap - idx) n = a->cap - idx;   // at o fim fsico do anel
+        ok += rx_anel_trecho(f, a, &a->mem[idx], n, a->leitura, cb, ctx);
+        a->leitura += n;
+    }
+    // sem vistas pendentes, s o payload do quadro em curso precisa ficar
+    if (a->pendentes == 0) {
+        a->liberado = (f->estado >= RX_READ_DATA) ? f->inicio : a->leitura;
+    }
+    return ok;
+}
+
+// ---------------- Receptor multicanal ----------------
+// Concentradores terminam muitos enlaces. Em vez de um FSM_Rx por enlace,
+// o estado de todos os canais fica em vetores paralelos (estrutura de
+// vetores): o lao que avana canais intercalados s toca alguns bytes por
+// canal. O payload fica  parte, num bloco de FRAME_MAX por canal
+// fornecido pelo chamador.
+
+// nmero mximo de canais (no SAMD21, definir algo como 8 antes de incluir)
+#ifndef RX_CANAIS_MAX
+#define RX_CANAIS_MAX 1024
+#endif
+
+typedef struct {
+    uint8_t  estado[RX_CANAIS_MAX];    // RxState
+    uint8_t  pos[RX_CANAIS_MAX];
+    uint8_t  tamanho[RX_CANAIS_MAX];
+    uint8_t  chk_idx[RX_CANAIS_MAX];
+    uint32_t calc_chk[RX_CANAIS_MAX];
+    uint8_t  (*payload)[FRAME_MAX];   // payload[canal]
+    uint16_t canais;
+    ChkModo  modo;                    // o mesmo para todos os canais
+#if RX_ESTAT
+    RxEstat  est[RX_CANAIS_MAX];      // por canal
+#endif
+} RxMulti;
+
+// Chamada a cada quadro concludo ou descartado em qualquer canal.
+typedef void (*RxMultiFn)(void* ctx, uint16_t canal, FrameResult r,
+                          const uint8_t* dados, uint8_t n);
+
+// "payload" deve ter "canais" blocos de FRAME_MAX bytes.
+void rx_multi_init(RxMulti* m, uint16_t canais, uint8_t (*payload)[FRAME_MAX],
+                   ChkModo modo) {
+    m->canais = canais;
+    m->payload = payload;
+    m->modo = modo;
+    memset(m->estado, RX_WAIT_SOF, canais);
+    memset(m->pos, 0, canais);
+    memset(m->tamanho, 0, canais);
+    memset(m->chk_idx, 0, canais);
+    memset(m->calc_chk, 0, canais * sizeof(m->calc_chk[0]));
+#if RX_ESTAT
+    memset(m->est, 0, canais * sizeof(m->est[0]));
+#endif
+}
+
+// Mesma mquina de rx_handle_byte(), com o estado do canal "c".
+static inline FrameResult rx_multi_byte(RxMulti* m, uint16_t c, uint8_t b) {
+    switch (m->estado[c]) {
+        case RX_WAIT_SOF:
+            if (b == FRAME_SOF) m->estado[c] = RX_WAIT_LEN;
+            break;
+
+        case RX_WAIT_LEN:
+            m->tamanho[c] = b;
+            m->pos[c] = 0;
+            m->calc_chk[c] = chk_inicia(m->modo);
+            m->chk_idx[c] = 0;
+            m->estado[c] = (b == 0) ? RX_WAIT_CHK : RX_READ_DATA;
+            break;
+
+        case RX_READ_DATA:
+            m->payload[c][m->pos[c]++] = b;
+            m->calc_chk[c] = chk_atualiza_byte(m->modo, m->calc_chk[c], b);
+            if (m->pos[c] == m->tamanho[c]) m->estado[c] = RX_WAIT_CHK;
+            break;
+
+        case RX_WAIT_CHK: {
+            uint32_t esperado = chk_finaliza(m->modo, m->calc_chk[c]);
+            if (b != (uint8_t)(esperado >> (8 * m->chk_idx[c]))) {
+                m->estado[c] = RX_WAIT_SOF;
                 return FRAME_FAIL;
             }
+            if (++m->chk_idx[c] == chk_bytes(m->modo)) m->estado[c] = RX_WAIT_EOF;
             break;
+        }
 
         case RX_WAIT_EOF:
-            rx_reset(f);
-            if (b == FRAME_EOF) return FRAME_OK;
-            else return FRAME_FAIL;
+            m->estado[c] = RX_WAIT_SOF;
+            return (b == FRAME_EOF) ? FRAME_OK : FRAME_FAIL;
     }
     return FRAME_PROGRESS;
 }
 
+// Avana os canais com uma entrada intercalada: bytes[i] chegou pelo canal
+// canal[i] (canal < m->canais). Retorna o nmero de quadros OK.
+size_t rx_multi_processa(RxMulti* m, const uint16_t* canal, const uint8_t* bytes,
+                         size_t n, RxMultiFn cb, void* ctx) {
+    size_t ok = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint16_t c = canal[i];
+#if RX_ESTAT
+        RxState antes = (RxState)m->estado[c];
+#endif
+        FrameResult r = rx_multi_byte(m, c, bytes[i]);
+        RX_ESTAT_CONTA(&m->est[c], antes, 1, antes == RX_WAIT_SOF && m->estado[c] == RX_WAIT_SOF, r);
+        if (r == FRAME_PROGRESS) continue;
+        if (r == FRAME_OK) {
+            ok++;
+            if (cb) cb(ctx, c, r, m->payload[c], m->tamanho[c]);
+        } else if (cb) {
+            cb(ctx, c, r, NULL, 0);
+        }
+    }
+    return ok;
+}
+
 // ---------------- Transmissor ----------------
 typedef struct {
     const uint8_t* dados;
-    uint8_t qtd;
+    uint16_t qtd;
 } TxPacket;
 
+// Escreve CHK (LSB primeiro) e EOF a partir do registrador do checksum.
+// Retorna quantos bytes escreveu (chk_bytes(modo) + 1).
+static size_t tx_rodape(uint8_t* out, uint32_t reg, ChkModo modo) {
+    uint32_t chk = chk_finaliza(modo, reg);
+    uint8_t n = chk_bytes(modo);
+    for (uint8_t i = 0; i < n; i++) {
+        out[i] = (uint8_t)(chk >> (8 * i));
+    }
+    out[n] = FRAME_EOF;
+    return n + 1u;
+}
+
+// Monta o quadro com o CHK do modo pedido. "buf" precisa de
+// n + 3 + chk_bytes(modo) bytes. Retorna o tamanho do quadro.
+size_t tx_compose_chk(TxPacket* tx, const uint8_t* dados, uint8_t n,
+                      uint8_t* buf, ChkModo modo) {
+    buf[0] = FRAME_SOF;
+    buf[1] = n;
+    memcpy(&buf[2], dados, n);
+    size_t idx = 2u + n;
+    idx += tx_rodape(&buf[idx], chk_atualiza(modo, chk_inicia(modo), dados, n), modo);
+    tx->dados = dados;
+    tx->qtd = n;
+    return idx;
+}
+
 void tx_compose(TxPacket* tx, const uint8_t* dados, uint8_t n, uint8_t* buf) {
-    uint8_t idx = 0;
-    buf[idx++] = FRAME_SOF;
-    buf[idx++] = n;
-    for (int i = 0; i < n; i++) {
-        buf[idx++] = dados[i];
-    }
-    buf[idx++] = gera_chk(dados, n);
-    buf[idx++] = FRAME_EOF;
+    tx_compose_chk(tx, dados, n, buf, CHK_XOR);
+}
+
+// Quadro estendido (s para um receptor com rx_configura_ext()). "buf"
+// precisa de n + 4 + chk_bytes(modo) bytes. Retorna 0 se n > FRAME_EXT_MAX.
+size_t tx_compose_ext(TxPacket* tx, const uint8_t* dados, uint16_t n,
+                      uint8_t* buf, ChkModo modo) {
+    if (n > FRAME_EXT_MAX) return 0;
+    buf[0] = FRAME_SOF_EXT;
+    buf[1] = (uint8_t)n;
+    buf[2] = (uint8_t)(n >> 8);
+    memcpy(&buf[3], dados, n);
+    size_t idx = 3 + (size_t)n;
+    idx += tx_rodape(&buf[idx], chk_atualiza(modo, chk_inicia(modo), dados, n), modo);
     tx->dados = dados;
     tx->qtd = n;
+    return idx;
 }
 
-// ---------------- Testes ----------------
-static char* teste_rx_valido() {
-    FSM_Rx rx;
-    rx_reset(&rx);
+// ---------------- Transmissor direto no anel ----------------
+// O quadro  codificado direto no anel que a UART/DMA esvazia, sem buffer
+// de montagem nem cpia para o anel depois. tx_anel_reserva() devolve o
+// espao livre em at dois segmentos; tx_anel_confirma() publica os bytes
+// de uma vez, ento o consumidor nunca v meio quadro. Produtor (tarefa) e
+// consumidor (ISR) podem rodar em contextos diferentes: cada um s escreve
+// o seu contador.
 
-    uint8_t msg[] = {'O','K','!'};
-    uint8_t chk = gera_chk(msg, 3);
-    uint8_t quadro[] = {FRAME_SOF, 3, 'O','K','!', chk, FRAME_EOF};
+typedef struct {
+    uint8_t* mem;
+    size_t cap;                // potncia de 2
+    volatile size_t escrita;   // total publicado pelo produtor (s cresce)
+    volatile size_t leitura;   // total j transmitido pelo consumidor
+} TxAnel;
 
-    FrameResult r;
-    for (int i = 0; i < sizeof(quadro)-1; i++) {
-        r = rx_handle_byte(&rx, quadro[i]);
-        checa("Falha: deveria estar em progresso", r == FRAME_PROGRESS);
-    }
-    r = rx_handle_byte(&rx, quadro[sizeof(quadro)-1]);
-    checa("Falha: quadro vlido no reconhecido", r == FRAME_OK);
-    return 0;
+// Espao reservado: seg[0][0..len[0]) + seg[1][0..len[1])
+typedef struct {
+    uint8_t* seg[2];
+    size_t len[2];
+} TxReserva;
+
+void tx_anel_init(TxAnel* a, uint8_t* mem, size_t cap) {
+    a->mem = mem;
+    a->cap = cap;
+    a->escrita = a->leitura = 0;
 }
 
-static char* teste_rx_chk_errado() {
-    FSM_Rx rx; rx_reset(&rx);
-    uint8_t quadro[] = {FRAME_SOF, 2, 'A','B', 0x99, FRAME_EOF};
+size_t tx_anel_livre(const TxAnel* a) {
+    size_t livre = a->cap - (a->escrita - a->leitura);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);   // consumidor j leu o que liberou
+    return livre;
+}
 
-    rx_handle_byte(&rx, quadro[0]);
-    rx_handle_byte(&rx, quadro[1]);
-    rx_handle_byte(&rx, quadro[2]);
-    rx_handle_byte(&rx, quadro[3]);
-    FrameResult r = rx_handle_byte(&rx, quadro[4]);
+// Reserva "n" bytes sem public-los. Falha (false) se no couberem agora.
+bool tx_anel_reserva(TxAnel* a, size_t n, TxReserva* r) {
+    if (n > tx_anel_livre(a)) return false;
+    size_t idx = a->escrita & (a->cap - 1);
+    size_t k = (n < a->cap - idx) ? n : a->cap - idx;
+    r->seg[0] = &a->mem[idx];
+    r->len[0] = k;
+    r->seg[1] = a->mem;
+    r->len[1] = n - k;
+    return true;
+}
 
-    checa("Falha: checksum invlido no detectado", r == FRAME_FAIL);
-    return 0;
+// Publica os "n" primeiros bytes da ltima reserva.
+void tx_anel_confirma(TxAnel* a, size_t n) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    a->escrita += n;
 }
 
-static char* teste_tx_monta_pacote() {
-    TxPacket tx;
-    uint8_t dados[] = {1,2,3,4};
-    uint8_t buf[4+5];
-    tx_compose(&tx, dados, 4, buf);
+// Lado do consumidor: trecho contguo pronto para a UART/DMA.
+size_t tx_anel_pendente(const TxAnel* a, const uint8_t** p) {
+    size_t n = a->escrita - a->leitura;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    size_t idx = a->leitura & (a->cap - 1);
+    *p = &a->mem[idx];
+    return (n < a->cap - idx) ? n : a->cap - idx;
+}
+
+void tx_anel_consome(TxAnel* a, size_t n) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    a->leitura += n;
+}
+
+// Copia "n" bytes para a reserva a partir do deslocamento "off".
+static void tx_reserva_escreve(TxReserva* r, size_t off, const uint8_t* d, size_t n) {
+    if (off < r->len[0]) {
+        size_t k = (n < r->len[0] - off) ? n : r->len[0] - off;
+        memcpy(&r->seg[0][off], d, k);
+        d += k;
+        n -= k;
+        off += k;
+    }
+    memcpy(&r->seg[1][off - r->len[0]], d, n);
+}
+
+// Codifica o quadro (curto, ou estendido se n > FRAME_MAX) direto no anel
+// e o publica. *precisa recebe o tamanho do quadro no anel. Retorna esse
+// tamanho, ou 0 sem escrever nada quando no h espao (tente de novo com
+// tx_anel_livre() >= *precisa). Se *precisa > cap, ou *precisa == 0
+// (n > FRAME_EXT_MAX), o quadro nunca vai caber.
+size_t tx_anel_compose(TxAnel* a, const uint8_t* dados, uint16_t n,
+                       ChkModo modo, size_t* precisa) {
+    size_t cab = (n > FRAME_MAX) ? 3 : 2;
+    size_t total = cab + n + chk_bytes(modo) + 1u;
+    TxReserva r;
+    *precisa = (n > FRAME_EXT_MAX) ? 0 : total;
+    if (*precisa == 0 || !tx_anel_reserva(a, total, &r)) return 0;
+
+    uint8_t c[3] = {(n > FRAME_MAX) ? FRAME_SOF_EXT : FRAME_SOF, (uint8_t)n, (uint8_t)(n >> 8)};
+    uint8_t rod[5];
+    size_t k = tx_rodape(rod, chk_atualiza(modo, chk_inicia(modo), dados, n), modo);
+    tx_reserva_escreve(&r, 0, c, cab);
+    tx_reserva_escreve(&r, cab, dados, n);
+    tx_reserva_escreve(&r, cab + n, rod, k);
+    tx_anel_confirma(a, total);
+    return total;
+}
+
+// ---------------- Transmissor scatter-gather ----------------
+// O payload pode vir em pedaos (cabealho da aplicao, amostras, ...)
+// sem que o chamador precise junt-los antes.
+typedef struct {
+    const uint8_t* base;
+    size_t len;
+} TxIov;
+
+#define TX_SG_MAX_PEDACOS 8
+
+// Quadro montado sem copiar o payload: o encoder s escreve cabealho e
+// rodap. "iov"  a lista pronta para writev()/DMA com lista de descritores:
+// cabealho, pedaos do chamador, rodap.
+typedef struct {
+    uint8_t cab[2];
+    uint8_t rod[5];
+    TxIov iov[TX_SG_MAX_PEDACOS + 2];
+    size_t qtd_iov;
+    size_t total;      // bytes do quadro no fio
+} TxQuadroSG;
+
+static size_t tx_iov_total(const TxIov* pedacos, size_t qtd) {
+    size_t n = 0;
+    for (size_t i = 0; i < qtd; i++) n += pedacos[i].len;
+    return n;
+}
+
+// Falha (false) se o payload passar de FRAME_MAX ou houver pedaos demais.
+// Os pedaos precisam continuar vlidos at o quadro ser transmitido.
+bool tx_compose_sg(TxQuadroSG* q, const TxIov* pedacos, size_t qtd, ChkModo modo) {
+    size_t n = tx_iov_total(pedacos, qtd);
+    if (n > FRAME_MAX || qtd > TX_SG_MAX_PEDACOS) return false;
+
+    uint32_t reg = chk_inicia(modo);
+    q->cab[0] = FRAME_SOF;
+    q->cab[1] = (uint8_t)n;
+    q->iov[0].base = q->cab;
+    q->iov[0].len = 2;
+    q->qtd_iov = 1;
+    for (size_t i = 0; i < qtd; i++) {
+        if (pedacos[i].len == 0) continue;
+        reg = chk_atualiza(modo, reg, pedacos[i].base, pedacos[i].len);
+        q->iov[q->qtd_iov++] = pedacos[i];
+    }
+    q->iov[q->qtd_iov].base = q->rod;
+    q->iov[q->qtd_iov].len = tx_rodape(q->rod, reg, modo);
+    q->qtd_iov++;
+    q->total = 2 + n + chk_bytes(modo) + 1u;
+    return true;
+}
+
+// Mesmo quadro, mas copiado (em bloco) para "buf". Retorna o tamanho do
+// quadro ou 0 se o payload passar de FRAME_MAX ou no couber em "cap".
+size_t tx_compose_iov(const TxIov* pedacos, size_t qtd, uint8_t* buf,
+                      size_t cap, ChkModo modo) {
+    size_t n = tx_iov_total(pedacos, qtd);
+    size_t total = 2 + n + chk_bytes(modo) + 1u;
+    if (n > FRAME_MAX || total > cap) return 0;
+
+    uint32_t reg = chk_inicia(modo);
+    size_t idx = 2;
+    buf[0] = FRAME_SOF;
+    buf[1] = (uint8_t)n;
+    for (size_t i = 0; i < qtd; i++) {
+        if (pedacos[i].len == 0) continue;
+        memcpy(&buf[idx], pedacos[i].base, pedacos[i].len);
+        reg = chk_atualiza(modo, reg, pedacos[i].base, pedacos[i].len);
+        idx += pedacos[i].len;
+    }
+    tx_rodape(&buf[idx], reg, modo);
+    return total;
+}
+
+// Um quadro do lote: a lista de pedaos do seu payload.
+typedef struct {
+    const TxIov* pedacos;
+    size_t qtd;
+} TxLoteItem;
+
+// Empacota vrios quadros, um aps o outro, num s buffer para uma nica
+// transmisso (UART/DMA). usados[i] recebe os bytes do quadro i, ou 0 para
+// os quadros que no entraram (invlido ou sem espao; o lote para a).
+// Retorna quantos quadros foram empacotados.
+size_t tx_compose_lote(const TxLoteItem* quadros, size_t n, uint8_t* buf,
+                       size_t cap, ChkModo modo, size_t* usados) {
+    size_t idx = 0, feitos = 0;
+    for (size_t q = 0; q < n; q++) {
+        usados[q] = 0;
+        if (feitos < q) continue;
+        size_t k = tx_compose_iov(quadros[q].pedacos, quadros[q].qtd,
+                                  &buf[idx], cap - idx, modo);
+        if (k == 0) continue;
+        usados[q] = k;
+        idx += k;
+        feitos++;
+    }
+    return feitos;
+}
+
+// ---------------- Modo COBS ----------------
+// Enquadramento alternativo: COBS(payload || CHK) 0x00. Como o quadro
+// codificado no tem zeros, o receptor acha a fronteira com uma busca
+// por palavra/SIMD (cobs_busca_zero) e decodifica o quadro em uma passada,
+// sem a mquina de estados byte a byte. Payload de at FRAME_MAX bytes.
+
+// "buf" precisa de COBS_MAX(n + chk_bytes(modo)) + 1 bytes. Retorna o
+// tamanho do quadro, delimitador incluso.
+size_t tx_compose_cobs(const uint8_t* dados, uint8_t n, uint8_t* buf, ChkModo modo) {
+    uint8_t rod[5];
+    tx_rodape(rod, chk_atualiza(modo, chk_inicia(modo), dados, n), modo);
+    CobsEnc e;
+    cobs_enc_inicia(&e, buf);
+    cobs_enc_bytes(&e, dados, n);
+    cobs_enc_bytes(&e, rod, chk_bytes(modo));   // sem o EOF
+    size_t t = cobs_enc_fim(&e);
+    buf[t++] = 0x00;
+    return t;
+}
+
+typedef struct {
+    uint8_t acum[COBS_MAX(FRAME_MAX + 4)];  // quadro que chegou em pedaos
+    size_t acum_n;
+    bool descarta;                          // estourou acum: espera o prximo 0x00
+    uint8_t buf[FRAME_MAX + 4];             // decodificado: payload + CHK
+    ChkModo modo;
+} RxCobs;
+
+void rx_cobs_reset(RxCobs* r, ChkModo modo) {
+    r->acum_n = 0;
+    r->descarta = false;
+    r->modo = modo;
+}
+
+// Um quadro completo (sem o delimitador). Delimitadores seguidos (quadro
+// vazio) so ociosidade e no geram evento.
+static size_t rx_cobs_quadro(RxCobs* r, const uint8_t* q, size_t qn, size_t offset,
+                             RxQuadroFn cb, void* ctx) {
+    size_t dn;
+    if (qn == 0 && !r->descarta) return 0;
+    uint8_t nc = chk_bytes(r->modo);
+    if (!r->descarta && cobs_decodifica(q, qn, r->buf, sizeof(r->buf), &dn) &&
+        dn >= nc && dn - nc <= FRAME_MAX) {
+        uint16_t n = (uint16_t)(dn - nc);
+        uint32_t chk = chk_finaliza(r->modo, chk_atualiza(r->modo, chk_inicia(r->modo), r->buf, n));
+        uint32_t rec = 0;
+        for (uint8_t k = 0; k < nc; k++) rec |= (uint32_t)r->buf[n + k] << (8 * k);
+        if (rec == chk) {
+            if (cb) cb(ctx, FRAME_OK, offset, r->buf, n);
+            return 1;
+        }
+    }
+    if (cb) cb(ctx, FRAME_FAIL, offset, NULL, 0);
+    return 0;
+}
+
+// Mesmo contrato de rx_handle_bytes(); offset aponta para o delimitador.
+size_t rx_cobs_processa(RxCobs* r, const uint8_t* dados, size_t n,
+                        RxQuadroFn cb, void* ctx) {
+    size_t i = 0, ok = 0;
+    while (i < n) {
+        size_t k = cobs_busca_zero(&dados[i], n - i);
+        if (r->acum_n || r->descarta || i + k == n) {
+            // quadro partido entre blocos: junta em acum
+            if (r->acum_n + k > sizeof(r->acum)) {
+                r->descarta = true;
+            } else if (!r->descarta) {
+                memcpy(&r->acum[r->acum_n], &dados[i], k);
+                r->acum_n += k;
+            }
+            if (i + k == n) break;
+            ok += rx_cobs_quadro(r, r->acum, r->acum_n, i + k, cb, ctx);
+        } else {
+            // quadro inteiro dentro do bloco: decodifica direto da entrada
+            ok += rx_cobs_quadro(r, &dados[i], k, i + k, cb, ctx);
+        }
+        r->acum_n = 0;
+        r->descarta = false;
+        i += k + 1;
+    }
+    return ok;
+}
+
+// ---------------- Agregao de mensagens (TLV) ----------------
+// Vrias mensagens curtas num s quadro: o payload  uma sequncia de
+// [tipo][len][valor...]. O quadro fecha ao atingir "limite" bytes de
+// payload ou "espera" ticks depois da 1a mensagem, o que vier antes.
+// Na recepo o payload  percorrido no lugar, sem copiar as mensagens.
+typedef struct {
+    uint8_t buf[FRAME_MAX];
+    uint8_t n;          // bytes de payload ocupados
+    uint8_t msgs;
+    uint8_t limite;     // fecha ao atingir este tamanho (<= FRAME_MAX)
+    uint32_t espera;    // ticks mximos entre a 1a mensagem e o envio
+    uint32_t inicio;    // tick da 1a mensagem do quadro
+} TlvAgregador;
+
+typedef struct {
+    uint8_t tipo;
+    uint8_t n;
+    const uint8_t* valor;   // aponta para dentro do payload recebido
+} TlvMsg;
+
+typedef struct {
+    const uint8_t* p;
+    uint16_t resto;
+    bool erro;          // payload terminou no meio de uma mensagem
+} TlvIter;
+
+void tlv_inicia(TlvAgregador* a, uint8_t limite, uint32_t espera) {
+    a->n = 0;
+    a->msgs = 0;
+    a->limite = limite;
+    a->espera = espera;
+    a->inicio = 0;
+}
+
+// Falso se a mensagem no cabe no quadro em montagem: feche-o com
+// tlv_fecha() e adicione de novo.
+bool tlv_adiciona(TlvAgregador* a, uint8_t tipo, const uint8_t* valor,
+                  uint8_t n, uint32_t agora) {
+    if ((size_t)a->n + 2 + n > FRAME_MAX) return false;
+    if (a->msgs == 0) a->inicio = agora;
+    a->buf[a->n] = tipo;
+    a->buf[a->n + 1] = n;
+    memcpy(&a->buf[a->n + 2], valor, n);
+    a->n += (uint8_t)(2 + n);
+    a->msgs++;
+    return true;
+}
+
+// Hora de enviar: atingiu o tamanho ou a 1a mensagem j esperou demais.
+bool tlv_pronto(const TlvAgregador* a, uint32_t agora) {
+    return a->msgs && (a->n >= a->limite || (uint32_t)(agora - a->inicio) >= a->espera);
+}
+
+// Monta o quadro (tx_compose_chk) com o que foi agregado e esvazia o
+// agregador. "quadro" precisa de FRAME_MAX + 3 + chk_bytes(modo) bytes.
+// Retorna o tamanho do quadro, ou 0 se no havia mensagens.
+size_t tlv_fecha(TlvAgregador* a, TxPacket* tx, uint8_t* quadro, ChkModo modo) {
+    if (a->msgs == 0) return 0;
+    size_t t = tx_compose_chk(tx, a->buf, a->n, quadro, modo);
+    a->n = 0;
+    a->msgs = 0;
+    return t;
+}
+
+void tlv_iter_inicia(TlvIter* it, const uint8_t* payload, uint16_t n) {
+    it->p = payload;
+    it->resto = n;
+    it->erro = false;
+}
+
+// Prxima mensagem do payload; falso no fim (ou em payload malformado,
+// com it->erro ligado). O payload precisa continuar vlido enquanto as
+// mensagens forem usadas.
+bool tlv_proxima(TlvIter* it, TlvMsg* m) {
+    if (it->resto == 0) return false;
+    if (it->resto < 2 || it->p[1] > it->resto - 2) {
+        it->erro = true;
+        it->resto = 0;
+        return false;
+    }
+    m->tipo = it->p[0];
+    m->n = it->p[1];
+    m->valor = &it->p[2];
+    it->p += 2 + m->n;
+    it->resto -= (uint16_t)(2 + m->n);
+    return true;
+}
+
+// ---------------- Compresso por quadro ----------------
+// Opcional: payload = [flags][seq][LZSS ou cru]. A janela do LZSS alcana
+// os ltimos LZ_JANELA bytes de payload j enviados, ento os dois lados
+// mantm o mesmo histrico (LzCanal). Um quadro perdido quebra o histrico
+// do RX, que passa a descartar quadros at o prximo independente
+// (LZ_FLAG_INDEP), emitido pelo TX a cada "intervalo" quadros.
+#define LZ_FLAG_LZSS   0x01   // seno, o resto do payload vai cru
+#define LZ_FLAG_INDEP  0x02   // no usa o histrico: ponto de ressincronizao
+#define LZ_CAB         2
+#define LZ_PAYLOAD_MAX (FRAME_MAX - LZ_CAB)
+
+typedef struct {
+    uint8_t hist[LZ_JANELA];  // ltimos bytes de payload (originais)
+    uint16_t hist_n;
+    uint8_t seq;              // prximo nmero de sequncia
+    bool sincronizado;        // RX: histrico igual ao do TX
+    uint8_t intervalo;        // TX: quadros entre independentes (0 = s o 1o)
+    uint8_t desde_indep;      // TX: 0 = o prximo sai independente
+} LzCanal;
+
+void lz_canal_inicia(LzCanal* c, uint8_t intervalo) {
+    c->hist_n = 0;
+    c->seq = 0;
+    c->sincronizado = false;
+    c->intervalo = intervalo;
+    c->desde_indep = 0;
+}
+
+// TX: o prximo quadro sai independente (ex.: depois de esgotar as
+// retransmisses, quando no se sabe o que o RX recebeu).
+void lz_canal_forca_indep(LzCanal* c) {
+    c->desde_indep = 0;
+}
+
+static void lz_historico(LzCanal* c, const uint8_t* d, size_t n) {
+    if (n >= LZ_JANELA) {
+        memcpy(c->hist, &d[n - LZ_JANELA], LZ_JANELA);
+        c->hist_n = LZ_JANELA;
+        return;
+    }
+    size_t manter = (c->hist_n < LZ_JANELA - n) ? c->hist_n : LZ_JANELA - n;
+    memmove(c->hist, &c->hist[c->hist_n - manter], manter);
+    memcpy(&c->hist[manter], d, n);
+    c->hist_n = (uint16_t)(manter + n);
+}
+
+// Mesmo contrato de tx_compose_chk(), com n <= LZ_PAYLOAD_MAX. S comprime
+// quando o resultado  menor. tx->dados aponta para o payload original.
+// Retorna 0, sem mexer no canal, se n > LZ_PAYLOAD_MAX.
+size_t tx_compose_lz(LzCanal* c, TxPacket* tx, const uint8_t* dados, uint8_t n,
+                     uint8_t* buf, ChkModo modo) {
+    if (n > LZ_PAYLOAD_MAX) return 0;
+    uint8_t trab[LZ_JANELA + LZ_PAYLOAD_MAX];
+    uint8_t pl[FRAME_MAX];
+    bool indep = c->desde_indep == 0;
+    size_t ini = indep ? 0 : c->hist_n;
+    memcpy(trab, c->hist, ini);
+    memcpy(&trab[ini], dados, n);
+    size_t k = lz_comprime(trab, ini, ini + n, &pl[LZ_CAB], (size_t)n - (n > 0));
+    pl[0] = (uint8_t)((k ? LZ_FLAG_LZSS : 0) | (indep ? LZ_FLAG_INDEP : 0));
+    pl[1] = c->seq++;
+    if (!k) {
+        memcpy(&pl[LZ_CAB], dados, n);
+        k = n;
+    }
+    if (indep) c->hist_n = 0;
+    lz_historico(c, dados, n);
+    c->desde_indep = c->intervalo ? (uint8_t)((c->desde_indep + 1) % c->intervalo) : 1;
+
+    size_t t = tx_compose_chk(tx, pl, (uint8_t)(k + LZ_CAB), buf, modo);
+    tx->dados = dados;
+    tx->qtd = n;
+    return t;
+}
+
+// RX: abre o payload entregue pelo receptor (em ordem). Retorna o payload
+// original (dentro de "dados" se veio cru, seno em "tmp", que precisa de
+// LZ_JANELA + LZ_PAYLOAD_MAX bytes), ou NULL se for malformado, duplicado
+// (retransmisso do ltimo) ou se o histrico estiver quebrado.
+const uint8_t* rx_lz_abre(LzCanal* c, const uint8_t* dados, uint16_t n,
+                          uint8_t* tmp, uint16_t* out_n) {
+    if (n < LZ_CAB || (dados[0] & ~(LZ_FLAG_LZSS | LZ_FLAG_INDEP))) return NULL;
+    uint8_t seq = dados[1];
+    if (c->sincronizado && seq == (uint8_t)(c->seq - 1)) return NULL;  // retransmisso
+    if (dados[0] & LZ_FLAG_INDEP) {
+        c->hist_n = 0;
+        c->sincronizado = true;
+    } else if (!c->sincronizado || seq != c->seq) {
+        if (seq != (uint8_t)(c->seq - 1)) c->sincronizado = false;  // perdeu quadro
+        return NULL;
+    }
+
+    const uint8_t* p = &dados[LZ_CAB];
+    size_t pn = n - LZ_CAB;
+    if (dados[0] & LZ_FLAG_LZSS) {
+        size_t fim;
+        memcpy(tmp, c->hist, c->hist_n);
+        if (!lz_descomprime(p, pn, tmp, c->hist_n, c->hist_n + LZ_PAYLOAD_MAX, &fim)) {
+            c->sincronizado = false;
+            return NULL;
+        }
+        p = &tmp[c->hist_n];
+        pn = fim - c->hist_n;
+    }
+    lz_historico(c, p, pn);
+    c->seq = (uint8_t)(seq + 1);
+    *out_n = (uint16_t)pn;
+    return p;
+}
+
+// ---------------- Dialetos ----------------
+// Uma porta por dialeto de dialetos.h, cada uma com o parser instanciado
+// para as suas constantes (dialeto_rx.h). "generico"  o mesmo cdigo
+// lendo o RxEspec da porta: serve para dialeto conhecido s em tempo de
+// execuo e de referncia em bench_dialetos.
+#define DIALETO ESPEC_ENLACE
+#include "dialeto_rx.h"
+#define DIALETO ESPEC_PONTEIRO
+#include "dialeto_rx.h"
+#define DIALETO ESPEC_RADIO
+#include "dialeto_rx.h"
+#define DIALETO_NOME generico
+#define DIALETO_BUF  FRAME_MAX
+#include "dialeto_rx.h"
+
+#if !defined(__ARM_ARCH_6M__)
+// Especificaes para a porta "generico" nos testes e em bench_dialetos.
+static const RxEspec espec_dialetos[] = {
+    ESPEC_RUNTIME(ESPEC_ENLACE),
+    ESPEC_RUNTIME(ESPEC_PONTEIRO),
+    ESPEC_RUNTIME(ESPEC_RADIO),
+};
+#endif
+
+// Com FSM_SEM_MAIN o arquivo pode ser includo em outro programa
+// (Fuzz/pior_caso.c) sem os testes, benchmarks e main().
+#ifndef FSM_SEM_MAIN
+
+// ---------------- Testes ----------------
+// S no host: no Cortex-M0+ o main() roda apenas a sute de desempenho.
+#if !defined(__ARM_ARCH_6M__)
+// Os receptores dos testes vivem na pilha e no devolvem o bloco do pool
+// ao sair: cada teste comea com o pool padro vazio.
+static void teste_prepara(void) {
+#if RX_POOL
+    pool_init(&rx_pool_padrao, rx_pool_mem[0], FRAME_MAX, RX_POOL_BLOCOS);
+#endif
+}
+
+static char* teste_rx_valido() {
+    FSM_Rx rx;
+    rx_reset(&rx);
+
+    uint8_t msg[] = {'O','K','!'};
+    uint8_t chk = gera_chk(msg, 3);
+    uint8_t quadro[] = {FRAME_SOF, 3, 'O','K','!', chk, FRAME_EOF};
+
+    FrameResult r;
+    for (int i = 0; i < sizeof(quadro)-1; i++) {
+        r = rx_handle_byte(&rx, quadro[i]);
+        checa("Falha: deveria estar em progresso", r == FRAME_PROGRESS);
+    }
+    r = rx_handle_byte(&rx, quadro[sizeof(quadro)-1]);
+    checa("Falha: quadro vlido no reconhecido", r == FRAME_OK);
+    return 0;
+}
+
+static char* teste_rx_chk_errado() {
+    FSM_Rx rx; rx_reset(&rx);
+    uint8_t quadro[] = {FRAME_SOF, 2, 'A','B', 0x99, FRAME_EOF};
+
+    rx_handle_byte(&rx, quadro[0]);
+    rx_handle_byte(&rx, quadro[1]);
+    rx_handle_byte(&rx, quadro[2]);
+    rx_handle_byte(&rx, quadro[3]);
+    FrameResult r = rx_handle_byte(&rx, quadro[4]);
+
+    checa("Falha: checksum invlido no detectado", r == FRAME_FAIL);
+    return 0;
+}
+
+static char* teste_tx_monta_pacote() {
+    TxPacket tx;
+    uint8_t dados[] = {1,2,3,4};
+    uint8_t buf[4+5];
+    tx_compose(&tx, dados, 4, buf);
 
     checa("Erro STX", buf[0] == FRAME_SOF);
     checa("Erro LEN", buf[1] == 4);
@@ -167,15 +1735,2236 @@ static char* teste_tx_monta_pacote() {
     return 0;
 }
 
-// ---------------- Runner ----------------
-static char* roda_todos(void) {
-    roda_teste(teste_rx_valido);
-    roda_teste(teste_rx_chk_errado);
-    roda_teste(teste_tx_monta_pacote);
+// Todas as variantes do checksum devem bater com o lao byte a byte,
+// para qualquer tamanho e alinhamento.
+static char* teste_chk_kernels() {
+    static uint8_t mem[FRAME_MAX + 64];
+    for (size_t i = 0; i < sizeof(mem); i++) mem[i] = (uint8_t)(i * 151 + 7);
+
+    for (size_t desl = 0; desl < 32; desl++) {
+        for (size_t n = 0; n <= FRAME_MAX; n++) {
+            const uint8_t* d = &mem[desl];
+            uint8_t ref = chk_xor_byte(d, n);
+            checa("Checksum: palavra difere", chk_xor_palavra(d, n) == ref);
+#if defined(__SSE2__)
+            checa("Checksum: SSE2 difere", chk_xor_sse2(d, n) == ref);
+#endif
+#if defined(__AVX2__)
+            checa("Checksum: AVX2 difere", chk_xor_avx2(d, n) == ref);
+#endif
+            checa("Checksum: gera_chk difere", gera_chk(d, (uint8_t)n) == ref);
+        }
+    }
+    return 0;
+}
+
+static char* teste_crc_referencia() {
+    const uint8_t txt[] = "123456789";
+    checa("CRC-16 nibble", crc16_atualiza_nibble(CRC16_INICIAL, txt, 9) == 0x29B1);
+    checa("CRC-16", crc16_atualiza(CRC16_INICIAL, txt, 9) == 0x29B1);
+    checa("CRC-32 nibble", ~crc32_atualiza_nibble(CRC32_INICIAL, txt, 9) == 0xCBF43926u);
+    checa("CRC-32", chk_finaliza(CHK_CRC32, crc32_atualiza(CRC32_INICIAL, txt, 9)) == 0xCBF43926u);
+
+    // nibble e slicing-by-8 devem concordar para qualquer tamanho,
+    // alinhamento e diviso incremental
+    static uint8_t mem[FRAME_MAX + 8];
+    for (size_t i = 0; i < sizeof(mem); i++) mem[i] = (uint8_t)(i * 89 + 3);
+    for (size_t desl = 0; desl < 8; desl++) {
+        for (size_t n = 0; n <= FRAME_MAX; n++) {
+            const uint8_t* d = &mem[desl];
+            uint16_t c16 = crc16_atualiza_nibble(CRC16_INICIAL, d, n);
+            uint32_t c32 = crc32_atualiza_nibble(CRC32_INICIAL, d, n);
+            checa("CRC-16 difere", crc16_atualiza(CRC16_INICIAL, d, n) == c16);
+            checa("CRC-32 difere", crc32_atualiza(CRC32_INICIAL, d, n) == c32);
+            size_t m = n / 3;
+            checa("CRC-16 incremental",
+                  crc16_atualiza(crc16_atualiza(CRC16_INICIAL, d, m), d + m, n - m) == c16);
+            checa("CRC-32 incremental",
+                  crc32_atualiza(crc32_atualiza(CRC32_INICIAL, d, m), d + m, n - m) == c32);
+        }
+    }
+    return 0;
+}
+
+static char* teste_rx_crc() {
+    const ChkModo modos[] = {CHK_CRC16, CHK_CRC32};
+    uint8_t payload[40];
+    for (int i = 0; i < 40; i++) payload[i] = (uint8_t)(i * 13);
+
+    for (int m = 0; m < 2; m++) {
+        TxPacket tx;
+        uint8_t quadro[40 + 7];
+        size_t n = tx_compose_chk(&tx, payload, 40, quadro, modos[m]);
+        checa("CRC: tamanho do quadro", n == 40u + 3u + chk_bytes(modos[m]));
+
+        FSM_Rx rx; rx_reset(&rx);
+        rx_configura_chk(&rx, modos[m]);
+        FrameResult r = FRAME_PROGRESS;
+        for (size_t i = 0; i < n; i++) r = rx_handle_byte(&rx, quadro[i]);
+        checa("CRC: quadro vlido byte a byte", r == FRAME_OK);
+        checa("CRC: bloco vlido", rx_handle_bytes(&rx, quadro, n, NULL, NULL) == 1);
+
+        // erro em rajada que o XOR no v: mesmo bit em dois bytes
+        quadro[2] ^= 0x01;
+        quadro[3] ^= 0x01;
+        checa("CRC: rajada no detectada", rx_handle_bytes(&rx, quadro, n, NULL, NULL) == 0);
+    }
+
+    // o mesmo erro passa despercebido no modo XOR
+    TxPacket tx;
+    uint8_t quadro[40 + 4];
+    tx_compose(&tx, payload, 40, quadro);
+    quadro[2] ^= 0x01;
+    quadro[3] ^= 0x01;
+    FSM_Rx rx; rx_reset(&rx);
+    checa("XOR: rajada deveria passar", rx_handle_bytes(&rx, quadro, sizeof(quadro), NULL, NULL) == 1);
+    return 0;
+}
+
+// Guarda as vistas entregues pelo modo anel (sem liberar)
+typedef struct {
+    size_t qtd, falhas;
+    RxVista v[8];
+} Vistas;
+
+static void guarda_vista(void* ctx, FrameResult r, const RxVista* v) {
+    Vistas* vs = ctx;
+    if (r == FRAME_OK && vs->qtd < 8) vs->v[vs->qtd++] = *v;
+    if (r == FRAME_FAIL) vs->falhas++;
+}
+
+static bool vista_igual(const RxVista* v, const uint8_t* d, size_t n) {
+    return v->len[0] + v->len[1] == n &&
+           memcmp(v->seg[0], d, v->len[0]) == 0 &&
+           memcmp(v->seg[1], d + v->len[0], v->len[1]) == 0;
+}
+
+static char* teste_rx_anel() {
+    uint8_t mem[512], pequeno[256];
+    RxAnel a;
+    checa("Anel: capacidade menor que um quadro aceita", !rx_anel_init(&a, pequeno, sizeof(pequeno)));
+    checa("Anel: capacidade que no  potncia de 2 aceita", !rx_anel_init(&a, mem, 300));
+    checa("Anel: capacidade vlida recusada", rx_anel_init(&a, mem, sizeof(mem)));
+    FSM_RxAnel rx; rx_anel_reset(&rx, CHK_XOR);
+    uint8_t payload[20], quadro[24];
+    bool dois_segmentos = false;
+    TxPacket tx;
+
+    // 50 quadros de 24 bytes num anel de 512: o payload d a volta no anel
+    for (int q = 0; q < 50; q++) {
+        for (int i = 0; i < 20; i++) payload[i] = (uint8_t)(q * 20 + i);
+        tx_compose(&tx, payload, 20, quadro);
+        checa("Anel: sem espao com tudo liberado", rx_anel_escreve(&a, quadro, 24) == 24);
+
+        Vistas vs = {0};
+        checa("Anel: quadro no reconhecido", rx_anel_processa(&rx, &a, guarda_vista, &vs) == 1);
+        checa("Anel: payload diferente", vista_igual(&vs.v[0], payload, 20));
+        dois_segmentos |= vs.v[0].len[1] != 0;
+        rx_anel_libera(&a, &vs.v[0]);
+    }
+    checa("Anel: nenhum payload cruzou o fim do anel", dois_segmentos);
+    checa("Anel: espao no devolvido", rx_anel_livre(&a) == sizeof(mem));
+    return 0;
+}
+
+// Vistas no liberadas seguram o espao do anel (contrapresso)
+static char* teste_rx_anel_contrapressao() {
+    uint8_t mem[512];
+    RxAnel a; rx_anel_init(&a, mem, sizeof(mem));
+    FSM_RxAnel rx; rx_anel_reset(&rx, CHK_CRC16);
+    uint8_t p1[] = {1, 2, 3, 4, 5, 6}, p2[] = {7, 8, 9};
+    uint8_t quadro[16];
+    TxPacket tx;
+    Vistas vs = {0};
+
+    size_t n = tx_compose_chk(&tx, p1, sizeof(p1), quadro, CHK_CRC16);
+    rx_anel_escreve(&a, (const uint8_t*)"lixo", 4);
+    rx_anel_escreve(&a, quadro, n);
+    rx_anel_escreve(&a, quadro, 5);                  // 2o quadro pela metade
+    rx_anel_processa(&rx, &a, guarda_vista, &vs);
+    checa("Anel/CRC: 1o quadro", vs.qtd == 1 && vista_igual(&vs.v[0], p1, sizeof(p1)));
+    checa("Anel: vista pendente no segura espao",
+          rx_anel_livre(&a) == sizeof(mem) - (4 + n + 5) + 4 + 2);
+
+    rx_anel_libera(&a, &vs.v[0]);
+    rx_anel_processa(&rx, &a, guarda_vista, &vs);
+    checa("Anel: quadro em curso no segura espao",
+          rx_anel_livre(&a) == sizeof(mem) - 3);     // payload parcial: 3 bytes
+
+    // o 2o quadro  abandonado: o resto dele  corrompido
+    uint8_t resto[] = {0x11, 0x22, 0x33, 0x44, 0x55, FRAME_EOF};
+    rx_anel_escreve(&a, resto, sizeof(resto));
+    n = tx_compose_chk(&tx, p2, sizeof(p2), quadro, CHK_CRC16);
+    rx_anel_escreve(&a, quadro, n);
+    rx_anel_processa(&rx, &a, guarda_vista, &vs);
+    checa("Anel: CRC errado no detectado", vs.falhas == 1);
+    checa("Anel: 3o quadro", vs.qtd == 2 && vista_igual(&vs.v[1], p2, sizeof(p2)));
+    return 0;
+}
+
+// Pedaos devem gerar o mesmo quadro que o payload contguo
+static char* teste_tx_sg() {
+    uint8_t cab[] = {0x10, 0x20}, amostras[] = {1, 2, 3, 4, 5}, fim[] = {0xEE};
+    uint8_t junto[] = {0x10, 0x20, 1, 2, 3, 4, 5, 0xEE};
+    TxIov pedacos[] = {{cab, 2}, {NULL, 0}, {amostras, 5}, {fim, 1}};
+    const ChkModo modos[] = {CHK_XOR, CHK_CRC16, CHK_CRC32};
+
+    for (int m = 0; m < 3; m++) {
+        uint8_t ref[8 + 7], plano[8 + 7], sg[8 + 7];
+        TxPacket tx;
+        size_t n = tx_compose_chk(&tx, junto, sizeof(junto), ref, modos[m]);
+
+        checa("SG: tx_compose_iov", tx_compose_iov(pedacos, 4, plano, sizeof(plano), modos[m]) == n);
+        checa("SG: quadro copiado difere", memcmp(plano, ref, n) == 0);
+
+        TxQuadroSG q;
+        checa("SG: tx_compose_sg", tx_compose_sg(&q, pedacos, 4, modos[m]));
+        checa("SG: total", q.total == n);
+        checa("SG: pedao vazio no deve virar iov", q.qtd_iov == 5);
+        checa("SG: payload deveria ser referenciado", q.iov[2].base == amostras);
+        size_t idx = 0;
+        for (size_t i = 0; i < q.qtd_iov; i++) {
+            memcpy(&sg[idx], q.iov[i].base, q.iov[i].len);
+            idx += q.iov[i].len;
+        }
+        checa("SG: quadro da lista difere", idx == n && memcmp(sg, ref, n) == 0);
+    }
+
+    checa("SG: cabe no buffer", tx_compose_iov(pedacos, 4, junto, 8, CHK_XOR) == 0);
+    return 0;
+}
+
+static char* teste_tx_lote() {
+    uint8_t a[] = {'a'}, b[200], c[] = {'c', 'c'};
+    memset(b, 'b', sizeof(b));
+    TxIov pa[] = {{a, 1}}, pb[] = {{b, 200}}, pc[] = {{c, 2}};
+    TxLoteItem lote[] = {{pa, 1}, {pc, 1}, {pb, 1}, {pc, 1}};
+    size_t usados[4];
+    uint8_t buf[64];
+
+    // o 3o quadro no cabe: o lote para nele
+    size_t feitos = tx_compose_lote(lote, 4, buf, sizeof(buf), CHK_CRC16, usados);
+    checa("Lote: quadros empacotados", feitos == 2);
+    checa("Lote: bytes por quadro", usados[0] == 1 + 5 && usados[1] == 2 + 5);
+    checa("Lote: quadros fora do lote", usados[2] == 0 && usados[3] == 0);
+
+    FSM_Rx rx; rx_reset(&rx);
+    rx_configura_chk(&rx, CHK_CRC16);
+    checa("Lote: receptor no reconheceu o lote",
+          rx_handle_bytes(&rx, buf, usados[0] + usados[1], NULL, NULL) == 2);
+
+    static uint8_t grande[4 * (FRAME_MAX + 4)];
+    feitos = tx_compose_lote(lote, 4, grande, sizeof(grande), CHK_XOR, usados);
+    checa("Lote: todos deveriam caber", feitos == 4 && usados[2] == 204);
+    rx_reset(&rx);
+    checa("Lote: receptor XOR", rx_handle_bytes(&rx, grande, 5 + 6 + 204 + 6, NULL, NULL) == 4);
+    return 0;
+}
+
+// Esvazia o anel como a UART/DMA faria, juntando os bytes em "fio".
+static size_t tx_anel_esvazia(TxAnel* a, uint8_t* fio) {
+    const uint8_t* p;
+    size_t n = 0, k;
+    while ((k = tx_anel_pendente(a, &p)) > 0) {
+        memcpy(&fio[n], p, k);
+        tx_anel_consome(a, k);
+        n += k;
+    }
+    return n;
+}
+
+// Quadros de 45 bytes num anel de 64: com um quadro pendente o prximo no
+// cabe e nada  escrito (would-block); depois que o anel esvazia ele entra,
+// dando a volta no anel. O receptor recebe todos.
+static char* teste_tx_anel() {
+    uint8_t mem[64], payload[40], fio[8 * 45];
+    TxAnel a; tx_anel_init(&a, mem, sizeof(mem));
+    size_t n = 0, precisa;
+    for (int q = 0; q < 8; q++) {
+        for (int i = 0; i < 40; i++) payload[i] = (uint8_t)(q * 40 + i);
+        size_t antes = a.escrita;
+        size_t t = tx_anel_compose(&a, payload, 40, CHK_CRC16, &precisa);
+        if (q > 0) {
+            checa("Anel TX: quadro sem espao foi escrito", t == 0 && a.escrita == antes);
+            checa("Anel TX: espao necessrio", precisa == 45 && tx_anel_livre(&a) < precisa);
+            n += tx_anel_esvazia(&a, &fio[n]);
+            t = tx_anel_compose(&a, payload, 40, CHK_CRC16, &precisa);
+        }
+        checa("Anel TX: quadro no entrou", t == 45 && a.escrita == antes + 45);
+    }
+    n += tx_anel_esvazia(&a, &fio[n]);
+    checa("Anel TX: bytes no fio", n == sizeof(fio) && tx_anel_livre(&a) == sizeof(mem));
+
+    FSM_Rx rx; rx_reset(&rx);
+    rx_configura_chk(&rx, CHK_CRC16);
+    checa("Anel TX: receptor", rx_handle_bytes(&rx, fio, n, NULL, NULL) == 8);
+    checa("Anel TX: ltimo payload", memcmp(rx.buf, payload, 40) == 0);
+
+    checa("Anel TX: estendido maior que o anel",
+          tx_anel_compose(&a, fio, 300, CHK_XOR, &precisa) == 0 && precisa == 3 + 300 + 2);
+    return 0;
+}
+
+// Resultado por canal: quadros OK, falhas e soma dos payloads
+typedef struct {
+    size_t ok[4], falhas[4];
+    uint32_t soma[4];
+} PorCanal;
+
+static void conta_canal(void* ctx, uint16_t canal, FrameResult r,
+                        const uint8_t* dados, uint8_t n) {
+    PorCanal* pc = ctx;
+    if (r == FRAME_FAIL) { pc->falhas[canal]++; return; }
+    pc->ok[canal]++;
+    for (int i = 0; i < n; i++) pc->soma[canal] += dados[i];
+}
+
+typedef struct {
+    PorCanal* pc;
+    uint16_t canal;
+} CanalRef;
+
+static void conta_canal_ref(void* ctx, FrameResult r, size_t offset,
+                            const uint8_t* dados, uint16_t n) {
+    CanalRef* ref = ctx;
+    (void)offset;
+    conta_canal(ref->pc, ref->canal, r, dados, n);
+}
+
+// Canais intercalados de forma irregular devem dar, canal a canal, o
+// mesmo resultado de um FSM_Rx por canal.
+static char* teste_rx_multi() {
+    enum { CANAIS = 4 };
+    static uint8_t fluxo[CANAIS][200];
+    size_t tam[CANAIS] = {0}, lido[CANAIS] = {0};
+    PorCanal esperado = {0};
+    TxPacket tx;
+
+    for (int c = 0; c < CANAIS; c++) {
+        uint8_t payload[30];
+        FSM_Rx rx; rx_reset(&rx);
+        rx_configura_chk(&rx, CHK_CRC16);
+        for (int q = 0; q < 4; q++) {
+            for (int i = 0; i < 30; i++) payload[i] = (uint8_t)(c * 50 + q * 7 + i);
+            fluxo[c][tam[c]++] = 0x55;               // lixo entre quadros
+            tam[c] += tx_compose_chk(&tx, payload, (uint8_t)(10 + q * 5 + c),
+                                     &fluxo[c][tam[c]], CHK_CRC16);
+        }
+        if (c == 1) fluxo[c][20] ^= 0x40;          // corrompe 1 quadro do canal 1
+        CanalRef ref = {&esperado, (uint16_t)c};
+        rx_handle_bytes(&rx, fluxo[c], tam[c], conta_canal_ref, &ref);
+    }
+    checa("Multi: canal 1 deveria ter uma falha", esperado.falhas[1] == 1);
+
+    // intercala: escolhe o prximo canal com um gerador simples
+    static uint16_t canal[CANAIS * 200];
+    static uint8_t bytes[CANAIS * 200];
+    size_t n = 0;
+    uint32_t s = 7;
+    while (n < tam[0] + tam[1] + tam[2] + tam[3]) {
+        s = s * 1103515245u + 12345u;
+        uint16_t c = (uint16_t)((s >> 16) % CANAIS);
+        if (lido[c] == tam[c]) continue;
+        canal[n] = c;
+        bytes[n++] = fluxo[c][lido[c]++];
+    }
+
+    static uint8_t payload[CANAIS][FRAME_MAX];
+    static RxMulti m;
+    PorCanal obtido = {0};
+    rx_multi_init(&m, CANAIS, payload, CHK_CRC16);
+    size_t ok = rx_multi_processa(&m, canal, bytes, n / 2, conta_canal, &obtido);
+    ok += rx_multi_processa(&m, &canal[n / 2], &bytes[n / 2], n - n / 2, conta_canal, &obtido);
+
+    checa("Multi: total de quadros OK", ok == 15);
+    for (int c = 0; c < CANAIS; c++) {
+        checa("Multi: OK por canal", obtido.ok[c] == esperado.ok[c]);
+        checa("Multi: falhas por canal", obtido.falhas[c] == esperado.falhas[c]);
+        checa("Multi: payload por canal", obtido.soma[c] == esperado.soma[c]);
+    }
+    return 0;
+}
+
+// Registra os eventos entregues por rx_handle_bytes()
+#define REG_MAX 64
+typedef struct {
+    size_t qtd;
+    FrameResult res[REG_MAX];
+    size_t offset[REG_MAX];
+    uint8_t ultimo[FRAME_EXT_MAX];
+    uint16_t ultimo_n;
+    size_t base; // somado ao offset quando o fluxo  entregue em pedaos
+} Registro;
+
+static void registra(void* ctx, FrameResult r, size_t offset,
+                     const uint8_t* dados, uint16_t n) {
+    Registro* reg = ctx;
+    if (reg->qtd < REG_MAX) {
+        reg->res[reg->qtd] = r;
+        reg->offset[reg->qtd] = reg->base + offset;
+        reg->qtd++;
+    }
+    if (r == FRAME_OK) {
+        memcpy(reg->ultimo, dados, n);
+        reg->ultimo_n = n;
+    }
+}
+
+static char* teste_rx_bloco() {
+    FSM_Rx rx; rx_reset(&rx);
+    Registro reg = {0};
+    uint8_t chk = 'O' ^ 'K' ^ '!';
+    uint8_t fluxo[] = {'x', 'y',
+                       FRAME_SOF, 3, 'O','K','!', chk, FRAME_EOF,   // OK em 8
+                       'z',
+                       FRAME_SOF, 2, 'A','B', 0x99, FRAME_EOF,      // FAIL em 14
+                       FRAME_SOF, 1, 'Q', 'Q', FRAME_EOF};          // OK em 20
+
+    size_t ok = rx_handle_bytes(&rx, fluxo, sizeof(fluxo), registra, &reg);
+
+    checa("Bloco: quantidade de quadros OK", ok == 2);
+    checa("Bloco: quantidade de eventos", reg.qtd == 3);
+    checa("Bloco: 1o evento", reg.res[0] == FRAME_OK && reg.offset[0] == 8);
+    checa("Bloco: 2o evento", reg.res[1] == FRAME_FAIL && reg.offset[1] == 14);
+    checa("Bloco: 3o evento", reg.res[2] == FRAME_OK && reg.offset[2] == 20);
+    checa("Bloco: payload entregue", reg.ultimo_n == 1 && reg.ultimo[0] == 'Q');
+    return 0;
+}
+
+// Entregar o fluxo em pedaos de qualquer tamanho deve dar os mesmos
+// eventos, nos mesmos offsets, que o caminho byte a byte.
+static char* teste_rx_bloco_equivale_byte() {
+    uint8_t fluxo[256];
+    size_t n = 0;
+    uint8_t p1[] = {FRAME_SOF, FRAME_EOF, 7, 9};
+    uint8_t p2[40];
+    for (int i = 0; i < 40; i++) p2[i] = (uint8_t)(i * 37);
+    TxPacket tx;
+
+    fluxo[n++] = 0x55;
+    tx_compose(&tx, p1, sizeof(p1), &fluxo[n]); n += sizeof(p1) + 4;
+    fluxo[n++] = FRAME_SOF;                      // SOF falso seguido de lixo
+    fluxo[n++] = 2; fluxo[n++] = 1; fluxo[n++] = 1; fluxo[n++] = 0x42;
+    tx_compose(&tx, p2, sizeof(p2), &fluxo[n]); n += sizeof(p2) + 4;
+    tx_compose(&tx, p2, 0, &fluxo[n]); n += 4;
+    tx_compose(&tx, p1, 3, &fluxo[n]); n += 3 + 4;
+    fluxo[n - 1] = 0x7E;                         // EOF corrompido
+
+    Registro esperado = {0};
+    FSM_Rx rx; rx_reset(&rx);
+    for (size_t i = 0; i < n; i++) {
+        FrameResult r = rx_handle_byte(&rx, fluxo[i]);
+        if (r != FRAME_PROGRESS) {
+            esperado.res[esperado.qtd] = r;
+            esperado.offset[esperado.qtd] = i;
+            esperado.qtd++;
+        }
+    }
+    checa("Equivalncia: fluxo de teste sem eventos", esperado.qtd >= 4);
+
+    const size_t pedacos[] = {1, 2, 3, 7, 64, sizeof(fluxo)};
+    for (size_t t = 0; t < sizeof(pedacos) / sizeof(pedacos[0]); t++) {
+        Registro reg = {0};
+        rx_reset(&rx);
+        for (size_t i = 0; i < n; i += pedacos[t]) {
+            size_t k = (n - i < pedacos[t]) ? n - i : pedacos[t];
+            reg.base = i;
+            rx_handle_bytes(&rx, &fluxo[i], k, registra, &reg);
+        }
+        checa("Equivalncia: nmero de eventos", reg.qtd == esperado.qtd);
+        for (size_t e = 0; e < reg.qtd; e++) {
+            checa("Equivalncia: resultado", reg.res[e] == esperado.res[e]);
+            checa("Equivalncia: offset", reg.offset[e] == esperado.offset[e]);
+        }
+    }
+    return 0;
+}
+
+static char* teste_rx_motores_equivalentes() {
+    static uint8_t fluxo[4096];
+    const ChkModo modos[] = {CHK_XOR, CHK_CRC16, CHK_CRC32};
+    uint32_t semente = 99;
+    for (size_t m = 0; m < 3; m++) {
+        // quadros vlidos intercalados com rudo e bytes corrompidos
+        size_t n = 0;
+        while (n + FRAME_MAX + 16 < sizeof(fluxo)) {
+            uint8_t payload[40];
+            TxPacket tx;
+            semente = semente * 1103515245u + 12345u;
+            uint8_t tam = (uint8_t)((semente >> 16) % sizeof(payload));
+            for (int i = 0; i < tam; i++) payload[i] = (uint8_t)(semente >> (i & 15));
+            size_t q = tx_compose_chk(&tx, payload, tam, &fluxo[n], modos[m]);
+            if ((semente >> 8) % 4 == 0) fluxo[n + (semente >> 20) % q] ^= 0x10;
+            n += q;
+            fluxo[n++] = (uint8_t)(semente >> 24);
+        }
+        FSM_Rx a, b;
+        static uint8_t ext_a[300], ext_b[300];  // rudo tambm abre quadros estendidos
+        rx_reset(&a); rx_configura_chk(&a, modos[m]); rx_configura_ext(&a, ext_a, sizeof(ext_a));
+        rx_reset(&b); rx_configura_chk(&b, modos[m]); rx_configura_ext(&b, ext_b, sizeof(ext_b));
+        size_t ok = 0;
+        for (size_t i = 0; i < n; i++) {
+            FrameResult ra = rx_byte_switch(&a, fluxo[i]);
+            FrameResult rb = rx_byte_tabela(&b, fluxo[i]);
+            checa("Motores: resultado difere", ra == rb);
+            checa("Motores: estado difere", a.estado == b.estado && a.pos == b.pos);
+            ok += ra == FRAME_OK;
+        }
+        checa("Motores: nenhum quadro reconhecido", ok > 0);
+    }
+    return 0;
+}
+
+static char* teste_rx_ressinc() {
+    // quadro truncado: o LEN 5 engole o SOF do quadro bom que vem a seguir
+    uint8_t chk = 'O' ^ 'K';
+    uint8_t fluxo[] = {FRAME_SOF, 5, 'a', 'b',
+                       FRAME_SOF, 2, 'O', 'K', chk, FRAME_EOF};
+    FSM_Rx rx; rx_reset(&rx);
+    Registro reg = {0};
+    size_t ok = rx_handle_bytes(&rx, fluxo, sizeof(fluxo), registra, &reg);
+    checa("Ressinc: sem retrocesso o quadro bom se perde", ok == 0 && reg.qtd == 1);
+
+    // com retrocesso, e o fluxo entregue em dois pedaos
+    rx_reset(&rx);
+    rx_configura_ressinc(&rx, true);
+    memset(&reg, 0, sizeof(reg));
+    ok = rx_handle_bytes(&rx, fluxo, 8, registra, &reg);
+    reg.base = 8;
+    ok += rx_handle_bytes(&rx, &fluxo[8], sizeof(fluxo) - 8, registra, &reg);
+    checa("Ressinc: quadro no recuperado", ok == 1 && reg.qtd == 2);
+    checa("Ressinc: FAIL fora do lugar", reg.res[0] == FRAME_FAIL && reg.offset[0] == 7);
+    checa("Ressinc: OK fora do lugar", reg.res[1] == FRAME_OK && reg.offset[1] == 9);
+    checa("Ressinc: payload", reg.ultimo_n == 2 && memcmp(reg.ultimo, "OK", 2) == 0);
     return 0;
 }
 
-int main(void) {
+static char* teste_rx_ext() {
+    static uint8_t fluxo[2 * FRAME_EXT_MAX], grande[3000], ext[2000];
+    TxPacket tx;
+    uint8_t curto[] = {'o', 'i'};
+    for (size_t i = 0; i < sizeof(grande); i++) grande[i] = (uint8_t)(0x40 + i % 32);
+
+    size_t n = tx_compose_chk(&tx, curto, 2, fluxo, CHK_CRC16);
+    size_t fim_ext = n + tx_compose_ext(&tx, grande, 1000, &fluxo[n], CHK_CRC16);
+    n = fim_ext + tx_compose_ext(&tx, grande, 3000, &fluxo[fim_ext], CHK_CRC16);  // > cap
+    n += tx_compose_chk(&tx, curto, 2, &fluxo[n], CHK_CRC16);
+    checa("Ext: LEN LSB primeiro", fluxo[7] == FRAME_SOF_EXT && fluxo[8] == (1000 & 0xFF) && fluxo[9] == 1000 >> 8);
+    checa("Ext: acima de FRAME_EXT_MAX", tx_compose_ext(&tx, grande, FRAME_EXT_MAX + 1, fluxo, CHK_XOR) == 0);
+
+    // em bloco: curto, estendido, estendido grande demais (FAIL), curto
+    FSM_Rx rx; rx_reset(&rx);
+    rx_configura_chk(&rx, CHK_CRC16);
+    rx_configura_ext(&rx, ext, sizeof(ext));
+    static Registro reg;
+    memset(&reg, 0, sizeof(reg));
+    size_t ok = rx_handle_bytes(&rx, fluxo, fim_ext, registra, &reg);
+    checa("Ext: quadro estendido no recebido", ok == 2 && reg.ultimo_n == 1000);
+    checa("Ext: payload estendido", memcmp(reg.ultimo, grande, 1000) == 0);
+    ok = rx_handle_bytes(&rx, &fluxo[fim_ext], n - fim_ext, registra, &reg);
+    checa("Ext: LEN acima do buffer", ok == 1 && reg.qtd == 4 && reg.res[2] == FRAME_FAIL);
+
+    // byte a byte d o mesmo resultado
+    rx_reset(&rx);
+    rx_configura_chk(&rx, CHK_CRC16);
+    rx_configura_ext(&rx, ext, sizeof(ext));
+    size_t ok_byte = 0, falhas = 0;
+    for (size_t i = 0; i < n; i++) {
+        FrameResult r = rx_handle_byte(&rx, fluxo[i]);
+        ok_byte += r == FRAME_OK;
+        falhas += r == FRAME_FAIL;
+    }
+    checa("Ext: byte a byte", ok_byte == 3 && falhas == 1);
+
+    // sem negociar, o SOF_EXT  lixo e os quadros curtos passam
+    rx_reset(&rx);
+    rx_configura_chk(&rx, CHK_CRC16);
+    checa("Ext: receptor legado", rx_handle_bytes(&rx, fluxo, n, NULL, NULL) == 2);
+    return 0;
+}
+
+static char* teste_cobs_codec() {
+    static uint8_t in[600], cod[COBS_MAX(600)], dec[600];
+    const size_t tams[] = {0, 1, 253, 254, 255, 508, 600};
+    for (size_t i = 0; i < sizeof(in); i++) in[i] = (uint8_t)(i % 251 + 1);
+
+    // vetores clssicos
+    const uint8_t z[] = {0x00}, zc[] = {0x01, 0x01};
+    const uint8_t m[] = {0x11, 0x22, 0x00, 0x33}, mc[] = {0x03, 0x11, 0x22, 0x02, 0x33};
+    checa("COBS: {00}", cobs_codifica(z, 1, cod) == 2 && memcmp(cod, zc, 2) == 0);
+    checa("COBS: {11 22 00 33}", cobs_codifica(m, 4, cod) == 5 && memcmp(cod, mc, 5) == 0);
+
+    for (int com_zeros = 0; com_zeros < 2; com_zeros++) {
+        if (com_zeros) for (size_t i = 0; i < sizeof(in); i += 97) in[i] = 0;
+        for (size_t t = 0; t < sizeof(tams) / sizeof(tams[0]); t++) {
+            size_t cn = cobs_codifica(in, tams[t], cod), dn = 0;
+            checa("COBS: acima do pior caso", cn <= COBS_MAX(tams[t]));
+            checa("COBS: zero na sada", cobs_zero_byte(cod, cn) == cn);
+            checa("COBS: ida e volta",
+                  cobs_decodifica(cod, cn, dec, sizeof(dec), &dn) && dn == tams[t] &&
+                  memcmp(dec, in, dn) == 0);
+        }
+    }
+    checa("COBS: cdigo zero", !cobs_decodifica(z, 1, dec, sizeof(dec), &(size_t){0}));
+    checa("COBS: bloco truncado", !cobs_decodifica(mc, 2, dec, sizeof(dec), &(size_t){0}));
+
+    // as buscas de zero concordam em qualquer posio e alinhamento
+    static uint8_t mem[80];
+    memset(mem, 0x5A, sizeof(mem));
+    for (size_t al = 0; al < 8; al++) {
+        for (size_t pos = al; pos <= sizeof(mem); pos++) {
+            if (pos < sizeof(mem)) mem[pos] = 0;
+            size_t n = sizeof(mem) - al, esperado = pos - al;
+            checa("Zero: palavra", cobs_zero_palavra(&mem[al], n) == esperado);
+#if defined(__SSE2__)
+            checa("Zero: sse2", cobs_zero_sse2(&mem[al], n) == esperado);
+#endif
+            if (pos < sizeof(mem)) mem[pos] = 0x5A;
+        }
+    }
+    return 0;
+}
+
+static void conta_falhas(void* ctx, FrameResult r, size_t offset,
+                         const uint8_t* dados, uint16_t n) {
+    (void)offset; (void)dados; (void)n;
+    if (r == FRAME_FAIL) (*(size_t*)ctx)++;
+}
+
+static char* teste_rx_cobs() {
+    uint8_t fluxo[1024];
+    uint8_t p1[] = {0x00, 0x02, 0x03, 0x00};           // zeros, SOF e EOF no payload
+    uint8_t p2[200];
+    for (size_t i = 0; i < sizeof(p2); i++) p2[i] = (uint8_t)(i * 13);
+    size_t n = 0, fim[3];
+    fluxo[n++] = 0x00;                                  // ociosidade
+    n += tx_compose_cobs(p1, sizeof(p1), &fluxo[n], CHK_CRC16); fim[0] = n - 1;
+    n += tx_compose_cobs(p2, sizeof(p2), &fluxo[n], CHK_CRC16); fim[1] = n - 1;
+    size_t ini_ruim = n;
+    n += tx_compose_cobs(p1, sizeof(p1), &fluxo[n], CHK_CRC16); fim[2] = n - 1;
+    fluxo[ini_ruim + 2] ^= 0x40;                        // corrompe o 3o quadro
+    n += tx_compose_cobs(p2, sizeof(p2), &fluxo[n], CHK_CRC16);
+
+    // em pedaos de vrios tamanhos: mesmo resultado que de uma vez
+    for (size_t passo = 1; passo <= n; passo = passo * 3 + 1) {
+        RxCobs rx; rx_cobs_reset(&rx, CHK_CRC16);
+        static Registro reg;
+        memset(&reg, 0, sizeof(reg));
+        size_t ok = 0;
+        for (size_t i = 0; i < n; i += passo) {
+            size_t k = (n - i < passo) ? n - i : passo;
+            reg.base = i;
+            ok += rx_cobs_processa(&rx, &fluxo[i], k, registra, &reg);
+        }
+        checa("COBS rx: quantidade", ok == 3 && reg.qtd == 4);
+        checa("COBS rx: offsets", reg.offset[0] == fim[0] && reg.offset[1] == fim[1]);
+        checa("COBS rx: corrompido", reg.res[2] == FRAME_FAIL && reg.offset[2] == fim[2]);
+        checa("COBS rx: payload", reg.ultimo_n == sizeof(p2) && memcmp(reg.ultimo, p2, sizeof(p2)) == 0);
+    }
+
+    // quadro maior que o receptor aceita: FAIL e segue
+    uint8_t lixo[600];
+    memset(lixo, 0x77, sizeof(lixo));
+    RxCobs rx; rx_cobs_reset(&rx, CHK_CRC16);
+    rx_cobs_processa(&rx, lixo, sizeof(lixo), NULL, NULL);
+    size_t falhas = 0;
+    checa("COBS rx: aps estouro", rx_cobs_processa(&rx, fluxo, n, conta_falhas, &falhas) == 3 && falhas == 2);
+    return 0;
+}
+
+// Separa as mensagens de cada quadro OK e confere contra o esperado
+typedef struct {
+    size_t msgs, quadros;
+    bool erro, copiou;
+    uint8_t soma;
+} TlvContagem;
+
+static void tlv_conta(void* ctx, FrameResult r, size_t offset,
+                      const uint8_t* dados, uint16_t n) {
+    (void)offset;
+    TlvContagem* c = ctx;
+    if (r != FRAME_OK) return;
+    TlvIter it;
+    TlvMsg m;
+    c->quadros++;
+    tlv_iter_inicia(&it, dados, n);
+    while (tlv_proxima(&it, &m)) {
+        if (m.valor < dados || m.valor + m.n > dados + n) c->copiou = true;
+        c->msgs++;
+        c->soma ^= m.tipo ^ chk_xor(m.valor, m.n);
+    }
+    c->erro |= it.erro;
+}
+
+static char* teste_tlv() {
+    static uint8_t fluxo[4096];
+    uint8_t valor[12];
+    TlvAgregador a;
+    TxPacket tx;
+    size_t n = 0;
+    uint8_t soma = 0;
+
+    // limite de tamanho: 40 mensagens de 4..12 bytes em quadros de at 64
+    tlv_inicia(&a, 64, 1000);
+    for (int i = 0; i < 40; i++) {
+        uint8_t tam = (uint8_t)(4 + i % 9);
+        for (int k = 0; k < tam; k++) valor[k] = (uint8_t)(i * 7 + k);
+        soma ^= (uint8_t)i ^ chk_xor(valor, tam);
+        if (!tlv_adiciona(&a, (uint8_t)i, valor, tam, 0)) {
+            n += tlv_fecha(&a, &tx, &fluxo[n], CHK_CRC16);
+            checa("TLV: no coube num quadro vazio", tlv_adiciona(&a, (uint8_t)i, valor, tam, 0));
+        }
+        if (tlv_pronto(&a, 0)) n += tlv_fecha(&a, &tx, &fluxo[n], CHK_CRC16);
+    }
+    n += tlv_fecha(&a, &tx, &fluxo[n], CHK_CRC16);
+    checa("TLV: agregador no esvaziou", tlv_fecha(&a, &tx, &fluxo[n], CHK_CRC16) == 0);
+
+    FSM_Rx rx; rx_reset(&rx); rx_configura_chk(&rx, CHK_CRC16);
+    TlvContagem c = {0};
+    rx_handle_bytes(&rx, fluxo, n, tlv_conta, &c);
+    checa("TLV: mensagens perdidas", c.msgs == 40 && c.soma == soma && !c.erro);
+    checa("TLV: valor fora do payload", !c.copiou);
+    checa("TLV: agregao", c.quadros > 1 && c.quadros < 40);
+
+    // limite de tempo: uma mensagem s sai depois de "espera" ticks
+    tlv_inicia(&a, FRAME_MAX, 10);
+    tlv_adiciona(&a, 1, valor, 4, 100);
+    checa("TLV: pronto cedo demais", !tlv_pronto(&a, 109));
+    checa("TLV: prazo no respeitado", tlv_pronto(&a, 110));
+
+    // payload malformado: len passa do fim
+    const uint8_t ruim[] = {1, 2, 'a', 'b', 7, 9, 'x'};
+    TlvIter it; TlvMsg m;
+    tlv_iter_inicia(&it, ruim, sizeof(ruim));
+    checa("TLV: 1a mensagem", tlv_proxima(&it, &m) && m.tipo == 1 && m.n == 2);
+    checa("TLV: malformado", !tlv_proxima(&it, &m) && it.erro);
+    return 0;
+}
+
+// Telemetria sinttica parecida com a do enlace: texto chave=valor com
+// leituras que variam pouco entre amostras.
+static uint8_t gera_telemetria(uint8_t* out, uint32_t i) {
+    int n = snprintf((char*)out, LZ_PAYLOAD_MAX,
+                     "SEQ=%05u;T1=%d.%d;T2=%d.%d;T3=%d.%d;H=%u;P=1013;V=3.30;ADC=%04u,%04u,%04u,%04u;ST=OK;ERR=0",
+                     (unsigned)i, 23 + (int)(i % 3), (int)(i % 10), 24, (int)(i % 7), 23, 5,
+                     40 + (unsigned)(i % 5), 2048 + (unsigned)(i % 11), 2050u, 2047 - (unsigned)(i % 3), 1024u);
+    return (uint8_t)n;
+}
+
+static char* teste_lz() {
+    static uint8_t quadros[24][FRAME_MAX + 8], in[24][LZ_PAYLOAD_MAX], tmp[LZ_JANELA + LZ_PAYLOAD_MAX];
+    size_t tam_q[24], bruto = 0, fio = 0;
+    uint8_t tam_in[24];
+    LzCanal tx_c, rx_c;
+    TxPacket tx;
+
+    // 24 quadros: telemetria, uma corrida, aleatrio, referncia sobreposta
+    lz_canal_inicia(&tx_c, 8);
+    for (int q = 0; q < 24; q++) {
+        uint8_t n;
+        if (q == 5) { n = LZ_PAYLOAD_MAX; memset(in[q], 'a', n); }
+        else if (q == 6) { n = LZ_PAYLOAD_MAX; for (int i = 0; i < n; i++) in[q][i] = (uint8_t)((i * 2654435761u) >> 13); }
+        else if (q == 7) { n = 5; memcpy(in[q], "ababa", 5); }
+        else n = gera_telemetria(in[q], (uint32_t)q);
+        tam_in[q] = n;
+        tam_q[q] = tx_compose_lz(&tx_c, &tx, in[q], n, quadros[q], CHK_CRC16);
+        checa("LZ: quadro maior que o cru", tam_q[q] <= (size_t)n + LZ_CAB + 5);
+        if (q > 8 && q != 16) { bruto += n; fio += tam_q[q]; }
+    }
+    checa("LZ: independente a cada 8", (quadros[8][2] & LZ_FLAG_INDEP) && !(quadros[9][2] & LZ_FLAG_INDEP) &&
+                                          (quadros[16][2] & LZ_FLAG_INDEP));
+    checa("LZ: aleatrio devia ir cru", !(quadros[6][2] & LZ_FLAG_LZSS));
+    checa("LZ: telemetria no comprimiu", fio * 2 < bruto);
+
+    // entrega: perde o 2, duplica o 10 e o 16 (independente); 3..7 ficam
+    // sem histrico
+    lz_canal_inicia(&rx_c, 0);
+    FSM_Rx rx; rx_reset(&rx); rx_configura_chk(&rx, CHK_CRC16);
+    static Registro reg;
+    for (int q = 0; q < 24; q++) {
+        for (int vez = 0; vez < ((q == 10 || q == 16) ? 2 : 1); vez++) {
+            if (q == 2) continue;
+            memset(&reg, 0, sizeof(reg));
+            checa("LZ: quadro no recebido", rx_handle_bytes(&rx, quadros[q], tam_q[q], registra, &reg) == 1);
+            uint16_t on = 0;
+            const uint8_t* p = rx_lz_abre(&rx_c, reg.ultimo, reg.ultimo_n, tmp, &on);
+            if ((q > 2 && q < 8) || vez == 1) {
+                checa("LZ: devia descartar sem histrico/duplicado", p == NULL);
+            } else {
+                checa("LZ: ida e volta", p && on == tam_in[q] && memcmp(p, in[q], on) == 0);
+                if (q == 6) checa("LZ: cru deve ser sem cpia", p == &reg.ultimo[LZ_CAB]);
+            }
+        }
+    }
+
+    // malformados: flag desconhecida e referncia antes do incio
+    const uint8_t flag[] = {0x80, 0, 'x'};
+    const uint8_t ruim[] = {LZ_FLAG_LZSS | LZ_FLAG_INDEP, 0, 0x01, 0x05, 0x00};
+    uint16_t on;
+    checa("LZ: flag invlida", rx_lz_abre(&rx_c, flag, sizeof(flag), tmp, &on) == NULL);
+    checa("LZ: referncia invlida", rx_lz_abre(&rx_c, ruim, sizeof(ruim), tmp, &on) == NULL);
+
+    // acima de LZ_PAYLOAD_MAX: recusado, sem consumir seq nem histrico
+    static uint8_t grande[FRAME_MAX];
+    uint8_t seq = tx_c.seq;
+    size_t hist = tx_c.hist_n;
+    checa("LZ: 254 bytes aceitos", tx_compose_lz(&tx_c, &tx, grande, LZ_PAYLOAD_MAX + 1, quadros[0], CHK_CRC16) == 0);
+    checa("LZ: 255 bytes aceitos", tx_compose_lz(&tx_c, &tx, grande, FRAME_MAX, quadros[0], CHK_CRC16) == 0);
+    checa("LZ: recusa mexeu no canal", tx_c.seq == seq && tx_c.hist_n == hist);
+    return 0;
+}
+
+typedef struct {
+    int chamadas[256];
+    const uint8_t* corpo;   // do ltimo despacho
+    uint16_t n;
+} Despachos;
+
+static void trata_registra(void* ctx, uint8_t tipo, const uint8_t* corpo, uint16_t n) {
+    Despachos* d = ctx;
+    d->chamadas[tipo]++;
+    d->corpo = corpo;
+    d->n = n;
+}
+
+static char* teste_rx_despacho() {
+    uint8_t fluxo[64];
+    size_t n = 0;
+    TxPacket tx;
+    const uint8_t m10[] = {0x10, 'a', 'b'}, m30[] = {0x30, 'x'}, m20[] = {0x20};
+    fluxo[n++] = 'x';
+    n += tx_compose_chk(&tx, m10, sizeof(m10), &fluxo[n], CHK_XOR);
+    n += tx_compose_chk(&tx, m30, sizeof(m30), &fluxo[n], CHK_XOR);   // sem tratador
+    n += tx_compose_chk(&tx, m30, 0, &fluxo[n], CHK_XOR);             // vazio
+    n += tx_compose_chk(&tx, m10, sizeof(m10), &fluxo[n], CHK_XOR);
+    fluxo[n - 2] ^= 1;                                                // CHK errado
+    n += tx_compose_chk(&tx, m20, sizeof(m20), &fluxo[n], CHK_XOR);
+
+    static RxDespacho d;
+    Despachos reg;
+    memset(&reg, 0, sizeof(reg));
+    rx_despacho_init(&d, &reg);
+    rx_despacho_registra(&d, 0x10, trata_registra);
+    rx_despacho_registra(&d, 0x20, trata_registra);
+
+    FSM_Rx rx; rx_reset(&rx);
+    rx_configura_despacho(&rx, &d);
+    for (size_t i = 0; i < 10; i++) rx_handle_byte(&rx, fluxo[i]);   // at o 1o quadro
+    checa("Despacho: tipo 0x10", reg.chamadas[0x10] == 1 && reg.n == 2);
+    checa("Despacho: sem cpia", reg.corpo == &rx.buf[1] && memcmp(reg.corpo, "ab", 2) == 0);
+    for (size_t i = 10; i < n; i++) rx_handle_byte(&rx, fluxo[i]);
+    checa("Despacho: byte a byte", reg.chamadas[0x10] == 1 && reg.chamadas[0x20] == 1 && reg.n == 0);
+    checa("Despacho: outros tipos", reg.chamadas[0x30] == 0 && reg.chamadas[0] == 0);
+
+    // em bloco, com quadro estendido: o corpo aponta para o buffer "ext"
+    static uint8_t ext[600], grande[300], fluxo_ext[320];
+    for (int i = 0; i < 300; i++) grande[i] = (uint8_t)i;
+    grande[0] = 0x10;
+    size_t n_ext = tx_compose_ext(&tx, grande, sizeof(grande), fluxo_ext, CHK_CRC16);
+    memset(&reg, 0, sizeof(reg));
+    rx_reset(&rx); rx_configura_chk(&rx, CHK_CRC16); rx_configura_ext(&rx, ext, sizeof(ext));
+    rx_configura_despacho(&rx, &d);
+    checa("Despacho: bloco", rx_handle_bytes(&rx, fluxo_ext, n_ext, NULL, NULL) == 1);
+    checa("Despacho: estendido", reg.chamadas[0x10] == 1 && reg.n == 299 && reg.corpo == &ext[1]);
+#if RX_DESPACHO_ESTAT
+    checa("Despacho: contadores", d.qtd[0x10] == 2 && d.qtd[0x20] == 1 && d.sem_tratador == 2);
+#endif
+    return 0;
+}
+
+// Transmissor morre no meio de um quadro; o prximo quadro chega depois
+// do silncio. Sem limite ele se perde, com limite  recebido.
+static char* teste_rx_ocioso() {
+    uint8_t q[16];
+    const uint8_t p[] = {1, 2, 3, 4, 5};
+    TxPacket tx;
+    size_t n = tx_compose_chk(&tx, p, sizeof(p), q, CHK_XOR);
+
+    for (int limite = 0; limite < 2; limite++) {
+        FSM_Rx rx; rx_reset(&rx);
+        rx_configura_ocioso(&rx, limite ? 10 : 0);
+        RX_TEMPO_T t = (RX_TEMPO_T)-16;             // atravessa o estouro
+        for (size_t i = 0; i < 4; i++) {            // SOF, LEN e 2 bytes
+            rx_marca_tempo(&rx, t++);
+            rx_handle_byte(&rx, q[i]);
+        }
+        checa("Ocioso: consulta dentro do limite", rx_verifica_ocioso(&rx, t + 5) == FRAME_PROGRESS);
+        t += 50;
+        int ok = 0;
+        for (size_t i = 0; i < n; i++) {
+            FrameResult r = rx_marca_tempo(&rx, t++);
+            if (i == 0) checa("Ocioso: aborto", r == (limite ? FRAME_FAIL : FRAME_PROGRESS));
+            ok += rx_handle_byte(&rx, q[i]) == FRAME_OK;
+        }
+        checa("Ocioso: quadro depois do silncio", ok == limite);
+        checa("Ocioso: ocioso em SOF no aborta", rx_verifica_ocioso(&rx, t + 1000) == FRAME_PROGRESS);
+#if RX_ESTAT
+        RxEstatDados d;
+        checa("Ocioso: contador", rx_estat_copia(&rx.est, &d) && d.falha_ocioso == (uint32_t)limite);
+#endif
+    }
+    return 0;
+}
+
+// Trs portas com dialetos diferentes no mesmo binrio; cada parser
+// especializado tem de concordar com o genrico configurado igual.
+static char* teste_dialetos() {
+    enlace_Porta pe; ponteiro_Porta pp; radio_Porta pr;
+    generico_Porta g[3];
+    uint8_t q[3][FRAME_MAX + 8], gq[FRAME_MAX + 8], ref[FRAME_MAX + 8], payload[64];
+    size_t n[3];
+    TxPacket tx;
+    for (int i = 0; i < 64; i++) payload[i] = (uint8_t)(i * 7 + 1);
+    enlace_reset(&pe); ponteiro_reset(&pp); radio_reset(&pr);
+    for (int d = 0; d < 3; d++) generico_configura(&g[d], &espec_dialetos[d]);
+
+    for (uint8_t tam = 0; tam <= 64; tam += 16) {
+        n[0] = enlace_compose(&pe, payload, tam, q[0]);
+        n[1] = ponteiro_compose(&pp, payload, tam, q[1]);
+        n[2] = radio_compose(&pr, payload, tam, q[2]);
+        checa("Dialeto: enlace igual a tx_compose",
+              n[0] == tx_compose_chk(&tx, payload, tam, ref, CHK_XOR) && memcmp(ref, q[0], n[0]) == 0);
+        for (int d = 0; d < 3; d++) {
+            checa("Dialeto: compose igual ao genrico",
+                  generico_compose(&g[d], payload, tam, gq) == n[d] && memcmp(gq, q[d], n[d]) == 0);
+            for (size_t i = 0; i < n[d]; i++) {
+                FrameResult r = d == 0 ? enlace_byte(&pe, q[d][i])
+                              : d == 1 ? ponteiro_byte(&pp, q[d][i])
+                              : radio_byte(&pr, q[d][i]);
+                checa("Dialeto: igual ao genrico", r == generico_byte(&g[d], q[d][i]));
+                checa("Dialeto: quadro", r == (i + 1 == n[d] ? FRAME_OK : FRAME_PROGRESS));
+            }
+            checa("Dialeto: payload genrico", g[d].tamanho == tam && memcmp(g[d].buf, payload, tam) == 0);
+        }
+        checa("Dialeto: payload", pe.tamanho == tam && memcmp(pe.buf, payload, tam) == 0 &&
+                                  pp.tamanho == tam && memcmp(pp.buf, payload, tam) == 0 &&
+                                  pr.tamanho == tam && memcmp(pr.buf, payload, tam) == 0);
+    }
+
+    // Quadro de "FSM e ponteiro/fsm.c": o XOR cobre o LEN, ento o
+    // enlace (mesmo SOF/EOF) o rejeita
+    uint8_t fp[] = {0x02, 4, 'D', 'A', 'D', 'O', 4 ^ 'D' ^ 'A' ^ 'D' ^ 'O', 0x03};
+    FrameResult rp = FRAME_PROGRESS, re = FRAME_PROGRESS;
+    for (size_t i = 0; i < sizeof(fp) && re == FRAME_PROGRESS; i++) re = enlace_byte(&pe, fp[i]);
+    for (size_t i = 0; i < sizeof(fp); i++) rp = ponteiro_byte(&pp, fp[i]);
+    checa("Dialeto: quadro do ponteiro", rp == FRAME_OK && re == FRAME_FAIL);
+
+    // Rdio: SOF prprio e LEN mximo 64
+    for (size_t i = 0; i < n[2]; i++) checa("Dialeto: SOF do rdio  lixo no enlace",
+                                            enlace_byte(&pe, q[2][i]) == FRAME_PROGRESS);
+    radio_byte(&pr, ESPEC_SOF(ESPEC_RADIO));
+    checa("Dialeto: LEN do rdio", radio_byte(&pr, 65) == FRAME_FAIL);
+    checa("Dialeto: compose acima do mximo", radio_compose(&pr, ref, 65, gq) == 0);
+
+    // Caminho em bloco: os quadros do rdio com lixo entre eles
+    uint8_t fluxo[3 * (FRAME_MAX + 8)];
+    size_t k = 0;
+    for (int i = 0; i < 3; i++) {
+        fluxo[k++] = 0x02;
+        memcpy(&fluxo[k], q[2], n[2]);
+        k += n[2];
+    }
+    size_t ok = 0;
+    radio_reset(&pr);
+    ok += radio_bytes(&pr, fluxo, 5, NULL, NULL);
+    ok += radio_bytes(&pr, &fluxo[5], k - 5, NULL, NULL);
+    checa("Dialeto: bloco", ok == 3 && generico_bytes(&g[2], fluxo, k, NULL, NULL) == 3);
+    return 0;
+}
+
+static char* teste_pool() {
+    uint8_t mem[3][8];
+    Pool p = POOL_INICIALIZA(mem, 8, 3);
+    uint8_t* b[3];
+    for (int i = 0; i < 3; i++) b[i] = pool_pega(&p);
+    checa("Pool: blocos distintos", b[0] == mem[0] && b[1] == mem[1] && b[2] == mem[2]);
+    checa("Pool: esgotado", pool_pega(&p) == NULL && p.est.esgotado == 1);
+    pool_devolve(&p, b[1]);
+    checa("Pool: reuso", pool_pega(&p) == mem[1]);
+    pool_devolve(&p, b[0]);
+    pool_devolve(&p, b[2]);
+    PoolEstat e = pool_estat(&p);
+    checa("Pool: contadores", e.pegos == 4 && e.em_uso == 1 && e.pico == 3);
+    pool_devolve(&p, b[2]);     // liberao dupla
+    checa("Pool: devoluo dupla", pool_estat(&p).em_uso == 1 && p.ocupados == 1u << 1);
+    Pool grande = POOL_INICIALIZA(mem, 8, 40);
+    checa("Pool: mais de 32 blocos", grande.qtd == 32);
+    return 0;
+}
+
+#if RX_POOL
+// Oito enlaces, dois blocos: s quem est no meio de um quadro segura um.
+static char* teste_rx_pool() {
+    static uint8_t mem[2][FRAME_MAX];
+    Pool pool = POOL_INICIALIZA(mem, FRAME_MAX, 2);
+    FSM_Rx rx[8];
+    uint8_t q[3][16];
+    const uint8_t p[3][4] = {{'a', 'b', 'c', 'd'}, {'e', 'f', 'g', 'h'}, {'i', 'j', 'k', 'l'}};
+    TxPacket tx;
+    const size_t n = 8;     // SOF LEN 4 CHK EOF
+    for (int i = 0; i < 3; i++) tx_compose(&tx, p[i], 4, q[i]);
+    for (int i = 0; i < 8; i++) {
+        rx_reset(&rx[i]);
+        rx_configura_pool(&rx[i], &pool);
+        for (int k = 0; k < 40; k++) rx_handle_byte(&rx[i], 'x');    // ociosos
+    }
+    checa("Pool RX: ocioso sem bloco", pool.est.em_uso == 0);
+
+    for (size_t i = 0; i < 3; i++) rx_handle_byte(&rx[0], q[0][i]);  // SOF LEN dado
+    for (size_t i = 0; i < 3; i++) rx_handle_byte(&rx[1], q[1][i]);
+    rx_handle_byte(&rx[2], q[2][0]);
+    checa("Pool RX: esgotado falha no LEN", rx_handle_byte(&rx[2], q[2][1]) == FRAME_FAIL &&
+                                            pool.est.esgotado == 1 && rx[2].buf == NULL);
+
+    FrameResult r = FRAME_PROGRESS;
+    for (size_t i = 3; i < n; i++) r = rx_handle_byte(&rx[0], q[0][i]);
+    checa("Pool RX: OK retm o bloco", r == FRAME_OK && pool.est.em_uso == 2 &&
+                                       memcmp(rx[0].buf, p[0], 4) == 0);
+    rx_handle_byte(&rx[0], 'x');
+    checa("Pool RX: devolvido no prximo byte", rx[0].buf == NULL && pool.est.em_uso == 1);
+
+    size_t ok = rx_handle_bytes(&rx[2], q[2], n, NULL, NULL);
+    checa("Pool RX: bloco reaproveitado", ok == 1 && memcmp(rx[2].buf, p[2], 4) == 0);
+    rx_libera(&rx[2]);
+    for (size_t i = 3; i < n; i++) r = rx_handle_byte(&rx[1], q[1][i]);
+    rx_libera(&rx[1]);
+    checa("Pool RX: tudo devolvido", r == FRAME_OK && pool.est.em_uso == 0 && pool.est.pico == 2);
+
+    // enlace que cai no meio do quadro: rx_libera() e rx_reset(), vrias vezes
+    for (int vez = 0; vez < 5; vez++) {
+        rx_reset(&rx[3]);
+        rx_configura_pool(&rx[3], &pool);
+        for (size_t i = 0; i < 3; i++) rx_handle_byte(&rx[3], q[0][i]);  // SOF LEN dado
+        checa("Pool RX: LEN sem bloco", rx[3].buf != NULL && pool.est.em_uso == 1);
+        rx_libera(&rx[3]);
+        checa("Pool RX: abandono no meio no devolveu", rx[3].buf == NULL && pool.est.em_uso == 0);
+    }
+    checa("Pool RX: esgotou abandonando quadros", pool.est.esgotado == 1);
+    return 0;
+}
+#endif
+
+#if RX_ESTAT
+// Os contadores no dependem do caminho (byte a byte ou em bloco) nem de
+// como o fluxo  fatiado.
+static char* teste_rx_estat() {
+    uint8_t fluxo[64];
+    size_t n = 0;
+    uint8_t p[] = {'O', 'K'};
+    TxPacket tx;
+    fluxo[n++] = 'x'; fluxo[n++] = 'y';                             // 2 de lixo
+    tx_compose(&tx, p, 2, &fluxo[n]); n += 6;                       // OK
+    tx_compose(&tx, p, 2, &fluxo[n]); fluxo[n + 4] ^= 1; n += 6;    // CHK (EOF vira lixo)
+    tx_compose(&tx, p, 2, &fluxo[n]); fluxo[n + 5] = 'z'; n += 6;   // EOF
+    fluxo[n++] = 'w';                                               // lixo
+    tx_compose(&tx, p, 2, &fluxo[n]); n += 6;                       // OK
+
+    FSM_Rx a, b;
+    RxEstatDados da, db;
+    rx_reset(&a); rx_reset(&b);
+    for (size_t i = 0; i < n; i++) rx_handle_byte(&a, fluxo[i]);
+    rx_handle_bytes(&b, fluxo, 5, NULL, NULL);
+    rx_handle_bytes(&b, &fluxo[5], 9, NULL, NULL);
+    rx_handle_bytes(&b, &fluxo[14], n - 14, NULL, NULL);
+    checa("Estat: cpia", rx_estat_copia(&a.est, &da) && rx_estat_copia(&b.est, &db));
+    checa("Estat: bytes", da.bytes == n);
+    checa("Estat: lixo", da.lixo == 4);
+    checa("Estat: OK", da.ok == 2);
+    checa("Estat: falhas", da.falha_chk == 1 && da.falha_eof == 1 && da.falha_tam == 0);
+    checa("Estat: bytes de dado", da.bytes_estado[RX_READ_DATA] == 8);
+    checa("Estat: bloco igual a byte", memcmp(&da, &db, sizeof(da)) == 0);
+
+    // zerar vale j na prxima cpia; o receptor zera no prximo byte
+    rx_estat_zera(&a.est);
+    checa("Estat: zerado", rx_estat_copia(&a.est, &da) && da.bytes == 0 && da.ok == 0);
+    rx_handle_byte(&a, 'q');
+    checa("Estat: recomea", rx_estat_copia(&a.est, &da) && da.bytes == 1 && da.lixo == 1);
+    return 0;
+}
+#endif
+
+// ---------------- Runner ----------------
+static char* roda_todos(void) {
+    roda_teste(teste_rx_valido);
+    roda_teste(teste_rx_chk_errado);
+    roda_teste(teste_tx_monta_pacote);
+    roda_teste(teste_rx_bloco);
+    roda_teste(teste_rx_bloco_equivale_byte);
+    roda_teste(teste_chk_kernels);
+    roda_teste(teste_crc_referencia);
+    roda_teste(teste_rx_crc);
+    roda_teste(teste_rx_anel);
+    roda_teste(teste_rx_anel_contrapressao);
+    roda_teste(teste_tx_sg);
+    roda_teste(teste_tx_lote);
+    roda_teste(teste_tx_anel);
+    roda_teste(teste_rx_multi);
+    roda_teste(teste_rx_motores_equivalentes);
+    roda_teste(teste_rx_ressinc);
+    roda_teste(teste_rx_ext);
+    roda_teste(teste_cobs_codec);
+    roda_teste(teste_rx_cobs);
+    roda_teste(teste_tlv);
+    roda_teste(teste_lz);
+    roda_teste(teste_rx_despacho);
+    roda_teste(teste_rx_ocioso);
+    roda_teste(teste_dialetos);
+    roda_teste(teste_pool);
+#if RX_POOL
+    roda_teste(teste_rx_pool);
+#endif
+#if RX_ESTAT
+    roda_teste(teste_rx_estat);
+#endif
+    return 0;
+}
+#endif
+
+// ---------------- Benchmarks ----------------
+// Executados com "./fsm bench"; no fazem parte dos testes.
+static volatile size_t bench_sumidouro;
+
+#if !defined(__ARM_ARCH_6M__)
+static double bench_agora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+#endif
+
+static uint32_t bench_semente = 12345;
+static uint8_t bench_rand(void) {
+    bench_semente = bench_semente * 1103515245u + 12345u;
+    return (uint8_t)(bench_semente >> 16);
+}
+
+// Preenche "out" com quadros de "tam" bytes de payload separados por
+// "lixo" bytes sem SOF. Retorna o nmero de bytes gerados.
+static size_t bench_gera_fluxo_chk(uint8_t* out, size_t cap, uint8_t tam,
+                                   size_t lixo, ChkModo modo) {
+    uint8_t payload[FRAME_MAX];
+    TxPacket tx;
+    size_t n = 0;
+    while (n + lixo + tam + 3 + chk_bytes(modo) <= cap) {
+        for (size_t i = 0; i < lixo; i++) {
+            uint8_t b;
+            do { b = bench_rand(); } while (b == FRAME_SOF);
+            out[n++] = b;
+        }
+        for (int i = 0; i < tam; i++) payload[i] = bench_rand();
+        n += tx_compose_chk(&tx, payload, tam, &out[n], modo);
+    }
+    return n;
+}
+
+static size_t bench_gera_fluxo(uint8_t* out, size_t cap, uint8_t tam, size_t lixo) {
+    return bench_gera_fluxo_chk(out, cap, tam, lixo, CHK_XOR);
+}
+
+// Daqui at roda_benchmarks(): fluxos de MB, s no host.
+#if !defined(__ARM_ARCH_6M__)
+static void bench_relata(const char* nome, size_t bytes, double seg) {
+    printf("%-36s %10.1f MB/s\n", nome, (double)bytes / seg / 1e6);
+}
+
+static void bench_conta(void* ctx, FrameResult r, size_t offset,
+                        const uint8_t* dados, uint16_t n) {
+    (void)offset; (void)dados; (void)n;
+    if (r == FRAME_OK) (*(size_t*)ctx)++;
+}
+
+// Consumidor tpico sem despacho: switch no tipo e cpia do payload,
+// porque o buffer do receptor  reaproveitado no prximo quadro.
+static uint8_t bench_msg[8][FRAME_EXT_MAX];
+
+static void bench_consome_switch(void* ctx, FrameResult r, size_t offset,
+                                 const uint8_t* dados, uint16_t n) {
+    (void)ctx; (void)offset;
+    if (r != FRAME_OK || n == 0) return;
+    switch (dados[0] & 7) {
+        case 0: memcpy(bench_msg[0], dados, n); bench_sumidouro += bench_msg[0][1]; break;
+        case 1: memcpy(bench_msg[1], dados, n); bench_sumidouro += bench_msg[1][1]; break;
+        case 2: memcpy(bench_msg[2], dados, n); bench_sumidouro += bench_msg[2][1]; break;
+        case 3: memcpy(bench_msg[3], dados, n); bench_sumidouro += bench_msg[3][1]; break;
+        case 4: memcpy(bench_msg[4], dados, n); bench_sumidouro += bench_msg[4][1]; break;
+        case 5: memcpy(bench_msg[5], dados, n); bench_sumidouro += bench_msg[5][1]; break;
+        case 6: memcpy(bench_msg[6], dados, n); bench_sumidouro += bench_msg[6][1]; break;
+        default: memcpy(bench_msg[7], dados, n); bench_sumidouro += bench_msg[7][1]; break;
+    }
+}
+
+static void bench_trata(void* ctx, uint8_t tipo, const uint8_t* corpo, uint16_t n) {
+    (void)ctx; (void)tipo;
+    if (n) bench_sumidouro += corpo[0];
+}
+
+static void bench_rx_bloco(void) {
+    enum { TAM_FLUXO = 1 << 20, REPETICOES = 20 };
+    static uint8_t fluxo[TAM_FLUXO];
+    const uint8_t tams[] = {8, 64, 255};
+    FSM_Rx rx;
+
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        size_t n = bench_gera_fluxo(fluxo, sizeof(fluxo), tams[t], 16);
+        char nome[64];
+
+        rx_reset(&rx);
+        size_t ok = 0;
+        double t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            for (size_t i = 0; i < n; i++) {
+                ok += rx_handle_byte(&rx, fluxo[i]) == FRAME_OK;
+            }
+        }
+        double t1 = bench_agora();
+        bench_sumidouro += ok;
+        snprintf(nome, sizeof(nome), "rx_handle_byte  payload=%u", tams[t]);
+        bench_relata(nome, n * REPETICOES, t1 - t0);
+
+        rx_reset(&rx);
+        ok = 0;
+        t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            rx_handle_bytes(&rx, fluxo, n, bench_conta, &ok);
+        }
+        t1 = bench_agora();
+        bench_sumidouro += ok;
+        snprintf(nome, sizeof(nome), "rx_handle_bytes payload=%u", tams[t]);
+        bench_relata(nome, n * REPETICOES, t1 - t0);
+    }
+}
+
+typedef uint8_t (*ChkKernel)(const uint8_t* d, size_t n);
+
+static void bench_chk(void) {
+    static const struct { const char* nome; ChkKernel fn; } kernels[] = {
+        {"chk_xor_byte", chk_xor_byte},
+        {"chk_xor_palavra", chk_xor_palavra},
+#if defined(__SSE2__)
+        {"chk_xor_sse2", chk_xor_sse2},
+#endif
+#if defined(__AVX2__)
+        {"chk_xor_avx2", chk_xor_avx2},
+#endif
+    };
+    const uint8_t tams[] = {1, 4, 8, 16, 32, 64, 128, 255};
+    static uint8_t mem[FRAME_MAX + 8];
+    for (size_t i = 0; i < sizeof(mem); i++) mem[i] = bench_rand();
+
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        size_t iter = (1u << 24) / (tams[t] + 8u);
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            uint8_t c = 0;
+            double t0 = bench_agora();
+            for (size_t i = 0; i < iter; i++) {
+                c ^= kernels[k].fn(&mem[i & 7], tams[t]); // alinhamento varia
+            }
+            double t1 = bench_agora();
+            bench_sumidouro += c;
+            double ns = (t1 - t0) * 1e9 / (double)iter;
+            printf("%-16s n=%-3u %8.2f ns/chamada %10.1f MB/s\n",
+                   kernels[k].nome, tams[t], ns, tams[t] / ns * 1e3);
+        }
+    }
+}
+
+typedef uint32_t (*CrcKernel)(uint32_t crc, const uint8_t* d, size_t n);
+static uint32_t bench_crc16_nibble(uint32_t c, const uint8_t* d, size_t n) { return crc16_atualiza_nibble((uint16_t)c, d, n); }
+static uint32_t bench_crc16(uint32_t c, const uint8_t* d, size_t n) { return crc16_atualiza((uint16_t)c, d, n); }
+static uint32_t bench_crc32_nibble(uint32_t c, const uint8_t* d, size_t n) { return crc32_atualiza_nibble(c, d, n); }
+static uint32_t bench_crc32(uint32_t c, const uint8_t* d, size_t n) { return crc32_atualiza(c, d, n); }
+static uint32_t bench_xor(uint32_t c, const uint8_t* d, size_t n) { return c ^ chk_xor(d, n); }
+
+// Integridade: kernels isolados e o receptor completo em cada modo
+static void bench_crc(void) {
+    static const struct { const char* nome; CrcKernel fn; } kernels[] = {
+        {"xor", bench_xor},
+        {"crc16 nibble", bench_crc16_nibble},
+        {"crc16", bench_crc16},
+        {"crc32 nibble", bench_crc32_nibble},
+        {"crc32", bench_crc32},
+    };
+    static uint8_t mem[FRAME_MAX];
+    for (size_t i = 0; i < sizeof(mem); i++) mem[i] = bench_rand();
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        enum { ITER = 200000 };
+        uint32_t c = 0;
+        double t0 = bench_agora();
+        for (int i = 0; i < ITER; i++) c = kernels[k].fn(c, mem, sizeof(mem));
+        double t1 = bench_agora();
+        bench_sumidouro += c;
+        char nome[64];
+        snprintf(nome, sizeof(nome), "kernel %s n=255", kernels[k].nome);
+        bench_relata(nome, (size_t)ITER * sizeof(mem), t1 - t0);
+    }
+
+    enum { TAM_FLUXO = 1 << 20, REPETICOES = 10 };
+    static uint8_t fluxo[TAM_FLUXO];
+    static const struct { const char* nome; ChkModo modo; } modos[] = {
+        {"xor", CHK_XOR}, {"crc16", CHK_CRC16}, {"crc32", CHK_CRC32},
+    };
+    for (size_t m = 0; m < sizeof(modos) / sizeof(modos[0]); m++) {
+        size_t n = bench_gera_fluxo_chk(fluxo, sizeof(fluxo), 64, 16, modos[m].modo);
+        FSM_Rx rx; rx_reset(&rx);
+        rx_configura_chk(&rx, modos[m].modo);
+        size_t ok = 0;
+        double t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            rx_handle_bytes(&rx, fluxo, n, bench_conta, &ok);
+        }
+        double t1 = bench_agora();
+        bench_sumidouro += ok;
+        char nome[64];
+        snprintf(nome, sizeof(nome), "rx_handle_bytes %s payload=64", modos[m].nome);
+        bench_relata(nome, n * REPETICOES, t1 - t0);
+    }
+}
+
+static void bench_consome_copia(void* ctx, FrameResult r, size_t offset,
+                                const uint8_t* dados, uint16_t n) {
+    (void)offset;
+    if (r == FRAME_OK) *(size_t*)ctx += dados[0] + dados[n - 1];
+}
+
+static void bench_consome_vista(void* ctx, FrameResult r, const RxVista* v) {
+    if (r != FRAME_OK) return;
+    const uint8_t* ultimo = v->len[1] ? &v->seg[1][v->len[1] - 1] : &v->seg[0][v->len[0] - 1];
+    bench_sumidouro += v->seg[0][0] + *ultimo;
+    rx_anel_libera(ctx, v);
+}
+
+// Cpia para FSM_Rx.buf x vista no anel. Nos dois casos o "DMA" (memcpy)
+// escreve pedaos de 512 bytes num buffer antes do receptor rodar.
+static void bench_rx_anel(void) {
+    enum { TAM_FLUXO = 1 << 20, PEDACO = 512, REPETICOES = 10 };
+    static uint8_t fluxo[TAM_FLUXO];
+    static uint8_t dma[PEDACO], mem[4096];
+    const uint8_t tams[] = {16, 64, 255};
+
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        size_t n = bench_gera_fluxo(fluxo, sizeof(fluxo), tams[t], 4);
+        n -= n % PEDACO;
+        char nome[64];
+
+        FSM_Rx rx; rx_reset(&rx);
+        size_t soma = 0;
+        double t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            for (size_t i = 0; i < n; i += PEDACO) {
+                memcpy(dma, &fluxo[i], PEDACO);
+                rx_handle_bytes(&rx, dma, PEDACO, bench_consome_copia, &soma);
+            }
+        }
+        double t1 = bench_agora();
+        bench_sumidouro += soma;
+        snprintf(nome, sizeof(nome), "copia para buf   payload=%u", tams[t]);
+        bench_relata(nome, n * REPETICOES, t1 - t0);
+
+        RxAnel a; rx_anel_init(&a, mem, sizeof(mem));
+        FSM_RxAnel rxa; rx_anel_reset(&rxa, CHK_XOR);
+        t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            for (size_t i = 0; i < n; i += PEDACO) {
+                rx_anel_escreve(&a, &fluxo[i], PEDACO);
+                rx_anel_processa(&rxa, &a, bench_consome_vista, &a);
+            }
+        }
+        t1 = bench_agora();
+        snprintf(nome, sizeof(nome), "vista no anel    payload=%u", tams[t]);
+        bench_relata(nome, n * REPETICOES, t1 - t0);
+    }
+    printf("RAM por receptor: FSM_Rx %u bytes, FSM_RxAnel %u bytes\n",
+           (unsigned)sizeof(FSM_Rx), (unsigned)sizeof(FSM_RxAnel));
+}
+
+// Telemetria: payload de 8 bytes em 2 pedaos (cabealho + amostra).
+// Uma "submisso"  uma partida de UART/DMA.
+static void bench_tx_lote(void) {
+    enum { QUADROS = 1 << 20, LOTE = 32 };
+    static uint8_t saida[LOTE * 16];
+    uint8_t cab[2] = {0x01, 0x00}, amostra[6] = {1, 2, 3, 4, 5, 6};
+    TxIov pedacos[2] = {{cab, 2}, {amostra, 6}};
+    TxLoteItem lote[LOTE];
+    size_t usados[LOTE];
+    for (int i = 0; i < LOTE; i++) { lote[i].pedacos = pedacos; lote[i].qtd = 2; }
+
+    // 1) junta os pedaos, monta com tx_compose e submete quadro a quadro
+    uint8_t junto[8];
+    TxPacket tx;
+    size_t submissoes = 0;
+    double t0 = bench_agora();
+    for (int q = 0; q < QUADROS; q++) {
+        cab[1] = (uint8_t)q;
+        memcpy(junto, cab, 2);
+        memcpy(junto + 2, amostra, 6);
+        tx_compose(&tx, junto, 8, saida);
+        bench_sumidouro += saida[9];
+        submissoes++;
+    }
+    double t1 = bench_agora();
+    printf("%-36s %8.1f ns/quadro %8zu submissoes\n", "junta + tx_compose",
+           (t1 - t0) * 1e9 / QUADROS, submissoes);
+
+    // 2) scatter-gather: s cabealho e rodap so escritos
+    TxQuadroSG sg;
+    submissoes = 0;
+    t0 = bench_agora();
+    for (int q = 0; q < QUADROS; q++) {
+        cab[1] = (uint8_t)q;
+        tx_compose_sg(&sg, pedacos, 2, CHK_XOR);
+        bench_sumidouro += sg.rod[0];
+        submissoes++;
+    }
+    t1 = bench_agora();
+    printf("%-36s %8.1f ns/quadro %8zu submissoes\n", "tx_compose_sg",
+           (t1 - t0) * 1e9 / QUADROS, submissoes);
+
+    // 3) lote: LOTE quadros por submisso
+    submissoes = 0;
+    t0 = bench_agora();
+    for (int q = 0; q < QUADROS; q += LOTE) {
+        cab[1] = (uint8_t)q;
+        tx_compose_lote(lote, LOTE, saida, sizeof(saida), CHK_XOR, usados);
+        bench_sumidouro += saida[usados[0] - 2];
+        submissoes++;
+    }
+    t1 = bench_agora();
+    printf("%-36s %8.1f ns/quadro %8zu submissoes\n", "tx_compose_lote (32 por lote)",
+           (t1 - t0) * 1e9 / QUADROS, submissoes);
+}
+
+// Quadro para o anel de transmisso que a "UART" esvazia: monta num buffer
+// (tx_compose_chk) e copia para o anel x codifica direto no anel.
+static void bench_tx_anel(void) {
+    enum { QUADROS = 1 << 18 };
+    static uint8_t mem[4096], payload[FRAME_MAX], montagem[FRAME_MAX + 8];
+    const uint8_t tams[] = {16, 64, 255};
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = bench_rand();
+
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        for (int modo = 0; modo < 2; modo++) {
+            TxAnel a; tx_anel_init(&a, mem, sizeof(mem));
+            TxPacket tx;
+            TxReserva r;
+            size_t bytes = 0, precisa;
+            const uint8_t* p;
+            double t0 = bench_agora();
+            for (int q = 0; q < QUADROS; q++) {
+                payload[0] = (uint8_t)q;
+                size_t k;
+                if (modo == 0) {
+                    k = tx_compose_chk(&tx, payload, tams[t], montagem, CHK_CRC16);
+                    tx_anel_reserva(&a, k, &r);
+                    tx_reserva_escreve(&r, 0, montagem, k);
+                    tx_anel_confirma(&a, k);
+                } else {
+                    k = tx_anel_compose(&a, payload, tams[t], CHK_CRC16, &precisa);
+                }
+                bytes += k;
+                while ((k = tx_anel_pendente(&a, &p)) > 0) {   // "DMA" sem cpia
+                    bench_sumidouro += p[k - 1];
+                    tx_anel_consome(&a, k);
+                }
+            }
+            double t1 = bench_agora();
+            char nome[64];
+            snprintf(nome, sizeof(nome), "%s payload=%u",
+                     modo ? "direto no anel  " : "monta + copia   ", tams[t]);
+            bench_relata(nome, bytes, t1 - t0);
+        }
+    }
+}
+
+// Canais intercalados em rodzio: um FSM_Rx por canal x RxMulti
+static void bench_rx_multi(void) {
+    enum { TAM_BASE = 1 << 16, N = 1 << 20, REPETICOES = 4 };
+    static uint8_t base[TAM_BASE], bytes[N];
+    static uint16_t canal[N];
+    static FSM_Rx rxs[RX_CANAIS_MAX];
+    static uint8_t payload[RX_CANAIS_MAX][FRAME_MAX];
+    static RxMulti m;
+    static size_t cursor[RX_CANAIS_MAX];
+    const uint16_t qtds[] = {1, 4, 16, 64, 256, 1024};
+    size_t tam_base = bench_gera_fluxo(base, sizeof(base), 64, 4);
+
+    for (size_t q = 0; q < sizeof(qtds) / sizeof(qtds[0]); q++) {
+        uint16_t k = qtds[q];
+        if (k > RX_CANAIS_MAX) break;
+        for (uint16_t c = 0; c < k; c++) cursor[c] = (c * 977u) % tam_base;
+        for (size_t i = 0; i < N; i++) {
+            uint16_t c = (uint16_t)(i % k);
+            canal[i] = c;
+            bytes[i] = base[cursor[c]];
+            cursor[c] = (cursor[c] + 1 == tam_base) ? 0 : cursor[c] + 1;
+        }
+        char nome[64];
+
+        for (uint16_t c = 0; c < k; c++) rx_reset(&rxs[c]);
+        size_t ok = 0;
+        double t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            for (size_t i = 0; i < N; i++) {
+                ok += rx_handle_byte(&rxs[canal[i]], bytes[i]) == FRAME_OK;
+            }
+        }
+        double t1 = bench_agora();
+        bench_sumidouro += ok;
+        snprintf(nome, sizeof(nome), "FSM_Rx por canal  canais=%u", k);
+        bench_relata(nome, (size_t)N * REPETICOES, t1 - t0);
+
+        rx_multi_init(&m, k, payload, CHK_XOR);
+        ok = 0;
+        t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            ok += rx_multi_processa(&m, canal, bytes, N, NULL, NULL);
+        }
+        t1 = bench_agora();
+        bench_sumidouro += ok;
+        snprintf(nome, sizeof(nome), "RxMulti           canais=%u", k);
+        bench_relata(nome, (size_t)N * REPETICOES, t1 - t0);
+    }
+    printf("RAM de estado por canal: FSM_Rx %u bytes (payload incluso), RxMulti %u bytes + %u de payload\n",
+           (unsigned)sizeof(FSM_Rx), 4u + (unsigned)sizeof(uint32_t), (unsigned)FRAME_MAX);
+}
+
+// Motor switch x motor tabela, byte a byte, em XOR e CRC-16
+static void bench_rx_motores(void) {
+    enum { TAM_FLUXO = 1 << 20, REPETICOES = 10 };
+    static uint8_t fluxo[TAM_FLUXO];
+    static const struct { const char* nome; ChkModo modo; } modos[] = {
+        {"xor", CHK_XOR}, {"crc16", CHK_CRC16},
+    };
+    const uint8_t tams[] = {8, 64, 255};
+    FSM_Rx rx;
+
+    for (size_t m = 0; m < sizeof(modos) / sizeof(modos[0]); m++) {
+        for (size_t t = 0; t < sizeof(tams); t++) {
+            size_t n = bench_gera_fluxo_chk(fluxo, sizeof(fluxo), tams[t], 16, modos[m].modo);
+            char nome[64];
+
+            rx_reset(&rx); rx_configura_chk(&rx, modos[m].modo);
+            size_t ok = 0;
+            double t0 = bench_agora();
+            for (int r = 0; r < REPETICOES; r++) {
+                for (size_t i = 0; i < n; i++) ok += rx_byte_switch(&rx, fluxo[i]) == FRAME_OK;
+            }
+            double t1 = bench_agora();
+            bench_sumidouro += ok;
+            snprintf(nome, sizeof(nome), "switch %s payload=%u", modos[m].nome, tams[t]);
+            bench_relata(nome, n * REPETICOES, t1 - t0);
+
+            rx_reset(&rx); rx_configura_chk(&rx, modos[m].modo);
+            ok = 0;
+            t0 = bench_agora();
+            for (int r = 0; r < REPETICOES; r++) {
+                for (size_t i = 0; i < n; i++) ok += rx_byte_tabela(&rx, fluxo[i]) == FRAME_OK;
+            }
+            t1 = bench_agora();
+            bench_sumidouro += ok;
+            snprintf(nome, sizeof(nome), "tabela %s payload=%u", modos[m].nome, tams[t]);
+            bench_relata(nome, n * REPETICOES, t1 - t0);
+        }
+    }
+}
+
+// Quadros recuperados por MB em funo da taxa de erro de bit (BER).
+// Quadros de 32 bytes em CRC-16, colados (sem lixo entre eles).
+static void bench_rx_ressinc(void) {
+    enum { TAM_FLUXO = 1 << 20 };
+    static uint8_t limpo[TAM_FLUXO], fluxo[TAM_FLUXO];
+    const double bers[] = {1e-6, 1e-5, 1e-4, 1e-3, 1e-2};
+    size_t n = bench_gera_fluxo_chk(limpo, sizeof(limpo), 32, 0, CHK_CRC16);
+    size_t enviados = n / (32 + 3 + 2);
+    FSM_Rx rx;
+
+    printf("%-8s %12s %12s %12s\n", "BER", "enviados/MB", "sem ressinc", "com ressinc");
+    for (size_t e = 0; e < sizeof(bers) / sizeof(bers[0]); e++) {
+        memcpy(fluxo, limpo, n);
+        // cada byte erra com probabilidade ~8*BER, invertendo um bit
+        uint32_t limiar = (uint32_t)(bers[e] * 8 * 4294967295.0);
+        for (size_t i = 0; i < n; i++) {
+            bench_rand();
+            if (bench_semente < limiar) fluxo[i] ^= (uint8_t)(1u << (bench_rand() & 7));
+        }
+        size_t ok[2];
+        for (int modo = 0; modo < 2; modo++) {
+            rx_reset(&rx);
+            rx_configura_chk(&rx, CHK_CRC16);
+            rx_configura_ressinc(&rx, modo == 1);
+            ok[modo] = rx_handle_bytes(&rx, fluxo, n, NULL, NULL);
+        }
+        double mb = (double)n / 1e6;
+        printf("%-8.0e %12.0f %12.0f %12.0f\n", bers[e],
+               enviados / mb, ok[0] / mb, ok[1] / mb);
+    }
+}
+
+// Transferncia em massa (firmware, download de log) com pare-e-espere:
+// cada quadro custa os bytes no fio mais um ciclo de ACK, medido em tempos
+// de byte. Tambm mede o receptor em bloco com quadros estendidos.
+static void bench_quadro_ext(void) {
+    const size_t total = 256 * 1024;
+    const size_t rtts[] = {0, 16, 115};  // 115 ~ 10 ms a 115200 baud
+    const uint16_t payloads[] = {FRAME_MAX, 1024, FRAME_EXT_MAX};
+
+    printf("%-10s %-8s %10s %10s\n", "payload", "ACK", "quadros", "goodput");
+    for (size_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++) {
+        size_t cab = payloads[p] > FRAME_MAX ? 4 : 3;  // SOF LEN[1|2] ... EOF
+        size_t quadros = (total + payloads[p] - 1) / payloads[p];
+        for (size_t r = 0; r < sizeof(rtts) / sizeof(rtts[0]); r++) {
+            size_t fio = total + quadros * (cab + chk_bytes(CHK_CRC16) + rtts[r]);
+            printf("%-10u %-8zu %10zu %9.1f%%\n", payloads[p], rtts[r], quadros,
+                   100.0 * (double)total / (double)fio);
+        }
+    }
+
+    enum { TAM_FLUXO = 1 << 20, REPETICOES = 20 };
+    static uint8_t fluxo[TAM_FLUXO], payload[FRAME_EXT_MAX], ext[FRAME_EXT_MAX];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = bench_rand();
+    for (size_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++) {
+        TxPacket tx;
+        size_t n = 0;
+        while (n + payloads[p] + 6 <= sizeof(fluxo)) {
+            n += payloads[p] > FRAME_MAX
+                 ? tx_compose_ext(&tx, payload, payloads[p], &fluxo[n], CHK_CRC16)
+                 : tx_compose_chk(&tx, payload, (uint8_t)payloads[p], &fluxo[n], CHK_CRC16);
+        }
+        FSM_Rx rx; rx_reset(&rx);
+        rx_configura_chk(&rx, CHK_CRC16);
+        rx_configura_ext(&rx, ext, sizeof(ext));
+        size_t ok = 0;
+        double t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) ok += rx_handle_bytes(&rx, fluxo, n, NULL, NULL);
+        double t1 = bench_agora();
+        bench_sumidouro += ok;
+        char nome[64];
+        snprintf(nome, sizeof(nome), "rx_handle_bytes crc16 payload=%u", payloads[p]);
+        bench_relata(nome, n * REPETICOES, t1 - t0);
+    }
+}
+
+// COBS x prefixo de tamanho: busca do zero, recepo e montagem.
+// Vazes de recepo/montagem em MB/s de payload (o COBS gasta mais fio).
+typedef size_t (*ZeroKernel)(const uint8_t* d, size_t n);
+static size_t bench_memchr_zero(const uint8_t* d, size_t n) {
+    const uint8_t* p = memchr(d, 0, n);
+    return p ? (size_t)(p - d) : n;
+}
+
+static void bench_cobs(void) {
+    static const struct { const char* nome; ZeroKernel fn; } kernels[] = {
+        {"cobs_zero_byte", cobs_zero_byte},
+        {"cobs_zero_palavra", cobs_zero_palavra},
+#if defined(__SSE2__)
+        {"cobs_zero_sse2", cobs_zero_sse2},
+#endif
+        {"memchr", bench_memchr_zero},
+    };
+    static uint8_t mem[4096 + 8];
+    memset(mem, 0x55, sizeof(mem));
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        enum { ITER = 50000 };
+        size_t soma = 0;
+        double t0 = bench_agora();
+        for (int i = 0; i < ITER; i++) soma += kernels[k].fn(&mem[i & 7], 4096);
+        double t1 = bench_agora();
+        bench_sumidouro += soma;
+        char nome[64];
+        snprintf(nome, sizeof(nome), "busca zero %s", kernels[k].nome);
+        bench_relata(nome, (size_t)ITER * 4096, t1 - t0);
+    }
+
+    enum { TAM_FLUXO = 1 << 20, REPETICOES = 20 };
+    static uint8_t prefixo[TAM_FLUXO], cobs[TAM_FLUXO];
+    const uint8_t tams[] = {8, 64, 255};
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        uint8_t payload[FRAME_MAX];
+        size_t np = 0, nc = 0, quadros = 0;
+        TxPacket tx;
+        while (nc + COBS_MAX(tams[t] + 2u) + 1 <= sizeof(cobs) && np + tams[t] + 5u <= sizeof(prefixo)) {
+            for (int i = 0; i < tams[t]; i++) payload[i] = bench_rand();
+            np += tx_compose_chk(&tx, payload, tams[t], &prefixo[np], CHK_CRC16);
+            nc += tx_compose_cobs(payload, tams[t], &cobs[nc], CHK_CRC16);
+            quadros++;
+        }
+        size_t util = quadros * tams[t] * REPETICOES;
+        char nome[64];
+
+        FSM_Rx rx; rx_reset(&rx); rx_configura_chk(&rx, CHK_CRC16);
+        size_t ok = 0;
+        double t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) ok += rx_handle_bytes(&rx, prefixo, np, NULL, NULL);
+        double t1 = bench_agora();
+        bench_sumidouro += ok;
+        snprintf(nome, sizeof(nome), "rx prefixo payload=%u", tams[t]);
+        bench_relata(nome, util, t1 - t0);
+
+        RxCobs rc; rx_cobs_reset(&rc, CHK_CRC16);
+        ok = 0;
+        t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) ok += rx_cobs_processa(&rc, cobs, nc, NULL, NULL);
+        t1 = bench_agora();
+        bench_sumidouro += ok;
+        snprintf(nome, sizeof(nome), "rx cobs    payload=%u", tams[t]);
+        bench_relata(nome, util, t1 - t0);
+
+        static uint8_t saida[FRAME_MAX * 2];
+        t0 = bench_agora();
+        for (size_t q = 0; q < quadros * 4; q++) {
+            bench_sumidouro += tx_compose_chk(&tx, &prefixo[q & 255], tams[t], saida, CHK_CRC16);
+        }
+        t1 = bench_agora();
+        snprintf(nome, sizeof(nome), "tx prefixo payload=%u", tams[t]);
+        bench_relata(nome, quadros * 4 * tams[t], t1 - t0);
+        t0 = bench_agora();
+        for (size_t q = 0; q < quadros * 4; q++) {
+            bench_sumidouro += tx_compose_cobs(&prefixo[q & 255], tams[t], saida, CHK_CRC16);
+        }
+        t1 = bench_agora();
+        snprintf(nome, sizeof(nome), "tx cobs    payload=%u", tams[t]);
+        bench_relata(nome, quadros * 4 * tams[t], t1 - t0);
+        printf("fio por quadro: prefixo %u, cobs %.1f bytes\n", tams[t] + 5u, (double)nc / (double)quadros);
+    }
+}
+
+// Mensagens de sensor (4..12 bytes): um quadro por mensagem x agregadas.
+// Utilizao do enlace com pare-e-espere: bytes de mensagem / (bytes no
+// fio + um ciclo de ACK por quadro, em tempos de byte).
+static void bench_tlv(void) {
+    enum { MSGS = 200000, REPETICOES = 5 };
+    static uint8_t fluxo[MSGS * 20];
+    uint8_t valor[12];
+    const size_t rtts[] = {0, 16, 115};
+    for (int i = 0; i < 12; i++) valor[i] = bench_rand();
+
+    for (int agrega = 0; agrega < 2; agrega++) {
+        size_t n = 0, quadros = 0, util = 0;
+        TlvAgregador a;
+        TxPacket tx;
+        tlv_inicia(&a, FRAME_MAX - 14, 1000);
+        double t0 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            n = quadros = util = 0;
+            for (uint32_t i = 0; i < MSGS; i++) {
+                uint8_t tam = (uint8_t)(4 + i % 9);
+                util += tam;
+                if (!agrega) {
+                    n += tx_compose_chk(&tx, valor, tam, &fluxo[n], CHK_CRC16);
+                    quadros++;
+                    continue;
+                }
+                tlv_adiciona(&a, (uint8_t)i, valor, tam, i);
+                if (tlv_pronto(&a, i)) {
+                    n += tlv_fecha(&a, &tx, &fluxo[n], CHK_CRC16);
+                    quadros++;
+                }
+            }
+            if (agrega && a.msgs) {
+                n += tlv_fecha(&a, &tx, &fluxo[n], CHK_CRC16);
+                quadros++;
+            }
+        }
+        double t1 = bench_agora();
+
+        FSM_Rx rx; rx_reset(&rx); rx_configura_chk(&rx, CHK_CRC16);
+        TlvContagem c = {0};
+        size_t ok = 0, msgs = 0;
+        double t2 = bench_agora();
+        for (int r = 0; r < REPETICOES; r++) {
+            if (agrega) ok += rx_handle_bytes(&rx, fluxo, n, tlv_conta, &c);
+            else ok += rx_handle_bytes(&rx, fluxo, n, bench_conta, &msgs);
+        }
+        double t3 = bench_agora();
+        bench_sumidouro += ok + c.msgs + msgs;
+
+        const char* nome = agrega ? "agregado" : "1 por quadro";
+        printf("%-13s tx %6.2f Mmsg/s  rx %6.2f Mmsg/s  %zu quadros\n", nome,
+               MSGS * REPETICOES / (t1 - t0) / 1e6, MSGS * REPETICOES / (t3 - t2) / 1e6, quadros);
+        for (size_t k = 0; k < sizeof(rtts) / sizeof(rtts[0]); k++) {
+            printf("%-13s ACK=%-3zu utilizao %5.1f%%\n", "", rtts[k],
+                   100.0 * (double)util / (double)(n + quadros * rtts[k]));
+        }
+    }
+}
+
+// Contador de ciclos para medir custo por byte (0 onde no houver)
+static uint64_t bench_ciclos(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Compresso em telemetria sinttica (gera_telemetria) e em dados
+// aleatrios; goodput num UART de 115200 baud (11520 bytes/s).
+static void bench_lz(void) {
+    enum { QUADROS = 20000 };
+    static uint8_t in[LZ_PAYLOAD_MAX], quadro[FRAME_MAX + 8];
+    static uint8_t tmp[LZ_JANELA + LZ_PAYLOAD_MAX];
+    const uint8_t intervalos[] = {0, 32, 8, 1};
+
+    for (int aleatorio = 0; aleatorio < 2; aleatorio++) {
+        for (size_t k = 0; k < sizeof(intervalos); k++) {
+            LzCanal tc, rc;
+            lz_canal_inicia(&tc, intervalos[k]);
+            lz_canal_inicia(&rc, 0);
+            FSM_Rx rx; rx_reset(&rx); rx_configura_chk(&rx, CHK_CRC16);
+            TxPacket tx;
+            size_t bruto = 0, cru = 0, fio = 0, erros = 0;
+            double t_tx = 0, t_rx = 0;
+            uint64_t c_tx = 0, c_rx = 0;
+            for (uint32_t q = 0; q < QUADROS; q++) {
+                uint8_t n;
+                if (aleatorio) {
+                    n = 96;
+                    for (int i = 0; i < n; i++) in[i] = bench_rand();
+                } else {
+                    n = gera_telemetria(in, q);
+                }
+                double t0 = bench_agora();
+                uint64_t c0 = bench_ciclos();
+                size_t t = tx_compose_lz(&tc, &tx, in, n, quadro, CHK_CRC16);
+                uint64_t c1 = bench_ciclos();
+                double t1 = bench_agora();
+                static Registro reg;
+                reg.qtd = 0;
+                rx_handle_bytes(&rx, quadro, t, registra, &reg);
+                uint16_t on = 0;
+                double t2 = bench_agora();
+                uint64_t c2 = bench_ciclos();
+                const uint8_t* p = rx_lz_abre(&rc, reg.ultimo, reg.ultimo_n, tmp, &on);
+                uint64_t c3 = bench_ciclos();
+                double t3 = bench_agora();
+                erros += !p || on != n || memcmp(p, in, n) != 0;
+                t_tx += t1 - t0; t_rx += t3 - t2;
+                c_tx += c1 - c0; c_rx += c3 - c2;
+                bruto += n;
+                cru += (size_t)n + 3 + 2;
+                fio += t;
+            }
+            bench_sumidouro += erros;
+            printf("%-10s indep=%-3u razo %5.2f  tx %6.1f ns/B %6.1f ciclos/B  rx %6.1f ns/B %6.1f ciclos/B  goodput %6.0f B/s (cru %5.0f)%s\n",
+                   aleatorio ? "aleatrio" : "telemetria", intervalos[k], (double)bruto / (double)(fio - QUADROS * 5u),
+                   t_tx * 1e9 / bruto, (double)c_tx / bruto, t_rx * 1e9 / bruto, (double)c_rx / bruto,
+                   11520.0 * bruto / fio, 11520.0 * bruto / cru, erros ? " ERRO" : "");
+        }
+    }
+}
+
+static void bench_despacho(void) {
+    enum { TAM_FLUXO = 1 << 20, REPETICOES = 20 };
+    static uint8_t fluxo[TAM_FLUXO];
+    static RxDespacho d;
+    const uint8_t tams[] = {8, 64, 255};
+    rx_despacho_init(&d, NULL);
+    for (int t = 0; t < 256; t++) rx_despacho_registra(&d, (uint8_t)t, bench_trata);
+
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        size_t n = bench_gera_fluxo(fluxo, sizeof(fluxo), tams[t], 0);
+        for (int modo = 0; modo < 2; modo++) {
+            FSM_Rx rx; rx_reset(&rx);
+            if (modo) rx_configura_despacho(&rx, &d);
+            size_t ok = 0;
+            double t0 = bench_agora();
+            for (int r = 0; r < REPETICOES; r++) {
+                ok += rx_handle_bytes(&rx, fluxo, n, modo ? NULL : bench_consome_switch, NULL);
+            }
+            double t1 = bench_agora();
+            bench_sumidouro += ok;
+            char nome[64];
+            snprintf(nome, sizeof(nome), "%s, payload %u", modo ? "despacho" : "switch+cpia", tams[t]);
+            bench_relata(nome, n * REPETICOES, t1 - t0);
+        }
+    }
+}
+
+// Parser especializado por dialeto contra o genrico, byte a byte e em
+// bloco. Cada porta  chamada por ponteiro, como num firmware que atende
+// vrias UARTs.
+typedef size_t (*BenchDialetoFn)(void* porta, const uint8_t* d, size_t n, bool bloco);
+
+#define BENCH_DIALETO(nome)                                                       \
+    static size_t bench_corre_##nome(void* porta, const uint8_t* d, size_t n,     \
+                                     bool bloco) {                                \
+        nome##_Porta* p = porta;                                                  \
+        nome##_reset(p);                                                          \
+        if (bloco) return nome##_bytes(p, d, n, NULL, NULL);                      \
+        size_t ok = 0;                                                            \
+        for (size_t i = 0; i < n; i++) ok += nome##_byte(p, d[i]) == FRAME_OK;    \
+        return ok;                                                                \
+    }
+BENCH_DIALETO(enlace)
+BENCH_DIALETO(ponteiro)
+BENCH_DIALETO(radio)
+BENCH_DIALETO(generico)
+
+static void bench_dialetos(void) {
+    enum { TAM_FLUXO = 1 << 20, REPETICOES = 10 };
+    static uint8_t fluxo[TAM_FLUXO];
+    static enlace_Porta pe;
+    static ponteiro_Porta pp;
+    static radio_Porta pr;
+    static generico_Porta pg;
+    static const struct { const char* nome; void* porta; BenchDialetoFn corre; } dl[] = {
+        {"enlace", &pe, bench_corre_enlace},
+        {"ponteiro", &pp, bench_corre_ponteiro},
+        {"radio", &pr, bench_corre_radio},
+    };
+    const uint8_t tams[] = {8, 64};
+    uint8_t payload[64];
+
+    for (size_t d = 0; d < sizeof(dl) / sizeof(dl[0]); d++) {
+        generico_configura(&pg, &espec_dialetos[d]);
+        for (size_t t = 0; t < sizeof(tams); t++) {
+            size_t n = 0, q;
+            do {                                    // quadros com 4 bytes de lixo
+                for (int i = 0; i < 4; i++) fluxo[n++] = (uint8_t)(bench_rand() & 0x1F) | 0x40;
+                for (int i = 0; i < tams[t]; i++) payload[i] = bench_rand();
+                q = generico_compose(&pg, payload, tams[t], &fluxo[n]);
+                n += q;
+            } while (n + 4 + q <= sizeof(fluxo));
+            for (int bloco = 0; bloco < 2; bloco++) {
+                for (int gen = 0; gen < 2; gen++) {
+                    void* porta = gen ? (void*)&pg : dl[d].porta;
+                    BenchDialetoFn corre = gen ? bench_corre_generico : dl[d].corre;
+                    size_t ok = 0;
+                    double t0 = bench_agora();
+                    for (int r = 0; r < REPETICOES; r++) ok += corre(porta, fluxo, n, bloco);
+                    double t1 = bench_agora();
+                    bench_sumidouro += ok;
+                    char nome[64];
+                    snprintf(nome, sizeof(nome), "%-8s %s %s payload=%u", dl[d].nome,
+                             gen ? "genrico" : "especial", bloco ? "bloco" : "byte ", tams[t]);
+                    bench_relata(nome, n * REPETICOES, t1 - t0);
+                }
+            }
+        }
+    }
+}
+
+// RAM por enlace e blocos realmente usados: oito enlaces com quadros de
+// 64 bytes e silncio entre eles (ocupao = quadro / (quadro + silncio)),
+// lidos em rajadas de 16 bytes (FIFO da UART) um enlace por vez. Sem
+// RX_POOL s os tamanhos; compare com um build -DRX_POOL=1.
+static void bench_pool(void) {
+    enum { ENLACES = 8, TAM = 64, RAJADA = 16, TAM_FLUXO = 1 << 16 };
+    printf("FSM_Rx: %zu bytes por enlace (RX_POOL=%d), %d enlaces: %zu bytes\n",
+           sizeof(FSM_Rx), RX_POOL, ENLACES, ENLACES * sizeof(FSM_Rx));
+#if RX_POOL
+    static uint8_t fluxo[ENLACES][TAM_FLUXO], mem[ENLACES][FRAME_MAX];
+    static FSM_Rx rx[ENLACES];
+    const size_t silencios[] = {0, 3 * TAM, 20 * TAM};
+    size_t n[ENLACES];
+    for (size_t s = 0; s < sizeof(silencios) / sizeof(silencios[0]); s++) {
+        for (int e = 0; e < ENLACES; e++) {       // silncio sorteado entre 0 e 2x a mdia
+            uint8_t payload[TAM];
+            TxPacket tx;
+            n[e] = 0;
+            for (;;) {
+                size_t lixo = silencios[s] ? (size_t)((bench_rand() << 8 | bench_rand()) % (2 * silencios[s] + 1)) : 0;
+                if (n[e] + lixo + TAM + 4 > sizeof(fluxo[e])) break;
+                for (size_t i = 0; i < lixo; i++) fluxo[e][n[e]++] = 'x';
+                for (int i = 0; i < TAM; i++) payload[i] = bench_rand();
+                n[e] += tx_compose_chk(&tx, payload, TAM, &fluxo[e][n[e]], CHK_XOR);
+            }
+        }
+        for (uint8_t blocos = 1; blocos <= ENLACES; blocos *= 2) {
+            Pool pool = POOL_INICIALIZA(mem, FRAME_MAX, blocos);
+            size_t ok = 0;
+            for (int e = 0; e < ENLACES; e++) {
+                rx_reset(&rx[e]);
+                rx_configura_pool(&rx[e], &pool);
+            }
+            for (size_t i = 0; i < TAM_FLUXO; i += RAJADA) {
+                for (int e = 0; e < ENLACES; e++) {
+                    if (i < n[e]) rx_handle_bytes(&rx[e], &fluxo[e][i],
+                                                  n[e] - i < RAJADA ? n[e] - i : RAJADA, bench_conta, &ok);
+                }
+            }
+            printf("  ocupao %3zu%%, %d blocos: pico %u, esgotado %6u, OK %6zu, RAM %zu bytes\n",
+                   100 * (TAM + 4) / (TAM + 4 + silencios[s]), blocos, pool.est.pico,
+                   pool.est.esgotado, ok, ENLACES * sizeof(FSM_Rx) + sizeof(Pool) + blocos * FRAME_MAX);
+        }
+    }
+#endif
+}
+
+static void roda_benchmarks(void) {
+    bench_rx_bloco();
+    bench_chk();
+    bench_crc();
+    bench_rx_anel();
+    bench_tx_lote();
+    bench_tx_anel();
+    bench_rx_multi();
+    bench_rx_motores();
+    bench_rx_ressinc();
+    bench_quadro_ext();
+    bench_cobs();
+    bench_tlv();
+    bench_lz();
+    bench_despacho();
+    bench_dialetos();
+    bench_pool();
+}
+#endif
+
+// ---------------- Sute de desempenho ----------------
+// "./fsm bench csv|json [arquivo]": rx_handle_byte, tx_compose e gera_chk
+// com payload, proporo de lixo e taxa de erro variando. Relata custo por
+// byte, quadros/s e latncia por quadro (p50/p99/p999). "arquivo"  um
+// fluxo gravado do enlace (bytes crus, CHK XOR) analisado como mais um caso.
+// No Cortex-M0+ o relgio  o SysTick em ciclos do ncleo, a sute roda
+// direto do main() e a sada  CSV pela printf (UART/semihosting).
+#if defined(__ARM_ARCH_6M__)
+#define SYST_CSR (*(volatile uint32_t*)0xE000E010u)
+#define SYST_RVR (*(volatile uint32_t*)0xE000E014u)
+#define SYST_CVR (*(volatile uint32_t*)0xE000E018u)
+#ifndef SUITE_CPU_HZ
+#define SUITE_CPU_HZ 48000000u     // SAMD21 a 48 MHz
+#endif
+#define SUITE_UNIDADE "ciclos"
+#define SUITE_POR_SEG ((double)SUITE_CPU_HZ)
+#define SUITE_FLUXO   4096
+#define SUITE_AMOSTRAS 512
+
+// SysTick tem 24 bits e conta para baixo; as voltas estendem para 64.
+static volatile uint32_t suite_voltas;
+void SysTick_Handler(void) { suite_voltas++; }
+
+static void suite_relogio_inicia(void) {
+    SYST_RVR = 0xFFFFFFu;
+    SYST_CVR = 0;
+    SYST_CSR = 7;   // clock do ncleo, com interrupo, ligado
+}
+
+static uint64_t suite_relogio(void) {
+    uint32_t v, c;
+    do {
+        v = suite_voltas;
+        c = SYST_CVR;
+    } while (v != suite_voltas);
+    return ((uint64_t)v << 24) + (0xFFFFFFu - c);
+}
+#else
+#define SUITE_UNIDADE "ns"
+#define SUITE_POR_SEG 1e9
+#define SUITE_FLUXO   (1 << 20)
+#define SUITE_AMOSTRAS (1 << 18)
+
+static void suite_relogio_inicia(void) {}
+
+static uint64_t suite_relogio(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+#endif
+
+typedef enum { SUITE_CSV, SUITE_JSON } SuiteFormato;
+
+typedef struct {
+    const char* op;
+    unsigned payload, lixo_pct, erro_ppm;
+    size_t bytes, quadros;
+    uint64_t total;               // unidades de SUITE_UNIDADE
+    uint32_t p50, p99, p999;
+} SuiteResultado;
+
+static uint32_t suite_amostra[SUITE_AMOSTRAS];
+static size_t suite_qtd;
+static uint64_t suite_ultimo;
+
+static void suite_marca(void) {
+    uint64_t t = suite_relogio();
+    if (suite_qtd < SUITE_AMOSTRAS) suite_amostra[suite_qtd++] = (uint32_t)(t - suite_ultimo);
+    suite_ultimo = t;
+}
+
+static int suite_compara(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void suite_percentis(SuiteResultado* r) {
+    r->p50 = r->p99 = r->p999 = 0;
+    if (suite_qtd == 0) return;
+    qsort(suite_amostra, suite_qtd, sizeof(suite_amostra[0]), suite_compara);
+    r->p50 = suite_amostra[suite_qtd * 500 / 1000];
+    r->p99 = suite_amostra[suite_qtd * 990 / 1000];
+    r->p999 = suite_amostra[suite_qtd * 999 / 1000];
+}
+
+static void suite_emite(SuiteFormato f, const SuiteResultado* r, bool primeiro) {
+    double por_byte = r->bytes ? (double)r->total / (double)r->bytes : 0;
+    double quadros_s = r->total ? (double)r->quadros * SUITE_POR_SEG / (double)r->total : 0;
+    if (f == SUITE_CSV) {
+        if (primeiro) printf("operacao,payload,lixo_pct,erro_ppm,bytes,quadros,unidade,por_byte,quadros_s,p50,p99,p999\n");
+        printf("%s,%u,%u,%u,%zu,%zu,%s,%.3f,%.0f,%lu,%lu,%lu\n", r->op, r->payload, r->lixo_pct,
+               r->erro_ppm, r->bytes, r->quadros, SUITE_UNIDADE, por_byte, quadros_s,
+               (unsigned long)r->p50, (unsigned long)r->p99, (unsigned long)r->p999);
+    } else {
+        printf("%s  {\"operacao\": \"%s\", \"payload\": %u, \"lixo_pct\": %u, \"erro_ppm\": %u, "
+               "\"bytes\": %zu, \"quadros\": %zu, \"unidade\": \"%s\", \"por_byte\": %.3f, "
+               "\"quadros_s\": %.0f, \"p50\": %lu, \"p99\": %lu, \"p999\": %lu}",
+               primeiro ? "[\n" : ",\n", r->op, r->payload, r->lixo_pct, r->erro_ppm, r->bytes,
+               r->quadros, SUITE_UNIDADE, por_byte, quadros_s,
+               (unsigned long)r->p50, (unsigned long)r->p99, (unsigned long)r->p999);
+    }
+}
+
+// Latncia de um quadro: do evento anterior (OK/FAIL) at o dele, ou seja,
+// inclui o lixo que o precede. Inclui tambm uma leitura do relgio.
+static void suite_rx(SuiteResultado* r, const uint8_t* fluxo, size_t n) {
+    FSM_Rx rx;
+    rx_reset(&rx);
+    suite_qtd = 0;
+    r->quadros = 0;
+    uint64_t t0 = suite_relogio();
+    suite_ultimo = t0;
+    for (size_t i = 0; i < n; i++) {
+        FrameResult res = rx_handle_byte(&rx, fluxo[i]);
+        if (res != FRAME_PROGRESS) {
+            r->quadros += res == FRAME_OK;
+            suite_marca();
+        }
+    }
+    r->total = suite_relogio() - t0;
+    r->bytes = n;
+    suite_percentis(r);
+}
+
+static void suite_roda(SuiteFormato f, const char* gravado) {
+    static uint8_t fluxo[SUITE_FLUXO];
+    const uint8_t tams[] = {8, 64, 255};
+    const unsigned lixos[] = {0, 25};
+    const unsigned erros[] = {0, 1000};
+    bool primeiro = true;
+    SuiteResultado r;
+    suite_relogio_inicia();
+
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        for (size_t l = 0; l < sizeof(lixos) / sizeof(lixos[0]); l++) {
+            for (size_t e = 0; e < sizeof(erros) / sizeof(erros[0]); e++) {
+                size_t lixo = (tams[t] + 4u) * lixos[l] / (100u - lixos[l]);
+                size_t n = bench_gera_fluxo(fluxo, sizeof(fluxo), tams[t], lixo);
+                uint32_t limiar = (uint32_t)((uint64_t)erros[e] * 4295u);
+                for (size_t i = 0; i < n; i++) {   // erro de byte com taxa erro_ppm
+                    bench_rand();
+                    if (bench_semente < limiar) fluxo[i] ^= (uint8_t)(1u << (bench_rand() & 7));
+                }
+                r = (SuiteResultado){"rx_handle_byte", tams[t], lixos[l], erros[e], 0, 0, 0, 0, 0, 0};
+                suite_rx(&r, fluxo, n);
+                suite_emite(f, &r, primeiro);
+                primeiro = false;
+            }
+        }
+    }
+
+    for (size_t t = 0; t < sizeof(tams); t++) {
+        enum { CHAMADAS = SUITE_AMOSTRAS / 4 };
+        uint8_t payload[FRAME_MAX], quadro[FRAME_MAX + 5];
+        TxPacket tx;
+        for (int i = 0; i < tams[t]; i++) payload[i] = bench_rand();
+
+        // tx_compose: latncia por chamada
+        suite_qtd = 0;
+        uint64_t t0 = suite_relogio();
+        suite_ultimo = t0;
+        for (int c = 0; c < CHAMADAS; c++) {
+            payload[c % tams[t]]++;
+            tx_compose(&tx, payload, tams[t], quadro);
+            suite_marca();
+        }
+        r = (SuiteResultado){"tx_compose", tams[t], 0, 0, (size_t)CHAMADAS * tams[t], CHAMADAS,
+                             suite_relogio() - t0, 0, 0, 0};
+        bench_sumidouro += quadro[tams[t] + 2];
+        suite_percentis(&r);
+        suite_emite(f, &r, primeiro);
+
+        // gera_chk: idem
+        uint8_t c8 = 0;
+        suite_qtd = 0;
+        t0 = suite_relogio();
+        suite_ultimo = t0;
+        for (int c = 0; c < CHAMADAS; c++) {
+            payload[c % tams[t]]++;
+            c8 ^= gera_chk(payload, tams[t]);
+            suite_marca();
+        }
+        r = (SuiteResultado){"gera_chk", tams[t], 0, 0, (size_t)CHAMADAS * tams[t], CHAMADAS,
+                             suite_relogio() - t0, 0, 0, 0};
+        bench_sumidouro += c8;
+        suite_percentis(&r);
+        suite_emite(f, &r, primeiro);
+    }
+
+#if !defined(__ARM_ARCH_6M__)
+    if (gravado) {
+        FILE* arq = fopen(gravado, "rb");
+        if (arq) {
+            size_t n = fread(fluxo, 1, sizeof(fluxo), arq);
+            fclose(arq);
+            r = (SuiteResultado){"rx_handle_byte_gravado", 0, 0, 0, 0, 0, 0, 0, 0, 0};
+            suite_rx(&r, fluxo, n);
+            suite_emite(f, &r, primeiro);
+        } else {
+            fprintf(stderr, "no abriu %s\n", gravado);
+        }
+    }
+#else
+    (void)gravado;
+#endif
+    if (f == SUITE_JSON) printf("\n]\n");
+}
+
+#if RX_ESTAT && !defined(__ARM_ARCH_6M__)
+// "./fsm estat" (compilado com -DRX_ESTAT=1): dois canais simulados a
+// 115200 baud, 250 ms por linha; o canal 1 piora na segunda metade. Para
+// ver as taxas: ./fsm estat | ./taxas
+static void estat_demo(void) {
+    enum { BYTES_250MS = 2880 };
+    static uint8_t fluxo[BYTES_250MS];
+    FSM_Rx rx[2];
+    RxEstatDados d;
+    rx_reset(&rx[0]); rx_reset(&rx[1]);
+    rx_estat_cabecalho(stdout);
+    for (uint32_t fase = 1; fase <= 16; fase++) {
+        for (uint16_t c = 0; c < 2; c++) {
+            bool ruim = c == 1 && fase > 8;
+            size_t n = bench_gera_fluxo(fluxo, sizeof(fluxo), 64, ruim ? 40 : 2);
+            for (size_t i = 0; ruim && i < n; i++) {   // ~3000 ppm de erro de byte
+                bench_rand();
+                if (bench_semente < 12884902u) fluxo[i] ^= 0x10;
+            }
+            rx_handle_bytes(&rx[c], fluxo, n, NULL, NULL);
+            if (rx_estat_copia(&rx[c].est, &d)) rx_estat_imprime(stdout, fase * 250, c, &d);
+        }
+    }
+}
+#endif
+
+int main(int argc, char** argv) {
+#if defined(__ARM_ARCH_6M__)
+    (void)argc; (void)argv;
+    suite_roda(SUITE_CSV, NULL);
+    return 0;
+#else
+#if RX_ESTAT
+    if (argc > 1 && strcmp(argv[1], "estat") == 0) {
+        estat_demo();
+        return 0;
+    }
+#endif
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        if (argc > 2 && strcmp(argv[2], "csv") == 0) suite_roda(SUITE_CSV, argc > 3 ? argv[3] : NULL);
+        else if (argc > 2 && strcmp(argv[2], "json") == 0) suite_roda(SUITE_JSON, argc > 3 ? argv[3] : NULL);
+        else roda_benchmarks();
+        return 0;
+    }
+
     char* res = roda_todos();
     printf("\n     Resultado \n");
     if (res) {
@@ -185,4 +3974,6 @@ int main(void) {
     }
     printf("Testes executados: %d\n", total_testes);
     return res != 0;
+#endif
 }
+#endif // FSM_SEM_MAIN
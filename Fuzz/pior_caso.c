@@ -0,0 +1,468 @@
+/*
+ * pior_caso.c
+ *
+ * Busca do pior caso de custo do receptor, para o orcamento de tempo real:
+ * interessa o maximo, nao a media. O objetivo da busca e o custo, nao uma
+ * falha; as piores entradas encontradas ficam gravadas e viram benchmarks
+ * de regressao (modo -r).
+ *
+ * Alvos (um por binario):
+ *  - rx_handle_byte() de FSM.c (padrao). ALVO_MODO escolhe o CHK
+ *    (CHK_XOR, CHK_CRC16, CHK_CRC32), ALVO_EXT=1 liga quadros estendidos;
+ *    RX_MOTOR_TABELA vale como em FSM.c.
+ *  - fsm_process() de "FSM e ponteiro/fsm.c" (-DALVO_PONTEIRO).
+ *
+ * Custo de uma chamada:
+ *  - padrao: instrucoes de usuario pelo contador de hardware
+ *    (perf_event_open). A leitura do contador e descontada.
+ *  - -DCUSTO_BLOCOS: modelo fixo, blocos basicos executados. Deterministico,
+ *    nao depende da maquina; compilar com -fsanitize-coverage=trace-pc.
+ *
+ * Objetivos, cada um com seu arquivo em <dir>/:
+ *  - byte.bin:   maior custo de uma chamada (um byte)
+ *  - quadro.bin: maior custo de um quadro (do SOF ate OK/FAIL; lixo
+ *                entre quadros nao conta)
+ *  - media.bin:  maior custo medio por byte da entrada inteira
+ *
+ * Uso:
+ *  gcc -O2 -DCUSTO_BLOCOS -fsanitize-coverage=trace-pc Fuzz/pior_caso.c -o pior
+ *  ./pior [-n iteracoes] [-m tamanho_max] [-o dir]    busca autonoma
+ *  ./pior -r arquivos...                               mede e relata
+ *
+ *  clang -O2 -fsanitize=fuzzer -DCOM_LIBFUZZER Fuzz/pior_caso.c -o pior
+ *  PIOR_DIR=dir ./pior corpus/
+ * Com libFuzzer a cobertura vem dele; o custo entra como contadores extras
+ * por faixa (pior_faixas), entao uma entrada mais cara e "cobertura nova".
+ * Os arquivos gravados sao fluxos crus: "./fsm bench csv media.bin" tambem
+ * os aceita (no modo de CHK padrao).
+ *
+ * Fuzz/pior/ guarda os piores da busca padrao (FSM.c, CHK_XOR, modelo de
+ * blocos, rodada de dentro de Fuzz/). Reproduzidos com "-r", os tres
+ * arquivos devem relatar pior byte 6, pior quadro 1292 e media 5.00
+ * blocos/byte; numero maior depois de uma mudanca no receptor e regressao.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define FSM_SEM_MAIN
+#ifdef ALVO_PONTEIRO
+#include "../FSM e ponteiro/fsm.c"
+#else
+#include "../FSM.c"
+#endif
+
+#ifndef CUSTO_BLOCOS
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#ifndef ALVO_MODO
+#define ALVO_MODO CHK_XOR
+#endif
+#ifndef ALVO_EXT
+#define ALVO_EXT 0
+#endif
+#define PIOR_ENTRADA_MAX 8192
+
+// ---------------- Alvo ----------------
+#ifdef ALVO_PONTEIRO
+static FSM alvo;
+
+static void alvo_inicia(void) { fsm_init(&alvo); }
+static bool alvo_ocioso(void) { return alvo.state == ST_STX; }
+
+// true no fim de um quadro (DONE/ERROR); a aplicacao reinicia a maquina,
+// e isso entra no custo do byte.
+static bool alvo_byte(uint8_t b) {
+    fsm_process(&alvo, b);
+    if (alvo.state == ST_DONE || alvo.state == ST_ERROR) {
+        fsm_libera(&alvo);
+        fsm_init(&alvo);
+        return true;
+    }
+    return false;
+}
+#else
+static FSM_Rx alvo;
+#if ALVO_EXT
+static uint8_t alvo_ext[FRAME_EXT_MAX];
+#endif
+
+static void alvo_inicia(void) {
+    rx_reset(&alvo);
+    rx_configura_chk(&alvo, ALVO_MODO);
+#if ALVO_EXT
+    rx_configura_ext(&alvo, alvo_ext, sizeof(alvo_ext));
+#endif
+}
+
+static bool alvo_ocioso(void) { return alvo.estado == RX_WAIT_SOF; }
+
+static bool alvo_byte(uint8_t b) {
+    return rx_handle_byte(&alvo, b) != FRAME_PROGRESS;
+}
+#endif
+
+// ---------------- Custo ----------------
+#ifdef CUSTO_BLOCOS
+#define CUSTO_UNIDADE "blocos"
+volatile uint64_t custo_blocos;   // volatil: a chamada e "leaf" para o gcc
+
+// Chamado pelo compilador em cada bloco basico (-fsanitize-coverage=trace-pc).
+__attribute__((no_sanitize_coverage)) void __sanitizer_cov_trace_pc(void) {
+    custo_blocos++;
+}
+
+static bool custo_inicia(void) { return true; }
+static inline uint64_t custo_le(void) { return custo_blocos; }
+#else
+#define CUSTO_UNIDADE "instrucoes"
+static int custo_fd = -1;
+
+static inline uint64_t custo_le(void) {
+    uint64_t v = 0;
+    if (read(custo_fd, &v, sizeof(v)) != sizeof(v)) v = 0;
+    return v;
+}
+
+static bool custo_inicia(void) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof(a);
+    a.config = PERF_COUNT_HW_INSTRUCTIONS;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    custo_fd = (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+    if (custo_fd < 0) {
+        fprintf(stderr, "perf_event_open: %s (compile com -DCUSTO_BLOCOS "
+                        "-fsanitize-coverage=trace-pc para o modelo fixo)\n", strerror(errno));
+        return false;
+    }
+    ioctl(custo_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(custo_fd, PERF_EVENT_IOC_ENABLE, 0);
+    return true;
+}
+#endif
+
+// Custo de duas leituras seguidas, descontado de cada medida.
+static uint64_t custo_vazio;
+
+static void custo_calibra(void) {
+    custo_vazio = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t c0 = custo_le();
+        uint64_t c = custo_le() - c0;
+        if (c < custo_vazio) custo_vazio = c;
+    }
+}
+
+// ---------------- Medida ----------------
+typedef struct {
+    size_t bytes, quadros;
+    uint64_t total;
+    uint64_t pior_byte;     // maior custo de uma chamada
+    uint64_t pior_quadro;   // maior custo de um quadro
+} PiorMedida;
+
+static double pior_media(const PiorMedida* m) {
+    return m->bytes ? (double)m->total / (double)m->bytes : 0;
+}
+
+static void pior_mede(const uint8_t* d, size_t n, PiorMedida* m) {
+    uint64_t quadro = 0;
+    memset(m, 0, sizeof(*m));
+    alvo_inicia();
+    for (size_t i = 0; i < n; i++) {
+        uint64_t c0 = custo_le();
+        bool fim = alvo_byte(d[i]);
+        uint64_t c = custo_le() - c0;
+        c = (c > custo_vazio) ? c - custo_vazio : 0;
+        m->total += c;
+        if (fim || !alvo_ocioso()) quadro += c;
+        if (c > m->pior_byte) m->pior_byte = c;
+        if (fim) {
+            m->quadros++;
+            if (quadro > m->pior_quadro) m->pior_quadro = quadro;
+            quadro = 0;
+        }
+    }
+    m->bytes = n;
+}
+
+// Faixa logaritmica com 4 subdivisoes por oitava: 0..31.
+static unsigned pior_faixa(uint64_t c) {
+    if (c < 4) return (unsigned)c;
+    unsigned e = 63u - (unsigned)__builtin_clzll(c);
+    unsigned f = 4 * (e - 1) + (unsigned)((c >> (e - 2)) & 3);
+    return f < 32 ? f : 31;
+}
+
+// Calibra e aquece o alvo: o 1o quadro com CRC gera as tabelas do
+// slicing-by-8 (checksum.h), custo de uma vez so que nao e o regime.
+static bool pior_prepara(void) {
+    if (!custo_inicia()) return false;
+    custo_calibra();
+#ifndef ALVO_PONTEIRO
+    uint8_t carga[4] = {1, 2, 3, 4}, q[16];
+    TxPacket tx;
+    size_t n = tx_compose_chk(&tx, carga, sizeof(carga), q, ALVO_MODO);
+    alvo_inicia();
+    for (size_t i = 0; i < n; i++) alvo_byte(q[i]);
+#endif
+    return true;
+}
+
+// ---------------- Piores ate agora ----------------
+static const char* pior_dir = "pior";
+static PiorMedida pior_max;
+static double pior_max_media;
+
+static void pior_grava(const char* nome, const uint8_t* d, size_t n) {
+    char caminho[512];
+    mkdir(pior_dir, 0777);
+    snprintf(caminho, sizeof(caminho), "%s/%s", pior_dir, nome);
+    FILE* arq = fopen(caminho, "wb");
+    if (!arq) {
+        fprintf(stderr, "nao gravou %s\n", caminho);
+        return;
+    }
+    fwrite(d, 1, n, arq);
+    fclose(arq);
+}
+
+// Registra a medida; retorna true se algum objetivo melhorou.
+static bool pior_registra(const uint8_t* d, size_t n, const PiorMedida* m) {
+    bool melhorou = false;
+    if (m->pior_byte > pior_max.pior_byte) {
+        pior_max.pior_byte = m->pior_byte;
+        pior_grava("byte.bin", d, n);
+        melhorou = true;
+    }
+    if (m->pior_quadro > pior_max.pior_quadro) {
+        pior_max.pior_quadro = m->pior_quadro;
+        pior_grava("quadro.bin", d, n);
+        melhorou = true;
+    }
+    // media so com entradas de tamanho razoavel: 1 byte caro nao e "fluxo"
+    if (n >= 64 && pior_media(m) > pior_max_media) {
+        pior_max_media = pior_media(m);
+        pior_grava("media.bin", d, n);
+        melhorou = true;
+    }
+    return melhorou;
+}
+
+static void pior_relata(const char* nome, const PiorMedida* m) {
+    printf("%s: %zu bytes, %zu quadros, pior byte %llu, pior quadro %llu, media %.2f %s/byte\n",
+           nome, m->bytes, m->quadros, (unsigned long long)m->pior_byte,
+           (unsigned long long)m->pior_quadro, pior_media(m), CUSTO_UNIDADE);
+}
+
+// ---------------- libFuzzer ----------------
+// Contadores extras: libFuzzer zera antes de cada execucao e trata cada
+// posicao nao nula como uma caracteristica. Faixas de custo mais altas sao
+// caracteristicas novas, o que puxa o corpus para entradas mais caras.
+__attribute__((used, section("__libfuzzer_extra_counters")))
+static uint8_t pior_faixas[3 * 32];
+
+static bool pior_pronto;
+
+int LLVMFuzzerTestOneInput(const uint8_t* d, size_t n) {
+    PiorMedida m;
+    if (!pior_pronto) {
+        const char* dir = getenv("PIOR_DIR");
+        if (dir) pior_dir = dir;
+        if (!pior_prepara()) abort();
+        pior_pronto = true;
+    }
+    pior_mede(d, n, &m);
+    pior_faixas[pior_faixa(m.pior_byte)] = 1;
+    pior_faixas[32 + pior_faixa(m.pior_quadro)] = 1;
+    if (n >= 64) pior_faixas[64 + pior_faixa((uint64_t)(pior_media(&m) * 8))] = 1;
+    if (pior_registra(d, n, &m)) pior_relata("novo pior", &m);
+    return 0;
+}
+
+// ---------------- Busca autonoma ----------------
+#ifndef COM_LIBFUZZER
+#define CORPUS_MAX 256
+
+typedef struct {
+    uint8_t* d;
+    size_t n;
+} Entrada;
+
+static Entrada corpus[CORPUS_MAX];
+static size_t corpus_qtd;
+static uint8_t vistas[sizeof(pior_faixas)];   // faixas ja alcancadas
+static uint32_t pior_semente = 12345;
+
+static uint32_t pior_rand(void) {
+    pior_semente = pior_semente * 1103515245u + 12345u;
+    return pior_semente >> 8;
+}
+
+// Bytes que mexem na maquina: delimitadores e tamanhos nos extremos.
+static const uint8_t pior_especiais[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x7F, 0x80, 0xFE, 0xFF};
+
+static size_t pior_muta(uint8_t* d, size_t n, size_t cap) {
+    int vezes = 1 + (int)(pior_rand() % 4);
+    while (vezes--) {
+        size_t i = n ? pior_rand() % n : 0;
+        switch (pior_rand() % 7) {
+        case 0:   // inverte um bit
+            if (n) d[i] ^= (uint8_t)(1u << (pior_rand() & 7));
+            break;
+        case 1:   // byte aleatorio
+            if (n) d[i] = (uint8_t)pior_rand();
+            break;
+        case 2:   // byte especial
+            if (n) d[i] = pior_especiais[pior_rand() % sizeof(pior_especiais)];
+            break;
+        case 3:   // insere
+            if (n < cap) {
+                memmove(&d[i + 1], &d[i], n - i);
+                d[i] = (uint8_t)pior_rand();
+                n++;
+            }
+            break;
+        case 4:   // remove
+            if (n > 1) {
+                memmove(&d[i], &d[i + 1], n - i - 1);
+                n--;
+            }
+            break;
+        case 5: { // duplica um trecho no fim (repete quadros caros)
+            size_t k = n ? 1 + pior_rand() % (n - i) : 0;
+            if (k > cap - n) k = cap - n;
+            memmove(&d[n], &d[i], k);
+            n += k;
+            break;
+        }
+        default: { // enxerta trecho de outra entrada do corpus
+            const Entrada* o = &corpus[pior_rand() % corpus_qtd];
+            size_t j = pior_rand() % o->n, k = 1 + pior_rand() % (o->n - j);
+            if (k > cap - i) k = cap - i;
+            memcpy(&d[i], &o->d[j], k);
+            if (i + k > n) n = i + k;
+            break;
+        }
+        }
+    }
+    return n;
+}
+
+// Marca as faixas da medida; retorna true se alguma e nova.
+static bool pior_cobertura(const PiorMedida* m) {
+    size_t f[3] = {pior_faixa(m->pior_byte), 32 + pior_faixa(m->pior_quadro),
+                   64 + pior_faixa((uint64_t)(pior_media(m) * 8))};
+    bool nova = false;
+    for (int k = 0; k < (m->bytes >= 64 ? 3 : 2); k++) {
+        if (!vistas[f[k]]) {
+            vistas[f[k]] = 1;
+            nova = true;
+        }
+    }
+    return nova;
+}
+
+static void corpus_adiciona(const uint8_t* d, size_t n) {
+    size_t i = corpus_qtd < CORPUS_MAX ? corpus_qtd++ : pior_rand() % CORPUS_MAX;
+    free(corpus[i].d);
+    corpus[i].d = malloc(n);
+    memcpy(corpus[i].d, d, n);
+    corpus[i].n = n;
+}
+
+static void pior_busca(long iteracoes, size_t tam_max) {
+    static uint8_t d[PIOR_ENTRADA_MAX];
+    PiorMedida m;
+    uint8_t carga[255];
+
+    // Sementes: um quadro valido, um quadro maximo e lixo.
+    for (int i = 0; i < 255; i++) carga[i] = (uint8_t)(i * 7);
+#ifdef ALVO_PONTEIRO
+    d[0] = STX; d[1] = 4; memcpy(&d[2], carga, 4);
+    d[6] = (uint8_t)(4 ^ carga[0] ^ carga[1] ^ carga[2] ^ carga[3]); d[7] = ETX;
+    corpus_adiciona(d, 8);
+#else
+    TxPacket tx;
+    corpus_adiciona(d, tx_compose_chk(&tx, carga, 4, d, ALVO_MODO));
+    corpus_adiciona(d, tx_compose_chk(&tx, carga, sizeof(carga), d, ALVO_MODO));
+#endif
+    for (size_t i = 0; i < 64; i++) d[i] = (uint8_t)pior_rand();
+    corpus_adiciona(d, 64);
+    for (size_t i = 0; i < corpus_qtd; i++) {
+        pior_mede(corpus[i].d, corpus[i].n, &m);
+        pior_cobertura(&m);
+        pior_registra(corpus[i].d, corpus[i].n, &m);
+    }
+
+    for (long it = 0; it < iteracoes; it++) {
+        const Entrada* pai = &corpus[pior_rand() % corpus_qtd];
+        size_t n = pai->n < tam_max ? pai->n : tam_max;
+        memcpy(d, pai->d, n);
+        n = pior_muta(d, n, tam_max);
+        pior_mede(d, n, &m);
+        bool nova = pior_cobertura(&m);
+        if (pior_registra(d, n, &m)) {
+            nova = true;
+            printf("[%ld] ", it);
+            pior_relata("novo pior", &m);
+        }
+        if (nova) corpus_adiciona(d, n);
+    }
+    printf("corpus %zu entradas; pior byte %llu, pior quadro %llu, media %.2f %s/byte (em %s/)\n",
+           corpus_qtd, (unsigned long long)pior_max.pior_byte,
+           (unsigned long long)pior_max.pior_quadro, pior_max_media, CUSTO_UNIDADE, pior_dir);
+}
+
+static int pior_reproduz(int argc, char** argv) {
+    static uint8_t d[1 << 20];
+    int erros = 0;
+    for (int i = 0; i < argc; i++) {
+        FILE* arq = fopen(argv[i], "rb");
+        if (!arq) {
+            fprintf(stderr, "nao abriu %s\n", argv[i]);
+            erros++;
+            continue;
+        }
+        size_t n = fread(d, 1, sizeof(d), arq);
+        fclose(arq);
+        PiorMedida m;
+        pior_mede(d, n, &m);
+        pior_relata(argv[i], &m);
+    }
+    return erros != 0;
+}
+
+int main(int argc, char** argv) {
+    long iteracoes = 200000;
+    size_t tam_max = 1024;
+    if (!pior_prepara()) return 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0) return pior_reproduz(argc - i - 1, &argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) iteracoes = atol(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) tam_max = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pior_dir = argv[++i];
+        else {
+            fprintf(stderr, "uso: %s [-n iteracoes] [-m tamanho_max] [-o dir] | -r arquivos...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (tam_max < 1 || tam_max > PIOR_ENTRADA_MAX) tam_max = PIOR_ENTRADA_MAX;
+    pior_busca(iteracoes, tam_max);
+    return 0;
+}
+#endif
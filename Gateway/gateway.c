@@ -0,0 +1,680 @@
+/*
+ * gateway.c
+ *
+ * Concentrador de enlaces num processo so: centenas de ttys/ptys lidos
+ * com epoll, o receptor em bloco de FSM.c (rx_handle_bytes) por enlace e
+ * os quadros entregues a consumidores locais por um socket Unix.
+ *
+ * Leitura: cada enlace e nao bloqueante e registrado com EPOLLET. Borda
+ * obriga a ler ate EAGAIN, mas um enlace com trafego continuo prenderia o
+ * laco: depois de GW_LEITURAS_POR_VEZ read() sem EAGAIN o enlace vai para
+ * a fila de pendentes e passa a vez; a fila e servida, em rodizio, entre
+ * uma epoll_wait(timeout 0) e outra. Um buffer de leitura so para todos.
+ *
+ * Consumidores: conectam no socket (SOCK_SEQPACKET, -s caminho) e recebem
+ * cada quadro OK de qualquer enlace como uma mensagem: GwCab (enlace, n)
+ * seguido do payload. Os quadros de uma volta do laco sao copiados para um
+ * lote e saem com um sendmmsg() por consumidor. Consumidor lento nao
+ * segura o gateway: o que nao cabe no socket dele e descartado e contado.
+ *
+ * Uso:
+ *  gcc -O2 Gateway/gateway.c -o gateway
+ *  ./gateway [-c modo] [-B baud] -s /tmp/gw.sock /dev/ttyUSB0 /dev/ttyUSB1 ...
+ *      serve os enlaces ate Ctrl-C; as portas ficam em modo cru
+ *  ./gateway -o /tmp/gw.sock
+ *      consumidor de exemplo: lista enlace, tamanho e payload
+ *  ./gateway [-c modo] -p N [-q quadros] [-t bytes] [-r quadros/s]
+ *      benchmark com N pares de pty: um gerador (processo filho) escreve
+ *      "quadros" quadros de "bytes" de payload em cada lado mestre, no
+ *      ritmo de "quadros/s" por enlace (0 = o mais rapido possivel), e um
+ *      consumidor (outro filho) confere a sequencia de cada enlace.
+ *      Relata quadros/s e a CPU do gateway, tambem por 1000 enlaces.
+ * Opcoes:
+ *  -c modo   xor | crc16 | crc32 (padrao xor)
+ *  -B baud   velocidade das ttys reais (padrao: nao mexe)
+ *
+ * Mais de ~500 enlaces: o benchmark sobe o limite de descritores
+ * (RLIMIT_NOFILE) ate o maximo permitido.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define FSM_SEM_MAIN
+#include "../FSM.c"
+
+#define GW_LEITURA          65536
+#define GW_LEITURAS_POR_VEZ 4
+#define GW_LOTE             64      // quadros por sendmmsg()
+#define GW_CONSUMIDORES     16
+#define GW_EVENTOS          256
+
+// Tag do epoll: indice do enlace, ou um destes
+#define GW_TAG_ESCUTA     0xFFFFFFFFu
+#define GW_TAG_CONSUMIDOR (1ull << 32)
+
+// Cabecalho de cada mensagem ao consumidor
+typedef struct {
+    uint16_t enlace;        // ordem em que o enlace foi adicionado
+    uint16_t n;             // bytes de payload que seguem
+} GwCab;
+
+typedef struct {
+    int fd;                 // -1: fechado
+    FSM_Rx rx;
+    bool pendente;          // na fila de pendentes
+    uint64_t ok, falhas, bytes;
+} Enlace;
+
+typedef struct {
+    int ep, escuta;
+    ChkModo modo;
+    Enlace* enl;
+    size_t qtd, abertos;
+    int cons[GW_CONSUMIDORES];
+    size_t ncons;
+    uint32_t* pend;         // fila de pendentes, em rodizio
+    size_t npend;
+    // lote de quadros da volta atual
+    GwCab cab[GW_LOTE];
+    uint8_t pl[GW_LOTE][FRAME_MAX];
+    struct iovec iov[GW_LOTE][2];
+    struct mmsghdr msg[GW_LOTE];
+    size_t nlote;
+    uint64_t ok, falhas, bytes, leituras, descartados;
+} Gateway;
+
+static uint8_t gw_buf[GW_LEITURA];
+
+static double agora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static bool modo_de(const char* s, ChkModo* m) {
+    if (strcmp(s, "xor") == 0) *m = CHK_XOR;
+    else if (strcmp(s, "crc16") == 0) *m = CHK_CRC16;
+    else if (strcmp(s, "crc32") == 0) *m = CHK_CRC32;
+    else return false;
+    return true;
+}
+
+static speed_t baud_de(long b) {
+    switch (b) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return B0;
+    }
+}
+
+// Abre uma tty (ou o lado escravo de uma pty) nao bloqueante e crua:
+// sem eco, sem CR/LF, sem ^C/^D virando sinal ou fim de arquivo.
+static int tty_abre(const char* caminho, speed_t baud) {
+    int fd = open(caminho, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct termios t;
+    if (tcgetattr(fd, &t) == 0) {
+        cfmakeraw(&t);
+        if (baud != B0) cfsetspeed(&t, baud);
+        tcsetattr(fd, TCSANOW, &t);
+    }
+    return fd;
+}
+
+// ---------------- Gateway ----------------
+
+static bool gw_init(Gateway* g, ChkModo modo, const char* sock) {
+    memset(g, 0, sizeof(*g));
+    g->modo = modo;
+    g->escuta = -1;
+    for (size_t i = 0; i < GW_LOTE; i++) {
+        g->iov[i][0] = (struct iovec){&g->cab[i], sizeof(GwCab)};
+        g->iov[i][1].iov_base = g->pl[i];
+        g->msg[i].msg_hdr.msg_iov = g->iov[i];
+        g->msg[i].msg_hdr.msg_iovlen = 2;
+    }
+    g->ep = epoll_create1(EPOLL_CLOEXEC);
+    if (g->ep < 0) return false;
+    if (!sock) return true;
+    struct sockaddr_un a = {.sun_family = AF_UNIX};
+    if (strlen(sock) >= sizeof(a.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    strcpy(a.sun_path, sock);
+    unlink(sock);
+    g->escuta = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (g->escuta < 0 || bind(g->escuta, (struct sockaddr*)&a, sizeof(a)) < 0 ||
+        listen(g->escuta, GW_CONSUMIDORES) < 0) {
+        return false;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = GW_TAG_ESCUTA};
+    return epoll_ctl(g->ep, EPOLL_CTL_ADD, g->escuta, &ev) == 0;
+}
+
+static bool gw_adiciona(Gateway* g, int fd) {
+    Enlace* e = realloc(g->enl, (g->qtd + 1) * sizeof(Enlace));
+    // em gw_passo() a fila tem os pendentes da volta e os que reentram
+    uint32_t* p = realloc(g->pend, 2 * (g->qtd + 1) * sizeof(uint32_t));
+    if (e) g->enl = e;
+    if (p) g->pend = p;
+    if (!e || !p || g->qtd >= UINT16_MAX) return false;
+    e = &g->enl[g->qtd];
+    memset(e, 0, sizeof(*e));
+    e->fd = fd;
+    rx_reset(&e->rx);
+    rx_configura_chk(&e->rx, g->modo);
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET, .data.u64 = g->qtd};
+    if (epoll_ctl(g->ep, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+    g->qtd++;
+    g->abertos++;
+    return true;
+}
+
+static void gw_fecha_enlace(Gateway* g, uint32_t i) {
+    Enlace* e = &g->enl[i];
+    if (e->fd < 0) return;
+    epoll_ctl(g->ep, EPOLL_CTL_DEL, e->fd, NULL);
+    close(e->fd);
+    e->fd = -1;
+    rx_libera(&e->rx);
+    g->abertos--;
+}
+
+static void gw_fecha_consumidor(Gateway* g, size_t k) {
+    epoll_ctl(g->ep, EPOLL_CTL_DEL, g->cons[k], NULL);
+    close(g->cons[k]);
+    g->cons[k] = g->cons[--g->ncons];
+}
+
+static void gw_aceita(Gateway* g) {
+    int fd;
+    while ((fd = accept4(g->escuta, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if (g->ncons == GW_CONSUMIDORES) {
+            close(fd);
+            continue;
+        }
+        int tam = 4 << 20;  // limitado por net.core.wmem_max
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &tam, sizeof(tam));
+        struct epoll_event ev = {.events = EPOLLRDHUP, .data.u64 = GW_TAG_CONSUMIDOR};
+        epoll_ctl(g->ep, EPOLL_CTL_ADD, fd, &ev);
+        g->cons[g->ncons++] = fd;
+    }
+}
+
+// Manda o lote a cada consumidor; o que nao couber no socket e perdido.
+static void gw_envia_lote(Gateway* g) {
+    if (!g->nlote) return;
+    for (size_t k = 0; k < g->ncons;) {
+        int r = sendmmsg(g->cons[k], g->msg, (unsigned)g->nlote, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (r < 0 && errno != EAGAIN) {
+            g->descartados += g->nlote;
+            gw_fecha_consumidor(g, k);
+            continue;
+        }
+        g->descartados += g->nlote - (size_t)(r < 0 ? 0 : r);
+        k++;
+    }
+    g->nlote = 0;
+}
+
+typedef struct {
+    Gateway* g;
+    uint32_t i;
+} GwCtx;
+
+static void gw_quadro(void* ctx, FrameResult r, size_t offset, const uint8_t* dados, uint16_t n) {
+    (void)offset;
+    GwCtx* c = ctx;
+    Gateway* g = c->g;
+    Enlace* e = &g->enl[c->i];
+    if (r != FRAME_OK) {
+        e->falhas++;
+        g->falhas++;
+        return;
+    }
+    e->ok++;
+    g->ok++;
+    if (!g->ncons) return;
+    // o payload so vale durante a chamada: copia para o lote
+    g->cab[g->nlote] = (GwCab){(uint16_t)c->i, n};
+    memcpy(g->pl[g->nlote], dados, n);
+    g->iov[g->nlote][1].iov_len = n;
+    if (++g->nlote == GW_LOTE) gw_envia_lote(g);
+}
+
+// Le o enlace ate EAGAIN ou ate GW_LEITURAS_POR_VEZ leituras; no segundo
+// caso ele entra na fila de pendentes.
+static void gw_le(Gateway* g, uint32_t i) {
+    Enlace* e = &g->enl[i];
+    GwCtx c = {g, i};
+    for (int k = 0; k < GW_LEITURAS_POR_VEZ; k++) {
+        ssize_t n = read(e->fd, gw_buf, sizeof(gw_buf));
+        if (n > 0) {
+            g->leituras++;
+            g->bytes += (uint64_t)n;
+            e->bytes += (uint64_t)n;
+            rx_handle_bytes(&e->rx, gw_buf, (size_t)n, gw_quadro, &c);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        gw_fecha_enlace(g, i);  // EOF, ou EIO (pty sem o lado mestre)
+        return;
+    }
+    if (!e->pendente) {
+        e->pendente = true;
+        g->pend[g->npend++] = i;
+    }
+}
+
+// Uma volta: eventos do epoll (sem esperar se ha pendentes), uma leitura
+// de cada pendente e o lote aos consumidores.
+static void gw_passo(Gateway* g, int espera_ms) {
+    struct epoll_event ev[GW_EVENTOS];
+    int n = epoll_wait(g->ep, ev, GW_EVENTOS, g->npend ? 0 : espera_ms);
+    for (int k = 0; k < n; k++) {
+        uint64_t tag = ev[k].data.u64;
+        if (tag == GW_TAG_ESCUTA) {
+            gw_aceita(g);
+        } else if (tag == GW_TAG_CONSUMIDOR) {
+            // so desconexao interessa
+            for (size_t j = 0; j < g->ncons; j++) {
+                char lixo;
+                if (recv(g->cons[j], &lixo, 1, MSG_DONTWAIT | MSG_PEEK) == 0) gw_fecha_consumidor(g, j--);
+            }
+        } else if (g->enl[tag].fd >= 0 && !g->enl[tag].pendente) {
+            gw_le(g, (uint32_t)tag);
+        }
+    }
+    size_t np = g->npend;
+    for (size_t k = 0; k < np; k++) {
+        uint32_t i = g->pend[k];
+        g->enl[i].pendente = false;
+        if (g->enl[i].fd >= 0) gw_le(g, i);
+    }
+    // os que continuam pendentes foram anexados depois de np
+    memmove(g->pend, &g->pend[np], (g->npend - np) * sizeof(uint32_t));
+    g->npend -= np;
+    gw_envia_lote(g);
+}
+
+static void gw_encerra(Gateway* g) {
+    for (uint32_t i = 0; i < g->qtd; i++) gw_fecha_enlace(g, i);
+    while (g->ncons) gw_fecha_consumidor(g, 0);
+    if (g->escuta >= 0) close(g->escuta);
+    close(g->ep);
+    free(g->enl);
+    free(g->pend);
+}
+
+// ---------------- Servico e consumidor de exemplo ----------------
+
+static volatile sig_atomic_t para;
+
+static void ao_sinal(int s) {
+    (void)s;
+    para = 1;
+}
+
+static void trata_sinais(void) {
+    struct sigaction sa = {0};
+    sa.sa_handler = ao_sinal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
+static int serve(ChkModo modo, speed_t baud, const char* sock, char** ttys, int n) {
+    static Gateway g;
+    if (!gw_init(&g, modo, sock)) {
+        perror(sock);
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        int fd = tty_abre(ttys[i], baud);
+        if (fd < 0 || !gw_adiciona(&g, fd)) {
+            perror(ttys[i]);
+            return 1;
+        }
+    }
+    trata_sinais();
+    while (!para && g.abertos) gw_passo(&g, 1000);
+    for (uint32_t i = 0; i < g.qtd; i++) {
+        fprintf(stderr, "%s: %llu bytes, %llu OK, %llu FAIL\n", ttys[i], (unsigned long long)g.enl[i].bytes,
+                (unsigned long long)g.enl[i].ok, (unsigned long long)g.enl[i].falhas);
+    }
+    fprintf(stderr, "descartados (consumidor lento): %llu\n", (unsigned long long)g.descartados);
+    gw_encerra(&g);
+    unlink(sock);
+    return 0;
+}
+
+static int conecta(const char* sock) {
+    struct sockaddr_un a = {.sun_family = AF_UNIX};
+    snprintf(a.sun_path, sizeof(a.sun_path), "%s", sock);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&a, sizeof(a)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int consome(const char* sock) {
+    int fd = conecta(sock);
+    if (fd < 0) {
+        perror(sock);
+        return 1;
+    }
+    uint8_t m[sizeof(GwCab) + FRAME_MAX];
+    ssize_t r;
+    while ((r = recv(fd, m, sizeof(m), 0)) >= (ssize_t)sizeof(GwCab)) {
+        GwCab c;
+        memcpy(&c, m, sizeof(c));
+        printf("%u %u", c.enlace, c.n);
+        for (uint16_t i = 0; i < c.n; i++) printf(" %02X", m[sizeof(GwCab) + i]);
+        putchar('\n');
+    }
+    close(fd);
+    return 0;
+}
+
+// ---------------- Benchmark com ptys ----------------
+
+typedef struct {
+    int n;                  // enlaces
+    uint32_t quadros;       // por enlace
+    uint8_t tam;            // payload
+    double ritmo;           // quadros/s por enlace; 0 = maximo
+    ChkModo modo;
+} Carga;
+
+// Payload do quadro "seq" do enlace "i": enlace, seq e enchimento
+static void carga_payload(uint8_t* p, const Carga* c, int i, uint32_t seq) {
+    p[0] = (uint8_t)i;
+    p[1] = (uint8_t)(i >> 8);
+    memcpy(&p[2], &seq, 4);
+    for (int k = 6; k < c->tam; k++) p[k] = (uint8_t)(seq + (uint32_t)k);
+}
+
+#define GERADOR_QUADROS_POR_ESCRITA 8
+
+// Gerador (processo filho): escreve os quadros de todos os enlaces nos
+// lados mestre, sem bloquear; escrita parcial continua de onde parou.
+// Avisa "pronto" ao terminar e espera "fim" fechar para sair (fechar os
+// mestres antes descartaria o que ainda esta na pty).
+static void gerador(const Carga* c, const int* mestre, int pronto, int fim) {
+    size_t max = (size_t)c->tam + 3 + chk_bytes(c->modo);
+    size_t cap = max * GERADOR_QUADROS_POR_ESCRITA;
+    uint8_t* buf = malloc((size_t)c->n * cap);
+    size_t* ini = calloc((size_t)c->n, sizeof(size_t));
+    size_t* tam = calloc((size_t)c->n, sizeof(size_t));
+    uint32_t* seq = calloc((size_t)c->n, sizeof(uint32_t));
+    uint8_t pl[FRAME_MAX];
+    TxPacket tx;
+    if (!buf || !ini || !tam || !seq) _exit(1);
+    double t0 = agora();
+    int faltam = c->n;
+    while (faltam) {
+        uint32_t permitidos = c->quadros;
+        if (c->ritmo > 0) {
+            double q = (agora() - t0) * c->ritmo + 1;
+            if (q < permitidos) permitidos = (uint32_t)q;
+        }
+        bool andou = false;
+        faltam = 0;
+        for (int i = 0; i < c->n; i++) {
+            uint8_t* b = &buf[(size_t)i * cap];
+            if (ini[i] == tam[i]) {
+                ini[i] = tam[i] = 0;
+                for (int k = 0; k < GERADOR_QUADROS_POR_ESCRITA && seq[i] < permitidos; k++) {
+                    carga_payload(pl, c, i, seq[i]++);
+                    tam[i] += tx_compose_chk(&tx, pl, c->tam, &b[tam[i]], c->modo);
+                }
+            }
+            if (ini[i] < tam[i]) {
+                ssize_t w = write(mestre[i], &b[ini[i]], tam[i] - ini[i]);
+                if (w > 0) {
+                    ini[i] += (size_t)w;
+                    andou = true;
+                }
+            }
+            faltam += (seq[i] < c->quadros || ini[i] < tam[i]);
+        }
+        if (!andou && faltam) {
+            struct timespec t = {0, c->ritmo > 0 ? 1000000 : 50000};
+            nanosleep(&t, NULL);
+        }
+    }
+    char x = 1;
+    if (write(pronto, &x, 1) < 0) _exit(1);
+    while (read(fim, &x, 1) < 0 && errno == EINTR) {}
+    _exit(0);
+}
+
+// Consumidor do benchmark: confere a sequencia de cada enlace e devolve
+// recebidos e lacunas pelo pipe "res" quando o gateway fecha o socket.
+static void consumidor(const Carga* c, const char* sock, int res) {
+    int fd = -1;
+    for (int k = 0; k < 200 && fd < 0; k++) {
+        fd = conecta(sock);
+        if (fd < 0) usleep(10000);
+    }
+    if (fd < 0) _exit(1);
+    char ok = 1;
+    if (write(res, &ok, 1) < 0) _exit(1);  // conectado
+    uint32_t* esperado = calloc((size_t)c->n, sizeof(uint32_t));
+    static uint8_t m[GW_LOTE][sizeof(GwCab) + FRAME_MAX];
+    struct iovec iov[GW_LOTE];
+    struct mmsghdr msg[GW_LOTE];
+    memset(msg, 0, sizeof(msg));
+    for (int i = 0; i < GW_LOTE; i++) {
+        iov[i] = (struct iovec){m[i], sizeof(m[i])};
+        msg[i].msg_hdr.msg_iov = &iov[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+    uint64_t r[3] = {0, 0, 0};  // recebidos, lacunas, invalidos
+    int n;
+    bool fim = false;
+    while (!fim && (n = recvmmsg(fd, msg, GW_LOTE, MSG_WAITFORONE, NULL)) > 0) {
+        for (int k = 0; k < n; k++) {
+            if (msg[k].msg_len == 0) {  // SEQPACKET: o gateway fechou
+                fim = true;
+                break;
+            }
+            GwCab cab;
+            uint32_t seq;
+            memcpy(&cab, m[k], sizeof(cab));
+            const uint8_t* p = &m[k][sizeof(GwCab)];
+            memcpy(&seq, &p[2], 4);
+            if (msg[k].msg_len < sizeof(GwCab) + 6 || cab.enlace >= c->n ||
+                (p[0] | p[1] << 8) != cab.enlace || seq < esperado[cab.enlace]) {
+                r[2]++;
+                continue;
+            }
+            r[0]++;
+            r[1] += seq != esperado[cab.enlace];
+            esperado[cab.enlace] = seq + 1;
+        }
+    }
+    if (write(res, r, sizeof(r)) < 0) _exit(1);
+    _exit(0);
+}
+
+static void sobe_limite_fd(void) {
+    struct rlimit l;
+    if (getrlimit(RLIMIT_NOFILE, &l) == 0 && l.rlim_cur < l.rlim_max) {
+        l.rlim_cur = l.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &l);
+    }
+}
+
+static double cpu_s(void) {
+    struct rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return u.ru_utime.tv_sec + u.ru_stime.tv_sec + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) * 1e-6;
+}
+
+static int bench(const Carga* c) {
+    static Gateway g;
+    char sock[64];
+    snprintf(sock, sizeof(sock), "/tmp/gateway-%d.sock", (int)getpid());
+    sobe_limite_fd();
+    if (!gw_init(&g, c->modo, sock)) {
+        perror(sock);
+        return 1;
+    }
+    int* mestre = malloc((size_t)c->n * sizeof(int));
+    for (int i = 0; i < c->n; i++) {
+        mestre[i] = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        int fd = -1;
+        if (mestre[i] >= 0 && grantpt(mestre[i]) == 0 && unlockpt(mestre[i]) == 0) {
+            fd = tty_abre(ptsname(mestre[i]), B0);
+        }
+        if (fd < 0 || !gw_adiciona(&g, fd)) {
+            fprintf(stderr, "pty %d: %s\n", i, strerror(errno));
+            return 1;
+        }
+    }
+
+    int p_res[2], p_pronto[2], p_fim[2];
+    if (pipe(p_res) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t pc = fork();
+    if (pc == 0) {
+        close(p_res[0]);
+        for (int i = 0; i < c->n; i++) close(mestre[i]);
+        consumidor(c, sock, p_res[1]);
+    }
+    close(p_res[1]);
+    char x;
+    while (g.ncons == 0) {  // espera o consumidor antes de gerar carga
+        gw_passo(&g, 100);
+        if (waitpid(pc, NULL, WNOHANG) == pc) {
+            fputs("consumidor nao conectou\n", stderr);
+            return 1;
+        }
+    }
+    if (read(p_res[0], &x, 1) != 1) return 1;
+
+    // depois do fork do consumidor, para ele nao herdar "fim"
+    if (pipe2(p_pronto, O_NONBLOCK) < 0 || pipe(p_fim) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    double t0 = agora(), c0 = cpu_s();
+    pid_t pg = fork();
+    if (pg == 0) {
+        close(p_pronto[0]);
+        close(p_fim[1]);
+        gerador(c, mestre, p_pronto[1], p_fim[0]);
+    }
+    close(p_pronto[1]);
+    close(p_fim[0]);
+    for (int i = 0; i < c->n; i++) close(mestre[i]);
+    free(mestre);
+
+    // ate chegar tudo, ou o gerador acabar e o enlace ficar 1 s quieto
+    uint64_t total = (uint64_t)c->n * c->quadros, bytes = 0;
+    double t_ultimo = t0, t_quieto = 0;
+    bool pronto = false;
+    while (g.ok + g.falhas < total) {
+        gw_passo(&g, 100);
+        double t = agora();
+        if (g.bytes != bytes) {
+            bytes = g.bytes;
+            t_ultimo = t_quieto = t;
+        }
+        if (!pronto && read(p_pronto[0], &x, 1) == 1) {
+            pronto = true;
+            t_quieto = t;
+        }
+        if (pronto && t - t_quieto > 1.0) break;
+    }
+    double seg = t_ultimo - t0, cpu = cpu_s() - c0;
+    gw_envia_lote(&g);
+    close(p_fim[1]);
+    waitpid(pg, NULL, 0);
+    uint64_t ok = g.ok, falhas = g.falhas, descartados = g.descartados, leituras = g.leituras;
+    gw_encerra(&g);  // fecha o socket: o consumidor termina e relata
+    uint64_t r[3] = {0, 0, 0};
+    if (read(p_res[0], r, sizeof(r)) != sizeof(r)) fputs("consumidor nao relatou\n", stderr);
+    waitpid(pc, NULL, 0);
+    unlink(sock);
+
+    if (seg <= 0) seg = 1e-9;
+    printf("%d enlaces, %u quadros de %u bytes cada, %s\n", c->n, c->quadros, c->tam,
+           c->ritmo > 0 ? "ritmo fixo" : "ritmo maximo");
+    if (c->ritmo > 0) printf("  ritmo pedido: %.0f quadros/s por enlace, %.0f no total\n", c->ritmo, c->ritmo * c->n);
+    printf("  gateway: %llu OK, %llu FAIL de %llu em %.3f s: %.0f quadros/s, %.2f MB/s, %.1f bytes/read()\n",
+           (unsigned long long)ok, (unsigned long long)falhas, (unsigned long long)total, seg, ok / seg,
+           bytes / seg / 1e6, leituras ? (double)bytes / leituras : 0.0);
+    printf("  consumidor: %llu recebidos, %llu lacunas, %llu invalidos; %llu descartados pelo gateway\n",
+           (unsigned long long)r[0], (unsigned long long)r[1], (unsigned long long)r[2],
+           (unsigned long long)descartados);
+    printf("  CPU do gateway: %.3f s (%.1f%% de um nucleo), %.0f ns/quadro\n", cpu, 100 * cpu / seg,
+           ok ? cpu * 1e9 / ok : 0.0);
+    // so com ritmo fixo: no maximo o gateway usa o que sobra do nucleo
+    if (c->ritmo > 0) printf("  por 1000 enlaces: %.2f%% de um nucleo\n", 100 * cpu / seg * 1000 / c->n);
+    return ok == total && r[0] == ok && r[1] == 0 && r[2] == 0 ? 0 : 2;
+}
+
+int main(int argc, char** argv) {
+    ChkModo modo = CHK_XOR;
+    speed_t baud = B0;
+    const char* sock = NULL;
+    const char* ouve = NULL;
+    Carga c = {0, 1000, 32, 0, CHK_XOR};
+    int opt;
+    bool uso = false;
+    while ((opt = getopt(argc, argv, "c:B:s:o:p:q:t:r:")) != -1) {
+        switch (opt) {
+            case 'c': uso |= !modo_de(optarg, &modo); break;
+            case 'B': baud = baud_de(atol(optarg)); uso |= baud == B0; break;
+            case 's': sock = optarg; break;
+            case 'o': ouve = optarg; break;
+            case 'p': c.n = atoi(optarg); break;
+            case 'q': c.quadros = (uint32_t)atol(optarg); break;
+            case 't': c.tam = (uint8_t)atoi(optarg); uso |= atoi(optarg) < 6 || atoi(optarg) > FRAME_MAX; break;
+            case 'r': c.ritmo = atof(optarg); break;
+            default: uso = true; break;
+        }
+    }
+    c.modo = modo;
+    if (!uso && ouve) return consome(ouve);
+    if (!uso && c.n > 0 && c.n <= UINT16_MAX) return bench(&c);
+    if (uso || !sock || optind == argc) {
+        fprintf(stderr,
+                "uso: %s [-c modo] [-B baud] -s socket tty...\n"
+                "     %s -o socket\n"
+                "     %s [-c modo] -p enlaces [-q quadros] [-t bytes] [-r quadros/s]\n",
+                argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    return serve(modo, baud, sock, &argv[optind], argc - optind);
+}
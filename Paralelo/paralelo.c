@@ -0,0 +1,391 @@
+/*
+ * paralelo.c
+ *
+ * Analise de capturas grandes (fluxo cru do enlace) em varios nucleos,
+ * com o mesmo resultado de rx_handle_bytes() de FSM.c rodando sozinho
+ * sobre o arquivo inteiro.
+ *
+ * A captura e dividida em trechos. Cada thread analisa o seu trecho com
+ * um FSM_Rx que comeca procurando SOF (especulativo: nao sabe se o trecho
+ * comeca no meio de um quadro) e guarda os eventos (OK/FAIL, offset do
+ * byte que encerrou o quadro, tamanho). Depois de cada evento o receptor
+ * volta a RX_WAIT_SOF: esses sao os pontos de sincronia do trecho.
+ *
+ * Costura, em ordem: o estado real no inicio do trecho e o estado final
+ * do trecho anterior. Se ele ja e RX_WAIT_SOF, os eventos especulativos
+ * valem todos. Senao, um receptor sequencial parte do estado real e anda
+ * de ponto de sincronia em ponto de sincronia ate tambem estar em
+ * RX_WAIT_SOF num deles: dali em diante os dois receptores estao no mesmo
+ * estado e o resto do trecho especulativo vale. Em geral basta terminar o
+ * quadro que cruzou a fronteira. Se nao convergir, o trecho todo fica com
+ * o sequencial (correto, so mais lento).
+ *
+ * Varios candidatos a SOF nao sao tentados um a um: a maquina de estados
+ * se ressincroniza sozinha, entao partir do inicio do trecho ja passa
+ * por todos eles e basta uma passada por trecho.
+ *
+ * Limites: sem ressincronizacao por retrocesso (rx_configura_ressinc): os
+ * quadros recuperados nao tem offset proprio e os pontos de sincronia
+ * deixam de ser garantidos.
+ *
+ * Memoria: os trechos andam em rodadas de "threads" trechos; so os
+ * eventos da rodada ficam na memoria. A captura e mapeada (mmap).
+ *
+ * Uso:
+ *  gcc -O2 -pthread Paralelo/paralelo.c -o paralelo
+ *  ./paralelo -g MiB captura.bin          gera uma captura sintetica
+ *  ./paralelo [opcoes] captura.bin        resumo (quadros, bytes, resumo hash)
+ * Opcoes:
+ *  -t N      threads (padrao: nucleos online)
+ *  -b KiB    tamanho do trecho (padrao 4096)
+ *  -c modo   xor | crc16 | crc32 (padrao xor)
+ *  -x        quadros estendidos habilitados
+ *  -l        lista os eventos: offset OK|FAIL tamanho
+ *  -s        confere com o receptor sequencial e mede os dois
+ *  -e        escala: 1, 2, 4, 8, 16 e 32 threads contra o sequencial
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FSM_SEM_MAIN
+#include "../FSM.c"
+
+typedef struct {
+    uint64_t fim;   // offset absoluto do byte que encerrou o quadro
+    uint32_t h;     // FNV-1a do payload (OK), calculado por quem analisou
+    uint16_t n;     // payload (OK)
+    uint8_t r;      // FrameResult
+} Evento;
+
+static Evento evento(uint64_t fim, FrameResult r, const uint8_t* dados, uint16_t n) {
+    Evento e = {fim, 2166136261u, 0, (uint8_t)r};
+    if (r != FRAME_OK) return e;
+    for (uint16_t i = 0; i < n; i++) e.h = (e.h ^ dados[i]) * 16777619u;
+    e.n = n;
+    return e;
+}
+
+typedef struct {
+    ChkModo modo;
+    bool ext;
+} Config;
+
+// Receptor com o seu buffer de quadros estendidos.
+typedef struct {
+    FSM_Rx rx;
+    uint8_t ext[FRAME_EXT_MAX];
+} Receptor;
+
+typedef struct {
+    const uint8_t* cap;
+    uint64_t ini, fim;
+    const Config* cfg;
+    Evento* ev;
+    size_t qtd, max;
+    Receptor r;     // estado especulativo ao fim do trecho
+} Trecho;
+
+// Consumidor dos eventos ja costurados, em ordem. Roda na thread da
+// costura: precisa ser leve (o payload ja chega resumido em e->h).
+typedef void (*EventoFn)(void* ctx, const uint8_t* cap, const Evento* e);
+
+static void receptor_init(Receptor* r, const Config* cfg) {
+    rx_reset(&r->rx);
+    rx_configura_chk(&r->rx, cfg->modo);
+    if (cfg->ext) rx_configura_ext(&r->rx, r->ext, FRAME_EXT_MAX);
+}
+
+// Copia estado e payload parcial; "ext" continua apontando para o destino.
+static void receptor_copia(Receptor* d, const Receptor* o) {
+    d->rx = o->rx;
+    if (o->rx.ext) {
+        d->rx.ext = d->ext;
+        if (o->rx.estendido) memcpy(d->ext, o->ext, o->rx.pos);
+    }
+}
+
+// ---------------- Analise de um trecho ----------------
+
+typedef struct {
+    Evento** ev;
+    size_t* qtd;
+    size_t* max;
+    uint64_t base;
+} Coleta;
+
+static void coleta_evento(void* ctx, FrameResult r, size_t offset,
+                          const uint8_t* dados, uint16_t n) {
+    Coleta* c = ctx;
+    if (*c->qtd == *c->max) {
+        *c->max = *c->max ? 2 * *c->max : 4096;
+        *c->ev = realloc(*c->ev, *c->max * sizeof(Evento));
+        if (!*c->ev) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    (*c->ev)[(*c->qtd)++] = evento(c->base + offset, r, dados, n);
+}
+
+static void* trecho_analisa(void* arg) {
+    Trecho* t = arg;
+    Coleta c = {&t->ev, &t->qtd, &t->max, t->ini};
+    t->qtd = 0;
+    receptor_init(&t->r, t->cfg);
+    rx_handle_bytes(&t->r.rx, &t->cap[t->ini], t->fim - t->ini, coleta_evento, &c);
+    return NULL;
+}
+
+// ---------------- Costura ----------------
+
+typedef struct {
+    EventoFn fn;
+    void* ctx;
+    const uint8_t* cap;
+    uint64_t base;
+} Entrega;
+
+static void entrega_evento(void* ctx, FrameResult r, size_t offset,
+                           const uint8_t* dados, uint16_t n) {
+    Entrega* e = ctx;
+    Evento ev = evento(e->base + offset, r, dados, n);
+    e->fn(e->ctx, e->cap, &ev);
+}
+
+// Entrega os eventos do trecho "t" partindo do estado real "seq", que
+// sai com o estado real ao fim do trecho. Retorna true se convergiu.
+static bool trecho_costura(Trecho* t, Receptor* seq, EventoFn fn, void* ctx) {
+    Entrega e = {fn, ctx, t->cap, 0};
+    uint64_t pos = t->ini;
+    size_t j = 0;
+    bool convergiu = seq->rx.estado == RX_WAIT_SOF;
+    for (; !convergiu && j < t->qtd; j++) {
+        uint64_t y = t->ev[j].fim + 1;  // especulativo em RX_WAIT_SOF aqui
+        e.base = pos;
+        rx_handle_bytes(&seq->rx, &t->cap[pos], y - pos, entrega_evento, &e);
+        pos = y;
+        convergiu = seq->rx.estado == RX_WAIT_SOF;
+    }
+    if (!convergiu) {
+        e.base = pos;
+        rx_handle_bytes(&seq->rx, &t->cap[pos], t->fim - pos, entrega_evento, &e);
+        return false;
+    }
+    for (; j < t->qtd; j++) fn(ctx, t->cap, &t->ev[j]);
+    receptor_copia(seq, &t->r);
+    return true;
+}
+
+// Analisa cap[0..n) com "threads" threads e trechos de "tam" bytes;
+// entrega os eventos em ordem. Retorna quantos trechos nao convergiram.
+static size_t analisa_paralelo(const uint8_t* cap, uint64_t n, const Config* cfg,
+                               int threads, uint64_t tam, EventoFn fn, void* ctx) {
+    Trecho* t = calloc((size_t)threads, sizeof(Trecho));
+    pthread_t* th = calloc((size_t)threads, sizeof(pthread_t));
+    static Receptor seq;
+    size_t divergentes = 0;
+    receptor_init(&seq, cfg);
+    for (uint64_t ini = 0; ini < n; ) {
+        int k = 0;
+        for (; k < threads && ini < n; k++, ini += tam) {
+            t[k].cap = cap;
+            t[k].cfg = cfg;
+            t[k].ini = ini;
+            t[k].fim = (n - ini < tam) ? n : ini + tam;
+            if (k > 0) pthread_create(&th[k], NULL, trecho_analisa, &t[k]);
+        }
+        // o 1o trecho da rodada ja parte do estado real: vai sequencial
+        // nesta thread enquanto as outras especulam
+        Entrega e = {fn, ctx, cap, t[0].ini};
+        rx_handle_bytes(&seq.rx, &cap[t[0].ini], t[0].fim - t[0].ini, entrega_evento, &e);
+        for (int i = 1; i < k; i++) {
+            pthread_join(th[i], NULL);
+            divergentes += !trecho_costura(&t[i], &seq, fn, ctx);
+        }
+    }
+    for (int i = 0; i < threads; i++) free(t[i].ev);
+    free(t);
+    free(th);
+    return divergentes;
+}
+
+// Referencia: um receptor, a captura inteira.
+static void analisa_sequencial(const uint8_t* cap, uint64_t n, const Config* cfg,
+                               EventoFn fn, void* ctx) {
+    static Receptor seq;
+    receptor_init(&seq, cfg);
+    Entrega e = {fn, ctx, cap, 0};
+    rx_handle_bytes(&seq.rx, cap, n, entrega_evento, &e);
+}
+
+// ---------------- Consumidores ----------------
+
+typedef struct {
+    uint64_t ok, falhas, bytes;
+    uint64_t resumo;    // soma de hashes por evento (posicao entra no hash)
+    bool lista;
+} Resumo;
+
+static uint64_t mistura(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static void resume_evento(void* ctx, const uint8_t* cap, const Evento* e) {
+    Resumo* s = ctx;
+    uint64_t h = mistura(e->fim * 4 + e->r);
+    (void)cap;
+    if (e->r == FRAME_OK) {
+        h = mistura(h ^ ((uint64_t)e->h << 16) ^ e->n);
+        s->ok++;
+        s->bytes += e->n;
+    } else {
+        s->falhas++;
+    }
+    s->resumo += h;
+    if (s->lista) printf("%llu %s %u\n", (unsigned long long)e->fim,
+                         e->r == FRAME_OK ? "OK" : "FAIL", e->n);
+}
+
+// ---------------- Captura sintetica ----------------
+
+// Quadros de 0..255 bytes (com -x, 1 em 16 estendido ate 2 KiB), lixo
+// entre eles e 1% de quadros com um byte trocado. Payload aleatorio: tem
+// SOF e EOF no meio, que e o caso dificil para a costura.
+static int gera(const char* nome, uint64_t mib, const Config* cfg) {
+    FILE* f = fopen(nome, "wb");
+    if (!f) {
+        perror(nome);
+        return 1;
+    }
+    static uint8_t payload[FRAME_EXT_MAX], quadro[FRAME_EXT_MAX + 8];
+    uint64_t escrito = 0, x = 88172645463325252ull;
+#define ALEAT() (x ^= x << 13, x ^= x >> 7, x ^= x << 17, x)
+    TxPacket tx;
+    while (escrito < (mib << 20)) {
+        uint64_t a = ALEAT();
+        uint16_t n = (cfg->ext && (a & 15) == 0) ? (uint16_t)(256 + (a >> 8) % 1793) : (uint16_t)((a >> 8) & 0xFF);
+        for (uint16_t i = 0; i < n; i++) payload[i] = (uint8_t)ALEAT();
+        size_t k = (n > FRAME_MAX) ? tx_compose_ext(&tx, payload, n, quadro, cfg->modo)
+                                   : tx_compose_chk(&tx, payload, (uint8_t)n, quadro, cfg->modo);
+        if ((a >> 24) % 100 == 0) quadro[(a >> 32) % k] ^= (uint8_t)(1 + (a >> 40) % 255);
+        size_t lixo = (a >> 48) % 9;
+        for (size_t i = 0; i < lixo; i++) fputc((uint8_t)ALEAT(), f);
+        fwrite(quadro, 1, k, f);
+        escrito += lixo + k;
+    }
+#undef ALEAT
+    fclose(f);
+    printf("%s: %llu bytes\n", nome, (unsigned long long)escrito);
+    return 0;
+}
+
+// ---------------- main ----------------
+
+static double agora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void relata(const char* nome, const Resumo* s, uint64_t n, double seg) {
+    printf("%-14s %10llu OK %8llu FAIL %12llu B payload  resumo %016llx  %8.1f MB/s\n",
+           nome, (unsigned long long)s->ok, (unsigned long long)s->falhas,
+           (unsigned long long)s->bytes, (unsigned long long)s->resumo, n / seg / 1e6);
+}
+
+int main(int argc, char** argv) {
+    Config cfg = {CHK_XOR, false};
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t tam = 4096u << 10, gera_mib = 0;
+    bool lista = false, confere = false, escala = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:b:c:xlseg:")) != -1) {
+        switch (opt) {
+            case 't': threads = atoi(optarg); break;
+            case 'b': tam = strtoull(optarg, NULL, 10) << 10; break;
+            case 'c':
+                cfg.modo = strcmp(optarg, "crc16") == 0 ? CHK_CRC16
+                         : strcmp(optarg, "crc32") == 0 ? CHK_CRC32 : CHK_XOR;
+                break;
+            case 'x': cfg.ext = true; break;
+            case 'l': lista = true; break;
+            case 's': confere = true; break;
+            case 'e': escala = true; break;
+            case 'g': gera_mib = strtoull(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "uso: %s [-t N] [-b KiB] [-c xor|crc16|crc32] [-x] [-l] [-s] [-e] captura\n"
+                                "     %s -g MiB [-c modo] [-x] captura\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || threads < 1 || tam == 0) {
+        fprintf(stderr, "%s: falta a captura (ou -t/-b invalido)\n", argv[0]);
+        return 1;
+    }
+    if (gera_mib) return gera(argv[optind], gera_mib, &cfg);
+
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    uint64_t n = (uint64_t)st.st_size;
+    const uint8_t* cap = n ? mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    if (n && cap == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (n) madvise((void*)cap, n, MADV_SEQUENTIAL);
+    crc_prepara();  // tabelas do CRC antes das threads
+
+    if (!confere && !escala) {
+        Resumo s = {0, 0, 0, 0, lista};
+        double t0 = agora();
+        size_t div = analisa_paralelo(cap, n, &cfg, threads, tam, resume_evento, &s);
+        double t1 = agora();
+        fflush(stdout);
+        fprintf(stderr, "%llu OK, %llu FAIL, %llu B de payload, resumo %016llx; %d threads, "
+                        "%.1f MB/s, %zu trechos sem convergencia\n",
+                (unsigned long long)s.ok, (unsigned long long)s.falhas, (unsigned long long)s.bytes,
+                (unsigned long long)s.resumo, threads, n / (t1 - t0) / 1e6, div);
+        return 0;
+    }
+
+    Resumo ref = {0, 0, 0, 0, false};
+    double t0 = agora();
+    analisa_sequencial(cap, n, &cfg, resume_evento, &ref);
+    double seq = agora() - t0;
+    relata("sequencial", &ref, n, seq);
+
+    int lista_t[] = {1, 2, 4, 8, 16, 32};
+    int qtd_t = escala ? 6 : 1;
+    if (!escala) lista_t[0] = threads;
+    int ret = 0;
+    for (int i = 0; i < qtd_t; i++) {
+        Resumo s = {0, 0, 0, 0, false};
+        t0 = agora();
+        size_t div = analisa_paralelo(cap, n, &cfg, lista_t[i], tam, resume_evento, &s);
+        double seg = agora() - t0;
+        char nome[32];
+        snprintf(nome, sizeof(nome), "%d threads", lista_t[i]);
+        relata(nome, &s, n, seg);
+        bool igual = s.ok == ref.ok && s.falhas == ref.falhas && s.bytes == ref.bytes && s.resumo == ref.resumo;
+        printf("%14s aceleracao %.2fx, %zu trechos sem convergencia%s\n", "", seq / seg, div,
+               igual ? "" : "  DIFERENTE DO SEQUENCIAL");
+        ret |= !igual;
+    }
+    return ret;
+}
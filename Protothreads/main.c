@@ -2,24 +2,51 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdatomic.h>
+#if !defined(__ARM_ARCH_6M__)
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+#include "../checksum.h"
+#include "../dialetos.h"
+#include "../fec.h"
 
 /* ===========================================================
    Mini-framework de testes (minUnit)
    =========================================================== */
 #define verifica(msg, cond) do { if(!(cond)) return msg; } while(0)
 #define executa_teste(fn) do { char* _m = fn(); total_testes++; if(_m) return _m; } while(0)
-static int total_testes = 0;
 
 /* ===========================================================
    Protocolo e utilidades
    =========================================================== */
-#define FRAME_SOF   0x02
-#define FRAME_EOF   0x03
+/* Interface do TX e do scheduler: quem inclui este arquivo com
+   FSM_SEM_MAIN pode usar só o RX */
+#if defined(__GNUC__)
+#define PT_API static __attribute__((unused))
+#else
+#define PT_API static
+#endif
+
+/* Dialeto "enlace" de dialetos.h (o mesmo de FSM.c) */
+#define FRAME_SOF   ESPEC_SOF(ESPEC_ENLACE)
+#define FRAME_EOF   ESPEC_EOF(ESPEC_ENLACE)
 #define FRAME_ACK   0x06
-#define FRAME_MAX   255
-
-static uint8_t xor_chk(const uint8_t* d, uint8_t n){
-    uint8_t c = 0; for(uint8_t i=0;i<n;i++) c ^= d[i]; return c;
+#define FRAME_MAX   ESPEC_MAX(ESPEC_ENLACE)
+/* Quadro estendido: SOF_EXT LEN_lo LEN_hi payload CHK EOF (LEN até 4 KiB).
+   O TX só o usa quando o payload não cabe em FRAME_MAX. */
+#define FRAME_SOF_EXT 0x01
+#define FRAME_EXT_MAX 4096
+/* Quadro com FEC (tx_set_fec): SOF_FEC, blocos Hamming SECDED de fec.h
+   (9 bytes no fio por 8 de corpo) e EOF. Corpo: LEN_lo LEN_hi payload CHK,
+   completado com zeros até fechar o bloco. O RX corrige cada bloco antes
+   de conferir o CHK e aceita o EOF com até 1 bit trocado. */
+#define FRAME_SOF_FEC 0x04
+
+static uint8_t xor_chk(const uint8_t* d, uint16_t n){
+    return chk_xor(d, n); /* kernels por palavra/SIMD em checksum.h */
 }
 
 /* ===========================================================
@@ -35,34 +62,101 @@ typedef struct { int lc; } pt_t;
 #define PT_INIT(pt)    do{ (pt)->lc=0; }while(0)
 
 /* ===========================================================
-   Canal simulado (fila circular não-bloqueante)
+   Canal simulado: fila SPSC sem trava
+   Um produtor (ISR da UART ou TX) e um consumidor (tarefa ou RX). Cada
+   lado só escreve o próprio índice (tail: produtor, head: consumidor);
+   não há contador compartilhado, então nenhum lado precisa mascarar
+   interrupções. No Cortex-M0+ load/store de 32 bits já são atômicos e
+   acquire/release viram DMB.
+   Índices só crescem (o estouro de 32 bits é inofensivo): ocupados =
+   tail - head, posição = índice % QCAP.
    =========================================================== */
-#define QCAP 512
+#define QCAP 512 /* potência de 2 */
 typedef struct {
     uint8_t buf[QCAP];
-    int h, t, sz;
+    _Atomic uint32_t head; /* próximo a ler; só o consumidor escreve */
+    _Atomic uint32_t tail; /* próximo a escrever; só o produtor escreve */
 } queue_t;
 
-static void q_init(queue_t* q){ q->h=q->t=q->sz=0; }
+#define Q_LE(x, ordem)     atomic_load_explicit(&(x), memory_order_##ordem)
+#define Q_GRAVA(x, v)      atomic_store_explicit(&(x), (v), memory_order_release)
+
+static void q_init(queue_t* q){
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+/* Do lado do produtor (q_free) ou do consumidor (q_size): o valor pode
+   mudar logo depois, mas só a favor de quem chamou. */
+static int  q_size(queue_t* q){ return (int)(Q_LE(q->tail, acquire) - Q_LE(q->head, acquire)); }
+static int  q_free(queue_t* q){ return QCAP - q_size(q); }
+
+/* --- Produtor: reserva/publica ---
+   q_reserve() dá o trecho contíguo livre; o produtor escreve nele (ou em
+   q_slot(q,0..n-1), que dá a volta) e q_commit() publica os n bytes de
+   uma vez. Nada do que foi escrito é visível antes do commit. */
+static int q_reserve(queue_t* q, uint8_t** p){
+    uint32_t t = Q_LE(q->tail, relaxed);
+    uint32_t livre = QCAP - (t - Q_LE(q->head, acquire));
+    uint32_t i = t % QCAP;
+    *p = &q->buf[i];
+    return (int)(livre < QCAP - i ? livre : QCAP - i);
+}
+static uint8_t* q_slot(queue_t* q, int off){ return &q->buf[(Q_LE(q->tail, relaxed)+(uint32_t)off)%QCAP]; }
+static void q_write_at(queue_t* q, int off, const uint8_t* d, int n){
+    int i = (int)((Q_LE(q->tail, relaxed)+(uint32_t)off)%QCAP), k = (n < QCAP-i) ? n : QCAP-i;
+    memcpy(&q->buf[i], d, (size_t)k);
+    memcpy(q->buf, d+k, (size_t)(n-k));
+}
+static void q_commit(queue_t* q, int n){ Q_GRAVA(q->tail, Q_LE(q->tail, relaxed) + (uint32_t)n); }
+
+/* --- Consumidor: olha/libera ---
+   q_peek() dá o trecho contíguo pronto; q_release() devolve os n
+   primeiros bytes ao produtor depois de usados. */
+static int q_peek(queue_t* q, const uint8_t** p){
+    uint32_t h = Q_LE(q->head, relaxed);
+    uint32_t n = Q_LE(q->tail, acquire) - h;
+    uint32_t i = h % QCAP;
+    *p = &q->buf[i];
+    return (int)(n < QCAP - i ? n : QCAP - i);
+}
+static void q_release(queue_t* q, int n){ Q_GRAVA(q->head, Q_LE(q->head, relaxed) + (uint32_t)n); }
+
+/* Um byte por vez, sobre os trechos */
 static bool q_push(queue_t* q, uint8_t b){
-    if(q->sz==QCAP) return false;
-    q->buf[q->t]=b; q->t=(q->t+1)%QCAP; q->sz++; return true;
+    uint8_t* p;
+    if(q_reserve(q, &p)==0) return false;
+    *p=b; q_commit(q, 1); return true;
 }
 static bool q_pop(queue_t* q, uint8_t* out){
-    if(q->sz==0) return false;
-    *out=q->buf[q->h]; q->h=(q->h+1)%QCAP; q->sz--; return true;
-}
-static bool q_peek(queue_t* q, uint8_t* out){
-    if(q->sz==0) return false; *out=q->buf[q->h]; return true;
+    const uint8_t* p;
+    if(q_peek(q, &p)==0) return false;
+    *out=*p; q_release(q, 1); return true;
 }
-static int  q_size(queue_t* q){ return q->sz; }
 
 /* Canais: dados (TX->RX) e controle/ACK (RX->TX) */
 static queue_t ch_data, ch_ctrl;
 
-/* “Camada física” simulada: TX escreve no canal de dados; RX lê. */
-static bool phy_send_byte(uint8_t b){ return q_push(&ch_data, b); }
-static bool phy_recv_byte(uint8_t* b){ return q_pop(&ch_data, b); }
+/* “Camada física” simulada: TX codifica quadros direto no canal de dados
+   (tx_encode_to_queue); RX lê byte a byte. Com g_ruido != 0 cada bit lido
+   é invertido com probabilidade g_ruido / 2^32 (BER do canal). O canal de
+   ACK fica limpo. */
+static uint32_t g_ruido = 0;
+static uint32_t g_sorteio = 2463534242u;
+
+static uint8_t phy_ruido(void){
+    uint8_t m = 0;
+    for(int i=0; i<8; i++){
+        g_sorteio ^= g_sorteio << 13; g_sorteio ^= g_sorteio >> 17; g_sorteio ^= g_sorteio << 5;
+        if(g_sorteio < g_ruido) m |= (uint8_t)(1u << i);
+    }
+    return m;
+}
+
+static bool phy_recv_byte(uint8_t* b){
+    if(!q_pop(&ch_data, b)) return false;
+    if(g_ruido) *b ^= phy_ruido();
+    return true;
+}
 /* Canal de retorno (ACK): RX → TX */
 static bool ctrl_send_ack(uint8_t b){ return q_push(&ch_ctrl, b); }
 static bool ctrl_recv_ack(uint8_t* b){ return q_pop(&ch_ctrl, b); }
@@ -75,26 +169,55 @@ typedef enum {
     RX_WAIT_LEN,
     RX_READ_DATA,
     RX_WAIT_CHK,
-    RX_WAIT_EOF
+    RX_WAIT_EOF,
+    RX_WAIT_LEN_EXT, /* 2 bytes, LSB primeiro; idx conta os bytes */
+    RX_FEC_BLOCO     /* quadro FEC: junta 9 bytes, corrige, consome o corpo */
 } rx_state_e;
 
 typedef struct {
     pt_t       pt;
     rx_state_e st;
-    uint8_t    len, idx, chk;
-    uint8_t    payload[FRAME_MAX];
+    uint16_t   len, idx;
+    uint8_t    chk;
+    bool       fec;        /* quadro em curso é FEC */
+    uint8_t    bloco[FEC_BLOCO];
+    uint8_t    bidx;
+    uint32_t   fec_corrigidos, fec_falhas;  /* blocos */
+    uint8_t    payload[FRAME_EXT_MAX];
 } rx_ctx_t;
 
 static void rx_init(rx_ctx_t* rx){
     PT_INIT(&rx->pt);
     rx->st = RX_WAIT_SOF;
     rx->len=0; rx->idx=0; rx->chk=0;
+    rx->fec=false; rx->bidx=0;
+    rx->fec_corrigidos=0; rx->fec_falhas=0;
     memset(rx->payload, 0, sizeof(rx->payload));
 }
 
+/* Consome os 8 bytes de um bloco FEC já corrigido; idx conta os bytes do
+   corpo. Retorna o próximo estado. */
+static rx_state_e rx_fec_corpo(rx_ctx_t* rx){
+    for(int k=0; k<FEC_DADOS; k++){
+        uint8_t b = rx->bloco[k];
+        uint16_t i = rx->idx++;
+        if(i < 2){
+            rx->len |= (uint16_t)(b << (8*i));
+            if(i == 1 && rx->len > FRAME_EXT_MAX) return RX_WAIT_SOF; /* proteção */
+        }else if(i < 2u + rx->len){
+            rx->payload[i-2] = b;
+            rx->chk ^= b;
+        }else{
+            /* CHK; o resto do bloco é enchimento */
+            return (b == rx->chk) ? RX_WAIT_EOF : RX_WAIT_SOF;
+        }
+    }
+    return RX_FEC_BLOCO;
+}
+
 /* Protothread receptora: consome bytes, valida, envia ACK ao final */
 static void rx_thread(rx_ctx_t* rx){
-    uint8_t b;
+    uint8_t b = 0;
     PT_BEGIN(&rx->pt);
 
     while(1){
@@ -102,10 +225,34 @@ static void rx_thread(rx_ctx_t* rx){
         PT_WAIT_UNTIL(&rx->pt, q_size(&ch_data) > 0);
         phy_recv_byte(&b);
 
-        switch(rx->st){
+        switch((int)rx->st){ /* int: os case do PT_YIELD também caem aqui */
             case RX_WAIT_SOF:
                 if(b==FRAME_SOF){ rx->st=RX_WAIT_LEN; rx->idx=0; rx->chk=0; }
+                else if(b==FRAME_SOF_EXT){ rx->st=RX_WAIT_LEN_EXT; rx->len=0; rx->idx=0; rx->chk=0; }
+                else if(b==FRAME_SOF_FEC){ rx->st=RX_FEC_BLOCO; rx->len=0; rx->idx=0; rx->chk=0; rx->bidx=0; }
                 /* lixo é ignorado */
+                rx->fec = (rx->st == RX_FEC_BLOCO);
+                break;
+
+            case RX_FEC_BLOCO:
+                rx->bloco[rx->bidx++] = b;
+                if(rx->bidx < FEC_BLOCO) break;
+                rx->bidx = 0;
+                switch(fec_decodifica(rx->bloco)){
+                    case FEC_FALHA: rx->fec_falhas++; rx->st = RX_WAIT_SOF; break;
+                    case FEC_CORRIGIDO: rx->fec_corrigidos++; /* fall through */
+                    default: rx->st = rx_fec_corpo(rx); break;
+                }
+                break;
+
+            case RX_WAIT_LEN_EXT:
+                rx->len |= (uint16_t)(b << (8*rx->idx));
+                if(++rx->idx < 2) break;
+                if(rx->len>FRAME_EXT_MAX){ rx->st=RX_WAIT_SOF; } /* proteção */
+                else{
+                    rx->idx=0;
+                    rx->st = (rx->len==0) ? RX_WAIT_CHK : RX_READ_DATA;
+                }
                 break;
 
             case RX_WAIT_LEN:
@@ -129,7 +276,8 @@ static void rx_thread(rx_ctx_t* rx){
                 break;
 
             case RX_WAIT_EOF:
-                if(b==FRAME_EOF){
+                /* com FEC, EOF com 1 bit trocado ainda fecha o quadro */
+                if(b==FRAME_EOF || (rx->fec && ((b ^ FRAME_EOF) & ((b ^ FRAME_EOF) - 1)) == 0)){
                     /* sucesso → envia ACK e volta ao início */
                     ctrl_send_ack(FRAME_ACK);
                 }
@@ -149,11 +297,7 @@ static void rx_thread(rx_ctx_t* rx){
    =========================================================== */
 typedef enum {
     TX_IDLE,
-    TX_SEND_SOF,
-    TX_SEND_LEN,
-    TX_SEND_DATA,
-    TX_SEND_CHK,
-    TX_SEND_EOF,
+    TX_SEND,      /* quadro codificado direto na fila (ver tx_encode_to_queue) */
     TX_WAIT_ACK,
     TX_DONE,
     TX_FAIL
@@ -163,10 +307,14 @@ typedef struct {
     pt_t       pt;
     tx_state_e st;
     const uint8_t* data;
-    uint8_t    len, idx, chk;
+    uint16_t   len;
+    int        sent;      /* bytes do quadro já publicados na fila */
+    int        need;      /* espaço livre que o TX espera na fila (0: nenhum) */
+    uint8_t    chk;
     int        retries;
     int        ack_deadline; /* “tick” limite para receber ACK */
     bool       inject_error_once; /* para testes de corrupção */
+    bool       fec;       /* envia quadros FEC (FRAME_SOF_FEC) */
 } tx_ctx_t;
 
 /* parâmetros de timeout/retransmissão */
@@ -176,28 +324,95 @@ typedef struct {
 /* tick global (simulado no laço do teste) */
 static int g_tick = 0;
 
-static void tx_init(tx_ctx_t* tx, const uint8_t* d, uint8_t n){
+PT_API void tx_init(tx_ctx_t* tx, const uint8_t* d, uint16_t n){
     PT_INIT(&tx->pt);
     tx->st = TX_IDLE;
     tx->data = d; tx->len = n;
-    tx->idx = 0; tx->chk = xor_chk(d,n);
+    tx->sent = 0; tx->need = 0; tx->chk = xor_chk(d,n);
     tx->retries = 0;
     tx->inject_error_once = false;
     tx->ack_deadline = 0;
+    tx->fec = false;
+}
+
+PT_API void tx_set_inject_error(tx_ctx_t* tx, bool once){ tx->inject_error_once = once; }
+PT_API void tx_set_fec(tx_ctx_t* tx, bool on){ tx->fec = on; }
+
+static int tx_header_len(const tx_ctx_t* tx){ return tx->len > FRAME_MAX ? 3 : 2; }
+static int tx_frame_len(const tx_ctx_t* tx){
+    if(tx->fec) return 1 + FEC_BLOCO * FEC_BLOCOS(tx->len + 3) + 1;
+    return tx_header_len(tx) + tx->len + 2;
 }
 
-static void tx_set_inject_error(tx_ctx_t* tx, bool once){ tx->inject_error_once = once; }
+/* Bytes [i, i+8) do corpo de um quadro FEC */
+static void tx_fec_corpo(const tx_ctx_t* tx, int i, uint8_t* d){
+    if(i >= 2 && i + FEC_DADOS <= 2 + tx->len){ memcpy(d, &tx->data[i-2], FEC_DADOS); return; }
+    for(int k=0; k<FEC_DADOS; k++, i++){
+        if(i < 2) d[k] = (uint8_t)(tx->len >> (8*i));
+        else if(i < 2 + tx->len) d[k] = tx->data[i-2];
+        else d[k] = (i == 2 + tx->len) ? tx->chk : 0;
+    }
+}
+
+/* tx_frame_bytes() do quadro FEC: só os blocos que tocam [ini, ini+n) são
+   codificados; o bloco cortado no começo ou no fim é codificado inteiro e
+   copiado em parte. */
+static void tx_frame_bytes_fec(tx_ctx_t* tx, queue_t* q, int ini, int n){
+    int fim = ini + n, total = tx_frame_len(tx);
+    uint8_t d[FEC_DADOS], bloco[FEC_BLOCO];
+    if(ini == 0) *q_slot(q, 0) = FRAME_SOF_FEC;
+    for(int off=1, corpo=0; off < fim && off < total-1; off += FEC_BLOCO, corpo += FEC_DADOS){
+        if(off + FEC_BLOCO <= ini) continue;
+        tx_fec_corpo(tx, corpo, d);
+        fec_codifica(d, bloco);
+        if(tx->inject_error_once && corpo == 0){
+            bloco[2] ^= 0x03; /* 2 bits no 1o byte de dados: detectado, não corrigido (teste) */
+            tx->inject_error_once = false;
+        }
+        for(int k=0; k<FEC_BLOCO; k++){
+            if(off+k >= ini && off+k < fim) *q_slot(q, off+k-ini) = bloco[k];
+        }
+    }
+    if(fim == total) *q_slot(q, total-1-ini) = FRAME_EOF;
+}
 
-/* envia um byte, com opção de corromper UM byte (teste) */
-static bool tx_phy_send_with_optional_corruption(tx_ctx_t* tx, uint8_t b){
-    if(tx->inject_error_once){
-        /* corrompe o primeiro byte de dados que sair */
-        if(tx->st==TX_SEND_DATA && tx->idx==0){
-            b ^= 0xFF; /* inverte bits pra forçar erro */
-            tx->inject_error_once = false; /* só uma vez */
+/* Escreve os bytes [ini, ini+n) do quadro no espaço livre da fila, sem
+   publicar. O payload vai em bloco; cabeçalho e rodapé byte a byte. */
+static void tx_frame_bytes(tx_ctx_t* tx, queue_t* q, int ini, int n){
+    if(tx->fec){ tx_frame_bytes_fec(tx, q, ini, n); return; }
+    const uint8_t hdr[3] = { tx->len > FRAME_MAX ? FRAME_SOF_EXT : FRAME_SOF,
+                             (uint8_t)tx->len, (uint8_t)(tx->len >> 8) };
+    const uint8_t ftr[2] = { tx->chk, FRAME_EOF };
+    int h = tx_header_len(tx), fim = ini + n;
+    for(int i=ini; i<fim; i++){
+        if(i < h) *q_slot(q, i-ini) = hdr[i];
+        else if(i >= h + tx->len) *q_slot(q, i-ini) = ftr[i - h - tx->len];
+        else{
+            int k = ((fim < h + tx->len) ? fim : h + tx->len) - i;
+            q_write_at(q, i-ini, &tx->data[i-h], k);
+            if(tx->inject_error_once && i == h){
+                *q_slot(q, i-ini) ^= 0xFF; /* corrompe o 1o byte de dados (teste) */
+                tx->inject_error_once = false; /* só uma vez */
+            }
+            i += k - 1;
         }
     }
-    return phy_send_byte(b);
+}
+
+/* Codifica o quadro direto na fila e o publica de uma vez. Sem espaço não
+   escreve nada: retorna false e *need recebe os bytes livres necessários.
+   Quadro maior que a fila inteira nunca caberia: vai em pedaços, cada um
+   com todo o espaço livre do momento. */
+static bool tx_encode_to_queue(tx_ctx_t* tx, queue_t* q, int* need){
+    int total = tx_frame_len(tx);
+    int n = total - tx->sent;
+    if(total > QCAP && n > q_free(q)) n = q_free(q);
+    *need = (total > QCAP) ? 1 : total;
+    if(n == 0 || n > q_free(q)) return false;
+    tx_frame_bytes(tx, q, tx->sent, n);
+    q_commit(q, n);
+    tx->sent += n;
+    return tx->sent == total;
 }
 
 /* Protothread transmissora */
@@ -206,38 +421,22 @@ static void tx_thread(tx_ctx_t* tx){
     PT_BEGIN(&tx->pt);
 
     while(1){
-        switch(tx->st){
+        switch((int)tx->st){
             case TX_IDLE:
-                tx->idx = 0;
+                tx->sent = 0;
                 tx->chk = xor_chk(tx->data, tx->len);
-                tx->st  = TX_SEND_SOF;
-                break;
-
-            case TX_SEND_SOF:
-                PT_WAIT_UNTIL(&tx->pt, tx_phy_send_with_optional_corruption(tx, FRAME_SOF));
-                tx->st = TX_SEND_LEN;
-                break;
-
-            case TX_SEND_LEN:
-                PT_WAIT_UNTIL(&tx->pt, tx_phy_send_with_optional_corruption(tx, tx->len));
-                tx->st = (tx->len==0) ? TX_SEND_CHK : TX_SEND_DATA;
-                break;
-
-            case TX_SEND_DATA:
-                PT_WAIT_UNTIL(&tx->pt, tx_phy_send_with_optional_corruption(tx, tx->data[tx->idx]));
-                tx->idx++;
-                if(tx->idx>=tx->len) tx->st=TX_SEND_CHK;
-                break;
-
-            case TX_SEND_CHK:
-                PT_WAIT_UNTIL(&tx->pt, tx_phy_send_with_optional_corruption(tx, tx->chk));
-                tx->st = TX_SEND_EOF;
+                tx->st  = TX_SEND;
                 break;
 
-            case TX_SEND_EOF:
-                PT_WAIT_UNTIL(&tx->pt, tx_phy_send_with_optional_corruption(tx, FRAME_EOF));
-                /* inicia espera por ACK */
-                tx->ack_deadline = g_tick + ACK_TIMEOUT_TICKS;
+            case TX_SEND:
+                /* fila cheia: tenta de novo no próximo passo (o PT_WAIT_UNTIL
+                   aqui dentro cairia num case do switch interno) */
+                if(!tx_encode_to_queue(tx, &ch_data, &tx->need)) break;
+                tx->need = 0;
+                /* inicia espera por ACK; o quadro publicado de uma vez ainda
+                   está na fila, então o prazo só conta depois que ela
+                   esvazia (1 byte por tick no canal simulado) */
+                tx->ack_deadline = g_tick + q_size(&ch_data) + ACK_TIMEOUT_TICKS;
                 tx->st = TX_WAIT_ACK;
                 break;
 
@@ -284,23 +483,28 @@ static void tx_thread(tx_ctx_t* tx){
 }
 
 /* Helpers de status para os testes */
-static bool tx_is_done(const tx_ctx_t* tx){ return tx->st==TX_DONE; }
-static bool tx_is_fail(const tx_ctx_t* tx){ return tx->st==TX_FAIL; }
-static int  tx_retry_count(const tx_ctx_t* tx){ return tx->retries; }
+PT_API bool tx_is_done(const tx_ctx_t* tx){ return tx->st==TX_DONE; }
+PT_API bool tx_is_fail(const tx_ctx_t* tx){ return tx->st==TX_FAIL; }
+PT_API int  tx_retry_count(const tx_ctx_t* tx){ return tx->retries; }
 
 /* ===========================================================
    “Scheduler” super simples para rodar as duas protothreads
    =========================================================== */
-static void scheduler_step(rx_ctx_t* rx, tx_ctx_t* tx){
+PT_API void scheduler_step(rx_ctx_t* rx, tx_ctx_t* tx){
     /* ordem: RX lê o que tiver, TX envia/espera ACK; ambos cooperam */
     rx_thread(rx);
     tx_thread(tx);
     g_tick++; /* passa o tempo */
 }
 
+/* FSM_SEM_MAIN: só as protothreads e o canal, para incluir em outro
+   programa (Captura/). */
+#ifndef FSM_SEM_MAIN
+
 /* ===========================================================
    TESTES
    =========================================================== */
+static int total_testes = 0;
 
 /* 1) Caminho feliz: sem corrupção, RX reconhece e manda ACK; TX conclui */
 static char* teste_ok_sem_retransmissao(void){
@@ -360,18 +564,388 @@ static char* teste_sem_ack_timeout_falha(void){
     return 0;
 }
 
+/* 4) Quadro estendido (> FRAME_MAX), maior que a fila do canal, com uma
+      retransmissão: o RX precisa receber o payload inteiro */
+static char* teste_quadro_estendido(void){
+    q_init(&ch_data); q_init(&ch_ctrl); g_tick = 0;
+    static rx_ctx_t rx; tx_ctx_t tx;
+    rx_init(&rx);
+    static uint8_t payload[1500];
+    for(int i=0; i<(int)sizeof(payload); i++) payload[i] = (uint8_t)(i*7);
+    tx_init(&tx, payload, sizeof(payload));
+    tx_set_inject_error(&tx, true);
+
+    for(int i=0; i<20000 && !tx_is_done(&tx) && !tx_is_fail(&tx); i++){
+        scheduler_step(&rx, &tx);
+    }
+
+    verifica("TX não concluiu o quadro estendido", tx_is_done(&tx));
+    verifica("Esperava 1 retransmissão (estendido)", tx_retry_count(&tx)==1);
+    verifica("RX: tamanho do estendido", rx.len == sizeof(payload));
+    verifica("RX: payload do estendido", memcmp(rx.payload, payload, sizeof(payload))==0);
+    return 0;
+}
+
+/* 5) Fila quase cheia: o quadro não cabe e nada é escrito (sem meio quadro
+      no canal); TX informa o espaço que precisa e publica tudo quando o RX
+      esvazia a fila */
+static char* teste_fila_cheia_sem_meio_quadro(void){
+    q_init(&ch_data); q_init(&ch_ctrl); g_tick = 0;
+    rx_ctx_t rx; tx_ctx_t tx;
+    rx_init(&rx);
+    const uint8_t payload[] = { 'A','B','C','D','E','F','G','H' };
+    tx_init(&tx, payload, sizeof(payload));
+
+    for(int i=0; i<QCAP-8; i++) q_push(&ch_data, 0x55); /* lixo: sobram 8 */
+    for(int i=0; i<10; i++){ tx_thread(&tx); g_tick++; }
+    verifica("TX escreveu quadro sem espaço", q_size(&ch_data)==QCAP-8);
+    verifica("TX deveria pedir 12 bytes livres", tx.need==12 && tx.st==TX_SEND);
+
+    for(int i=0; i<4000 && !tx_is_done(&tx) && !tx_is_fail(&tx); i++){
+        scheduler_step(&rx, &tx);
+    }
+    verifica("TX não concluiu após a fila esvaziar", tx_is_done(&tx));
+    verifica("RX: payload", rx.len==sizeof(payload) && memcmp(rx.payload, payload, sizeof(payload))==0);
+    return 0;
+}
+
+/* 7) Blocos SECDED de fec.h: todo erro de 1 bit é corrigido, todo par de
+      bits é detectado; no host, kernel de tabela == kernel de palavra */
+static char* teste_fec_blocos(void){
+    uint8_t d[FEC_DADOS], b[FEC_BLOCO], e[FEC_BLOCO];
+    uint32_t x = 12345u, erros = 0;
+    for(int n=0; n<200; n++){
+        for(int k=0; k<FEC_DADOS; k++){ x = x*1103515245u + 12345u; d[k] = (uint8_t)(x >> 16); }
+#if defined(FEC_PALAVRA)
+        erros += fec_verif_tabela(d) != fec_verif_palavra(d);
+#endif
+        fec_codifica(d, b);
+        memcpy(e, b, sizeof(e));
+        erros += fec_decodifica(e) != FEC_OK;
+        for(int i=0; i<8*FEC_BLOCO; i++){
+            memcpy(e, b, sizeof(e));
+            e[i>>3] ^= (uint8_t)(1u << (i&7));
+            erros += fec_decodifica(e) != FEC_CORRIGIDO || memcmp(e, d, FEC_DADOS) != 0;
+            for(int j=i+1; n<4 && j<8*FEC_BLOCO; j++){
+                uint8_t f[FEC_BLOCO];
+                memcpy(f, b, sizeof(f));
+                f[i>>3] ^= (uint8_t)(1u << (i&7));
+                f[j>>3] ^= (uint8_t)(1u << (j&7));
+                erros += fec_decodifica(f) != FEC_FALHA;
+            }
+        }
+    }
+    verifica("FEC: bloco mal corrigido ou erro duplo não detectado", erros == 0);
+    return 0;
+}
+
+/* 8) Quadro FEC com 1 bit trocado em cada bloco e no EOF: o RX corrige e
+      manda ACK sem retransmissão; 2 bits num bloco forçam a retransmissão */
+static char* teste_fec_sem_retransmissao(void){
+    q_init(&ch_data); q_init(&ch_ctrl); g_tick = 0;
+    rx_ctx_t rx; tx_ctx_t tx;
+    rx_init(&rx);
+    uint8_t payload[20];
+    for(int i=0; i<(int)sizeof(payload); i++) payload[i] = (uint8_t)(0xF0 ^ i);
+    tx_init(&tx, payload, sizeof(payload));
+    tx_set_fec(&tx, true);
+
+    tx_thread(&tx); tx_thread(&tx); /* publica o quadro */
+    const uint8_t* p;
+    int n = q_peek(&ch_data, &p);
+    verifica("FEC: tamanho do quadro", n == 1 + 3*FEC_BLOCO + 1 && p[0] == FRAME_SOF_FEC);
+    uint8_t* w = (uint8_t*)p;
+    for(int j=0; j<3; j++) w[1 + j*FEC_BLOCO + 3*j] ^= (uint8_t)(0x10 << j);
+    w[n-1] ^= 0x40;
+
+    for(int i=0; i<2000 && !tx_is_done(&tx) && !tx_is_fail(&tx); i++){
+        scheduler_step(&rx, &tx);
+    }
+    verifica("FEC: TX não concluiu", tx_is_done(&tx));
+    verifica("FEC: retransmissão indevida", tx_retry_count(&tx)==0);
+    verifica("FEC: blocos corrigidos", rx.fec_corrigidos==3 && rx.fec_falhas==0);
+    verifica("FEC: payload", rx.len==sizeof(payload) && memcmp(rx.payload, payload, sizeof(payload))==0);
+
+    rx_init(&rx);
+    tx_init(&tx, payload, sizeof(payload));
+    tx_set_fec(&tx, true);
+    tx_set_inject_error(&tx, true); /* 2 bits no 1o bloco */
+    for(int i=0; i<4000 && !tx_is_done(&tx) && !tx_is_fail(&tx); i++){
+        scheduler_step(&rx, &tx);
+    }
+    verifica("FEC: esperava 1 retransmissão", tx_is_done(&tx) && tx_retry_count(&tx)==1);
+    verifica("FEC: bloco perdido não contado", rx.fec_falhas==1);
+    return 0;
+}
+
+#if !defined(__ARM_ARCH_6M__)
+/* 6) Fila SPSC entre duas threads de verdade (host, compilar com -pthread):
+      o produtor alterna q_push e trechos de tamanhos variados; o
+      consumidor alterna q_pop e q_peek/q_release e confere a sequência */
+#define SPSC_BYTES (1u << 22)
+static queue_t spsc_q;
+
+static void* spsc_produtor(void* arg){
+    (void)arg;
+    uint32_t enviados = 0, tam = 1;
+    while(enviados < SPSC_BYTES){
+        uint8_t* p;
+        int n = q_reserve(&spsc_q, &p);
+        if(n == 0){ sched_yield(); continue; }
+        if(tam & 1){
+            q_push(&spsc_q, (uint8_t)enviados++);
+        }else{
+            if(n > (int)(tam % 300)) n = (int)(tam % 300) + 1;
+            if((uint32_t)n > SPSC_BYTES - enviados) n = (int)(SPSC_BYTES - enviados);
+            for(int i=0; i<n; i++) p[i] = (uint8_t)(enviados + (uint32_t)i);
+            q_commit(&spsc_q, n);
+            enviados += (uint32_t)n;
+        }
+        tam = tam * 1103515245u + 12345u;
+    }
+    return NULL;
+}
+
+static char* teste_spsc_threads(void){
+    pthread_t th;
+    q_init(&spsc_q);
+    verifica("pthread_create", pthread_create(&th, NULL, spsc_produtor, NULL) == 0);
+    uint32_t recebidos = 0, erros = 0;
+    while(recebidos < SPSC_BYTES){
+        const uint8_t* p;
+        int n = q_peek(&spsc_q, &p);
+        if(n == 0){ sched_yield(); continue; }
+        if(recebidos & 1){
+            uint8_t b;
+            q_pop(&spsc_q, &b);
+            erros += (b != (uint8_t)recebidos++);
+        }else{
+            for(int i=0; i<n; i++) erros += (p[i] != (uint8_t)(recebidos + (uint32_t)i));
+            q_release(&spsc_q, n);
+            recebidos += (uint32_t)n;
+        }
+    }
+    pthread_join(th, NULL);
+    verifica("SPSC: bytes fora de ordem ou corrompidos", erros == 0);
+    verifica("SPSC: sobrou byte na fila", q_size(&spsc_q) == 0);
+    return 0;
+}
+#endif
+
 /* Runner */
 static char* executa_todos_testes(void){
     executa_teste(teste_ok_sem_retransmissao);
     executa_teste(teste_corrupcao_uma_vez_reenvia);
     executa_teste(teste_sem_ack_timeout_falha);
+    executa_teste(teste_quadro_estendido);
+    executa_teste(teste_fila_cheia_sem_meio_quadro);
+#if !defined(__ARM_ARCH_6M__)
+    executa_teste(teste_spsc_threads);
+#endif
+    executa_teste(teste_fec_blocos);
+    executa_teste(teste_fec_sem_retransmissao);
     return 0;
 }
 
+#if !defined(__ARM_ARCH_6M__)
+/* ===========================================================
+   Benchmark: fila SPSC x fila antiga ("./main bench", host)
+   =========================================================== */
+
+/* Fila antiga, com o contador "sz" que os dois lados alteram. Entre ISR e
+   tarefa ela exige mascarar interrupções; aqui, entre threads, um mutex. */
+typedef struct {
+    uint8_t buf[QCAP];
+    int h, t, sz;
+} fila_sz_t;
+
+static bool fs_push(fila_sz_t* q, uint8_t b){
+    if(q->sz==QCAP) return false;
+    q->buf[q->t]=b; q->t=(q->t+1)%QCAP; q->sz++; return true;
+}
+static bool fs_pop(fila_sz_t* q, uint8_t* out){
+    if(q->sz==0) return false;
+    *out=q->buf[q->h]; q->h=(q->h+1)%QCAP; q->sz--; return true;
+}
+
+#define BENCH_BYTES (1u << 24)
+static fila_sz_t bench_fs;
+static pthread_mutex_t bench_mtx = PTHREAD_MUTEX_INITIALIZER;
+static queue_t bench_q;
+static volatile uint32_t bench_soma;
+
+static double bench_agora(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static void bench_relata(const char* nome, double seg){
+    printf("%-44s %8.1f MB/s %6.2f ns/byte\n", nome, BENCH_BYTES / seg / 1e6, seg * 1e9 / BENCH_BYTES);
+}
+
+static void* bench_prod_fs(void* arg){
+    (void)arg;
+    for(uint32_t i=0; i<BENCH_BYTES; ){
+        pthread_mutex_lock(&bench_mtx);
+        bool ok = fs_push(&bench_fs, (uint8_t)i);
+        pthread_mutex_unlock(&bench_mtx);
+        if(ok) i++; else sched_yield();
+    }
+    return NULL;
+}
+
+static void* bench_prod_byte(void* arg){
+    (void)arg;
+    for(uint32_t i=0; i<BENCH_BYTES; ){
+        if(q_push(&bench_q, (uint8_t)i)) i++; else sched_yield();
+    }
+    return NULL;
+}
+
+static void* bench_prod_trecho(void* arg){
+    (void)arg;
+    for(uint32_t i=0; i<BENCH_BYTES; ){
+        uint8_t* p;
+        int n = q_reserve(&bench_q, &p);
+        if(n == 0){ sched_yield(); continue; }
+        if((uint32_t)n > BENCH_BYTES - i) n = (int)(BENCH_BYTES - i);
+        memset(p, (uint8_t)i, (size_t)n);
+        q_commit(&bench_q, n);
+        i += (uint32_t)n;
+    }
+    return NULL;
+}
+
+static void bench_fila(void){
+    uint32_t soma = 0;
+    uint8_t b;
+    const uint8_t* p;
+
+    /* 1) mesma thread: enche 256 e esvazia 256 (sem disputa) */
+    memset(&bench_fs, 0, sizeof(bench_fs));
+    double t0 = bench_agora();
+    for(uint32_t i=0; i<BENCH_BYTES; i+=256){
+        for(int k=0; k<256; k++) fs_push(&bench_fs, (uint8_t)k);
+        for(int k=0; k<256; k++){ fs_pop(&bench_fs, &b); soma += b; }
+    }
+    bench_relata("1 thread: fila antiga push/pop", bench_agora() - t0);
+
+    q_init(&bench_q);
+    t0 = bench_agora();
+    for(uint32_t i=0; i<BENCH_BYTES; i+=256){
+        for(int k=0; k<256; k++) q_push(&bench_q, (uint8_t)k);
+        for(int k=0; k<256; k++){ q_pop(&bench_q, &b); soma += b; }
+    }
+    bench_relata("1 thread: SPSC q_push/q_pop", bench_agora() - t0);
+
+    /* 2) produtor e consumidor em threads diferentes */
+    pthread_t th;
+    memset(&bench_fs, 0, sizeof(bench_fs));
+    t0 = bench_agora();
+    pthread_create(&th, NULL, bench_prod_fs, NULL);
+    for(uint32_t i=0; i<BENCH_BYTES; ){
+        pthread_mutex_lock(&bench_mtx);
+        bool ok = fs_pop(&bench_fs, &b);
+        pthread_mutex_unlock(&bench_mtx);
+        if(ok){ soma += b; i++; } else sched_yield();
+    }
+    pthread_join(th, NULL);
+    bench_relata("2 threads: fila antiga + mutex", bench_agora() - t0);
+
+    q_init(&bench_q);
+    t0 = bench_agora();
+    pthread_create(&th, NULL, bench_prod_byte, NULL);
+    for(uint32_t i=0; i<BENCH_BYTES; ){
+        if(q_pop(&bench_q, &b)){ soma += b; i++; } else sched_yield();
+    }
+    pthread_join(th, NULL);
+    bench_relata("2 threads: SPSC q_push/q_pop", bench_agora() - t0);
+
+    q_init(&bench_q);
+    t0 = bench_agora();
+    pthread_create(&th, NULL, bench_prod_trecho, NULL);
+    for(uint32_t i=0; i<BENCH_BYTES; ){
+        int n = q_peek(&bench_q, &p);
+        if(n == 0){ sched_yield(); continue; }
+        soma += p[0] + p[n-1];
+        q_release(&bench_q, n);
+        i += (uint32_t)n;
+    }
+    pthread_join(th, NULL);
+    bench_relata("2 threads: SPSC reserve/commit/peek/release", bench_agora() - t0);
+    bench_soma = soma;
+}
+
+/* ===========================================================
+   Benchmark: FEC ("./main bench", host)
+   Kernels do byte de verificação e goodput x BER no canal simulado:
+   payload entregue por tick (1 tick = 1 byte no fio), com e sem FEC.
+   =========================================================== */
+#define BENCH_FEC_BLOCOS (1u << 20)
+#define BENCH_FEC_QUADROS 400
+#define BENCH_FEC_PAYLOAD 64
+
+static void bench_fec_kernel(const char* nome, uint8_t (*verif)(const uint8_t*)){
+    static uint8_t d[4096];
+    for(int i=0; i<(int)sizeof(d); i++) d[i] = (uint8_t)(i*131 + 7);
+    uint8_t s = 0;
+    double t0 = bench_agora();
+    for(uint32_t i=0; i<BENCH_FEC_BLOCOS; i++) s ^= verif(&d[(i * FEC_DADOS) & (sizeof(d)-1)]);
+    double seg = bench_agora() - t0;
+    bench_soma = s;
+    printf("  %-34s %7.1f MB/s de dados\n", nome, BENCH_FEC_BLOCOS * (double)FEC_DADOS / seg / 1e6);
+}
+
+static void bench_fec_canal(double ber, bool fec){
+    static rx_ctx_t rx;
+    tx_ctx_t tx;
+    uint8_t payload[BENCH_FEC_PAYLOAD];
+    uint32_t entregues = 0, retries = 0, corrigidos = 0;
+    for(int i=0; i<(int)sizeof(payload); i++) payload[i] = (uint8_t)(i*37);
+    g_ruido = (uint32_t)(ber * 4294967296.0);
+    g_tick = 0;
+    for(int n=0; n<BENCH_FEC_QUADROS; n++){
+        q_init(&ch_data); q_init(&ch_ctrl);
+        rx_init(&rx);
+        tx_init(&tx, payload, sizeof(payload));
+        tx_set_fec(&tx, fec);
+        while(!tx_is_done(&tx) && !tx_is_fail(&tx)) scheduler_step(&rx, &tx);
+        entregues += tx_is_done(&tx);
+        retries += (uint32_t)tx_retry_count(&tx);
+        corrigidos += rx.fec_corrigidos;
+    }
+    g_ruido = 0;
+    printf("  BER %-7g %-7s goodput %5.1f%%  entregues %3u/%u  retransmissoes %4u  blocos corrigidos %u\n",
+           ber, fec ? "FEC" : "sem FEC", 100.0 * entregues * BENCH_FEC_PAYLOAD / g_tick,
+           entregues, BENCH_FEC_QUADROS, retries, corrigidos);
+}
+
+static void bench_fec(void){
+    puts("FEC: byte de verificacao (8 bytes de dado por bloco)");
+    bench_fec_kernel("fec_verif_tabela (M0+)", fec_verif_tabela);
+#if defined(FEC_PALAVRA)
+    bench_fec_kernel("fec_verif_palavra (host)", fec_verif_palavra);
+#endif
+    printf("FEC: goodput x BER, %d quadros de %d bytes, ACK em canal limpo\n",
+           BENCH_FEC_QUADROS, BENCH_FEC_PAYLOAD);
+    const double bers[] = { 0, 1e-5, 1e-4, 1e-3, 3e-3, 1e-2 };
+    for(int i=0; i<(int)(sizeof(bers)/sizeof(bers[0])); i++){
+        bench_fec_canal(bers[i], false);
+        bench_fec_canal(bers[i], true);
+    }
+}
+#endif
+
 /* ===========================================================
    main
    =========================================================== */
-int main(void){
+int main(int argc, char** argv){
+#if !defined(__ARM_ARCH_6M__)
+    if(argc > 1 && strcmp(argv[1], "bench") == 0){ bench_fila(); bench_fec(); return 0; }
+#else
+    (void)argc; (void)argv;
+#endif
     char* msg = executa_todos_testes();
     puts("\n--- Resultado Final ---");
     if(msg){
@@ -382,3 +956,5 @@ int main(void){
     printf("Testes executados: %d\n", total_testes);
     return msg != NULL;
 }
+
+#endif /* FSM_SEM_MAIN */
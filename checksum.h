@@ -0,0 +1,271 @@
+/*
+ * checksum.h
+ *
+ * Checksum XOR dos quadros (FSM.c, Protothreads/main.c).
+ *
+ * Todas as variantes dao o mesmo resultado do laco byte a byte; mudam so
+ * a largura da dobra:
+ *  - chk_xor_byte:    referencia, um byte por vez
+ *  - chk_xor_palavra: palavras de 32 bits alinhadas (Cortex-M0+)
+ *  - chk_xor_sse2:    blocos de 16 bytes (host x86-64)
+ *  - chk_xor_avx2:    blocos de 32 bytes (host com -mavx2)
+ * Cabeca desalinhada e cauda menor que uma palavra/bloco vao byte a byte.
+ * chk_xor() escolhe a melhor variante disponivel em tempo de compilacao.
+ *
+ * Para enlaces com ruido em rajada o quadro pode usar CRC no lugar do XOR
+ * (ChkModo). Cada CRC tem duas implementacoes com o mesmo resultado:
+ *  - tabela de 16 entradas (nibble), poucos bytes de flash (SAMD21)
+ *  - slicing-by-8, 8 tabelas de 256 entradas geradas na 1a chamada (host)
+ * Com threads, chame crc_prepara() antes de cria-las: duas threads que
+ * fazem a 1a chamada juntas montariam as tabelas ao mesmo tempo.
+ * O registrador e atualizado de forma incremental (chk_inicia/atualiza/
+ * finaliza), entao o receptor calcula o CRC enquanto le o payload.
+ */
+
+#ifndef CHECKSUM_H_
+#define CHECKSUM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__)
+typedef uint32_t __attribute__((may_alias)) chk_u32_t;
+#define CHK_LE_U32(p) (*(const chk_u32_t*)(p))
+#else
+static inline uint32_t chk_le_u32(const uint8_t* p) { uint32_t w; memcpy(&w, p, 4); return w; }
+#define CHK_LE_U32(p) chk_le_u32(p)
+#endif
+
+static inline uint8_t chk_xor_byte(const uint8_t* d, size_t n) {
+    uint8_t c = 0;
+    while (n--) c ^= *d++;
+    return c;
+}
+
+/* reduz uma palavra de 32 bits ao XOR dos seus 4 bytes */
+static inline uint8_t chk_dobra_u32(uint32_t w) {
+    w ^= w >> 16;
+    w ^= w >> 8;
+    return (uint8_t)w;
+}
+
+static inline uint8_t chk_xor_palavra(const uint8_t* d, size_t n) {
+    uint8_t c = 0;
+    uint32_t w = 0;
+
+    for (; n && ((uintptr_t)d & 3u); n--) c ^= *d++;    /* cabeca */
+    for (; n >= 16; d += 16, n -= 16) {                  /* 4 palavras por volta */
+        w ^= CHK_LE_U32(d) ^ CHK_LE_U32(d + 4) ^ CHK_LE_U32(d + 8) ^ CHK_LE_U32(d + 12);
+    }
+    for (; n >= 4; d += 4, n -= 4) w ^= CHK_LE_U32(d);
+    return c ^ chk_dobra_u32(w) ^ chk_xor_byte(d, n);  /* cauda */
+}
+
+/* bytes ate o proximo endereco multiplo de "al" (limitado a n) */
+static inline size_t chk_cabeca(const uint8_t* d, size_t n, uintptr_t al) {
+    size_t k = (size_t)((al - ((uintptr_t)d & (al - 1))) & (al - 1));
+    return (k < n) ? k : n;
+}
+
+#if defined(__SSE2__)
+static inline uint8_t chk_xor_sse2(const uint8_t* d, size_t n) {
+    if (n < 32) return chk_xor_palavra(d, n);
+
+    size_t k = chk_cabeca(d, n, 16);
+    uint8_t c = chk_xor_palavra(d, k);
+    __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+
+    for (d += k, n -= k; n >= 32; d += 32, n -= 32) {
+        a0 = _mm_xor_si128(a0, _mm_load_si128((const __m128i*)d));
+        a1 = _mm_xor_si128(a1, _mm_load_si128((const __m128i*)(d + 16)));
+    }
+    a0 = _mm_xor_si128(a0, a1);
+    a0 = _mm_xor_si128(a0, _mm_srli_si128(a0, 8));
+    a0 = _mm_xor_si128(a0, _mm_srli_si128(a0, 4));
+    return c ^ chk_dobra_u32((uint32_t)_mm_cvtsi128_si32(a0)) ^ chk_xor_palavra(d, n);
+}
+#endif
+
+#if defined(__AVX2__)
+static inline uint8_t chk_xor_avx2(const uint8_t* d, size_t n) {
+    if (n < 64) return chk_xor_sse2(d, n);
+
+    size_t k = chk_cabeca(d, n, 32);
+    uint8_t c = chk_xor_palavra(d, k);
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+
+    for (d += k, n -= k; n >= 64; d += 64, n -= 64) {
+        a0 = _mm256_xor_si256(a0, _mm256_load_si256((const __m256i*)d));
+        a1 = _mm256_xor_si256(a1, _mm256_load_si256((const __m256i*)(d + 32)));
+    }
+    a0 = _mm256_xor_si256(a0, a1);
+    __m128i x = _mm_xor_si128(_mm256_castsi256_si128(a0), _mm256_extracti128_si256(a0, 1));
+    x = _mm_xor_si128(x, _mm_srli_si128(x, 8));
+    x = _mm_xor_si128(x, _mm_srli_si128(x, 4));
+    return c ^ chk_dobra_u32((uint32_t)_mm_cvtsi128_si32(x)) ^ chk_xor_sse2(d, n);
+}
+#endif
+
+static inline uint8_t chk_xor(const uint8_t* d, size_t n) {
+    if (n < 8) return chk_xor_byte(d, n); /* curto: a cabeca/cauda domina */
+#if defined(__AVX2__)
+    return chk_xor_avx2(d, n);
+#elif defined(__SSE2__)
+    return chk_xor_sse2(d, n);
+#else
+    return chk_xor_palavra(d, n);
+#endif
+}
+
+/* ---------------- CRC ---------------- */
+
+/* slicing-by-8 ocupa 12 KB de RAM: desligado por padrao no Cortex-M0+ */
+#ifndef CRC_SLICING8
+#if defined(__ARM_ARCH_6M__)
+#define CRC_SLICING8 0
+#else
+#define CRC_SLICING8 1
+#endif
+#endif
+
+/* CRC-16/CCITT-FALSE: polinomio 0x1021, inicial 0xFFFF, sem reflexao */
+#define CRC16_INICIAL 0xFFFFu
+/* CRC-32 (IEEE 802.3): polinomio 0xEDB88320 refletido, inicial e xorout 0xFFFFFFFF */
+#define CRC32_INICIAL 0xFFFFFFFFu
+
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static const uint32_t crc32_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static inline uint16_t crc16_atualiza_nibble(uint16_t crc, const uint8_t* d, size_t n) {
+    while (n--) {
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[(crc >> 12) ^ (*d >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[(crc >> 12) ^ (*d++ & 0x0Fu)]);
+    }
+    return crc;
+}
+
+static inline uint32_t crc32_atualiza_nibble(uint32_t crc, const uint8_t* d, size_t n) {
+    while (n--) {
+        crc ^= *d++;
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0Fu];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0Fu];
+    }
+    return crc;
+}
+
+#if CRC_SLICING8
+static uint16_t crc16_t8[8][256];
+static uint32_t crc32_t8[8][256];
+static int crc_t8_pronta;
+
+static inline void crc_t8_gera(void) {
+    for (unsigned i = 0; i < 256; i++) {
+        uint8_t b = (uint8_t)i;
+        crc16_t8[0][i] = crc16_atualiza_nibble(0, &b, 1);
+        crc32_t8[0][i] = crc32_atualiza_nibble(0, &b, 1);
+    }
+    for (unsigned k = 1; k < 8; k++) {
+        for (unsigned i = 0; i < 256; i++) {
+            uint16_t c16 = crc16_t8[k - 1][i];
+            uint32_t c32 = crc32_t8[k - 1][i];
+            crc16_t8[k][i] = (uint16_t)((c16 << 8) ^ crc16_t8[0][c16 >> 8]);
+            crc32_t8[k][i] = (c32 >> 8) ^ crc32_t8[0][c32 & 0xFFu];
+        }
+    }
+    __atomic_store_n(&crc_t8_pronta, 1, __ATOMIC_RELEASE);
+}
+
+static inline int crc_t8_montada(void) {
+    return __atomic_load_n(&crc_t8_pronta, __ATOMIC_ACQUIRE);
+}
+
+static inline uint16_t crc16_atualiza_t8(uint16_t crc, const uint8_t* d, size_t n) {
+    if (!crc_t8_montada()) crc_t8_gera();
+    for (; n >= 8; d += 8, n -= 8) {
+        crc = crc16_t8[7][d[0] ^ (crc >> 8)] ^ crc16_t8[6][d[1] ^ (crc & 0xFFu)] ^
+              crc16_t8[5][d[2]] ^ crc16_t8[4][d[3]] ^ crc16_t8[3][d[4]] ^
+              crc16_t8[2][d[5]] ^ crc16_t8[1][d[6]] ^ crc16_t8[0][d[7]];
+    }
+    while (n--) crc = (uint16_t)((crc << 8) ^ crc16_t8[0][(crc >> 8) ^ *d++]);
+    return crc;
+}
+
+static inline uint32_t crc32_atualiza_t8(uint32_t crc, const uint8_t* d, size_t n) {
+    if (!crc_t8_montada()) crc_t8_gera();
+    for (; n >= 8; d += 8, n -= 8) {
+        uint32_t a = crc ^ ((uint32_t)d[0] | (uint32_t)d[1] << 8 | (uint32_t)d[2] << 16 | (uint32_t)d[3] << 24);
+        uint32_t b = (uint32_t)d[4] | (uint32_t)d[5] << 8 | (uint32_t)d[6] << 16 | (uint32_t)d[7] << 24;
+        crc = crc32_t8[7][a & 0xFFu] ^ crc32_t8[6][(a >> 8) & 0xFFu] ^
+              crc32_t8[5][(a >> 16) & 0xFFu] ^ crc32_t8[4][a >> 24] ^
+              crc32_t8[3][b & 0xFFu] ^ crc32_t8[2][(b >> 8) & 0xFFu] ^
+              crc32_t8[1][(b >> 16) & 0xFFu] ^ crc32_t8[0][b >> 24];
+    }
+    while (n--) crc = (crc >> 8) ^ crc32_t8[0][(crc ^ *d++) & 0xFFu];
+    return crc;
+}
+
+#define crc16_atualiza crc16_atualiza_t8
+#define crc32_atualiza crc32_atualiza_t8
+#else
+#define crc16_atualiza crc16_atualiza_nibble
+#define crc32_atualiza crc32_atualiza_nibble
+#endif
+
+/* Monta as tabelas do slicing-by-8 agora (antes de criar threads) */
+static inline void crc_prepara(void) {
+#if CRC_SLICING8
+    if (!crc_t8_montada()) crc_t8_gera();
+#endif
+}
+
+/* ---------------- Integridade do quadro ---------------- */
+
+/* Campo CHK do quadro: 1 byte (XOR), 2 (CRC-16) ou 4 (CRC-32), LSB primeiro */
+typedef enum {
+    CHK_XOR,
+    CHK_CRC16,
+    CHK_CRC32
+} ChkModo;
+
+static inline uint8_t chk_bytes(ChkModo m) {
+    return (m == CHK_XOR) ? 1 : (m == CHK_CRC16) ? 2 : 4;
+}
+
+static inline uint32_t chk_inicia(ChkModo m) {
+    return (m == CHK_XOR) ? 0 : (m == CHK_CRC16) ? CRC16_INICIAL : CRC32_INICIAL;
+}
+
+static inline uint32_t chk_atualiza(ChkModo m, uint32_t c, const uint8_t* d, size_t n) {
+    switch (m) {
+        case CHK_CRC16: return crc16_atualiza((uint16_t)c, d, n);
+        case CHK_CRC32: return crc32_atualiza(c, d, n);
+        default:        return c ^ chk_xor(d, n);
+    }
+}
+
+/* Um byte por vez (receptores byte a byte): o XOR fica fora do caminho do
+ * CRC e nao depende de chk_atualiza() ser expandida no chamador */
+static inline uint32_t chk_atualiza_byte(ChkModo m, uint32_t c, uint8_t b) {
+    if (m == CHK_XOR) return c ^ b;
+    return chk_atualiza(m, c, &b, 1);
+}
+
+static inline uint32_t chk_finaliza(ChkModo m, uint32_t c) {
+    return (m == CHK_CRC32) ? ~c : c;
+}
+
+#endif /* CHECKSUM_H_ */
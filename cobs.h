@@ -0,0 +1,149 @@
+/*
+ * cobs.h
+ *
+ * COBS (Consistent Overhead Byte Stuffing) para o modo de enquadramento
+ * com delimitador 0x00 (FSM.c). O quadro codificado nunca contem 0x00,
+ * entao a fronteira entre quadros e achada procurando o proximo zero, sem
+ * passar cada byte pela maquina de estados.
+ *
+ * Busca do zero, todas com o mesmo resultado (indice do 1o zero ou n):
+ *  - cobs_zero_byte:    referencia, um byte por vez
+ *  - cobs_zero_palavra: palavras de 32 bits alinhadas (Cortex-M0+)
+ *  - cobs_zero_sse2:    blocos de 16 bytes (host x86-64)
+ * cobs_busca_zero() escolhe a melhor variante em tempo de compilacao.
+ *
+ * Codificacao: blocos de ate 254 bytes nao nulos precedidos de um byte de
+ * codigo (tamanho do bloco + 1). Pior caso: n + n/254 + 1 bytes.
+ */
+
+#ifndef COBS_H_
+#define COBS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "checksum.h"   /* CHK_LE_U32, chk_cabeca e intrinsics */
+
+#define COBS_MAX(n) ((n) + (n) / 254 + 1)
+
+static inline size_t cobs_zero_byte(const uint8_t* d, size_t n) {
+    size_t i = 0;
+    while (i < n && d[i] != 0) i++;
+    return i;
+}
+
+/* algum byte de w e zero? (exato para achar o 1o zero da palavra) */
+#define COBS_TEM_ZERO(w) (((w) - 0x01010101u) & ~(w) & 0x80808080u)
+
+static inline size_t cobs_zero_palavra(const uint8_t* d, size_t n) {
+    size_t k = chk_cabeca(d, n, 4);
+    size_t i = cobs_zero_byte(d, k);
+    if (i < k) return i;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t w = CHK_LE_U32(&d[i]);
+        if (COBS_TEM_ZERO(w)) break;
+    }
+    return i + cobs_zero_byte(&d[i], n - i);
+}
+
+#if defined(__SSE2__)
+static inline size_t cobs_zero_sse2(const uint8_t* d, size_t n) {
+    if (n < 32) return cobs_zero_palavra(d, n);
+
+    size_t k = chk_cabeca(d, n, 16);
+    size_t i = cobs_zero_byte(d, k);
+    if (i < k) return i;
+    const __m128i z = _mm_setzero_si128();
+    for (; i + 64 <= n; i += 64) {  /* 4 blocos por desvio */
+        __m128i a = _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)&d[i]), z);
+        __m128i b = _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)&d[i + 16]), z);
+        __m128i c = _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)&d[i + 32]), z);
+        __m128i e = _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)&d[i + 48]), z);
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, e)))) break;
+    }
+    for (; i + 16 <= n; i += 16) {
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)&d[i]), z));
+        if (m) return i + (size_t)__builtin_ctz((unsigned)m);
+    }
+    return i + cobs_zero_byte(&d[i], n - i);
+}
+#endif
+
+static inline size_t cobs_busca_zero(const uint8_t* d, size_t n) {
+#if defined(__SSE2__)
+    return cobs_zero_sse2(d, n);
+#else
+    return cobs_zero_palavra(d, n);
+#endif
+}
+
+/* Codificador incremental: o quadro pode vir em varios pedacos (payload e
+   CHK, por exemplo). "out" precisa de COBS_MAX(total) bytes. */
+typedef struct {
+    uint8_t* out;
+    size_t cod;   /* posicao do byte de codigo do bloco aberto */
+    size_t o;     /* proxima posicao livre */
+} CobsEnc;
+
+static inline void cobs_enc_inicia(CobsEnc* e, uint8_t* out) {
+    e->out = out;
+    e->cod = 0;
+    e->o = 1;
+}
+
+static inline void cobs_enc_bytes(CobsEnc* e, const uint8_t* d, size_t n) {
+    while (n) {
+        size_t cabe = 0xFF - (e->o - e->cod);   /* nao nulos que ainda cabem */
+        size_t k = cobs_busca_zero(d, n < cabe ? n : cabe);
+        memcpy(&e->out[e->o], d, k);
+        e->o += k;
+        d += k;
+        n -= k;
+        if (k == cabe) {            /* bloco cheio, sem zero implicito */
+            e->out[e->cod] = 0xFF;
+            e->cod = e->o++;
+        } else if (n) {             /* d[0] == 0: fecha o bloco no zero */
+            e->out[e->cod] = (uint8_t)(e->o - e->cod);
+            e->cod = e->o++;
+            d++;
+            n--;
+        }
+    }
+}
+
+/* Fecha o ultimo bloco. Retorna o tamanho codificado (sem delimitador). */
+static inline size_t cobs_enc_fim(CobsEnc* e) {
+    e->out[e->cod] = (uint8_t)(e->o - e->cod);
+    return e->o;
+}
+
+static inline size_t cobs_codifica(const uint8_t* in, size_t n, uint8_t* out) {
+    CobsEnc e;
+    cobs_enc_inicia(&e, out);
+    cobs_enc_bytes(&e, in, n);
+    return cobs_enc_fim(&e);
+}
+
+/* Decodifica "n" bytes (sem o delimitador) em uma passada. Falha com byte
+   de codigo zero, bloco truncado ou saida maior que "cap". */
+static inline bool cobs_decodifica(const uint8_t* in, size_t n, uint8_t* out,
+                                   size_t cap, size_t* out_n) {
+    size_t i = 0, o = 0;
+    while (i < n) {
+        size_t cod = in[i++];
+        if (cod == 0 || cod - 1 > n - i || o + cod - 1 > cap) return false;
+        memcpy(&out[o], &in[i], cod - 1);
+        o += cod - 1;
+        i += cod - 1;
+        if (cod != 0xFF && i < n) {
+            if (o == cap) return false;
+            out[o++] = 0;
+        }
+    }
+    *out_n = o;
+    return true;
+}
+
+#endif /* COBS_H_ */
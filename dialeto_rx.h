@@ -0,0 +1,211 @@
+/*
+ * dialeto_rx.h
+ *
+ * Receptor e transmissor de um dialeto de enquadramento (dialetos.h),
+ * instanciados por inclusao. Cada inclusao gera um tipo de porta e as
+ * funcoes dele com o nome do dialeto como prefixo:
+ *
+ *   #define DIALETO ESPEC_RADIO
+ *   #include "dialeto_rx.h"
+ *      -> radio_Porta, radio_reset(), radio_byte(), radio_bytes(),
+ *         radio_compose()
+ *
+ * SOF, EOF, LEN maximo e CHK entram como constantes: o switch do estado,
+ * chk_atualiza() e o laco do CHK se reduzem ao codigo daquele dialeto, sem
+ * consulta a descritor no caminho do byte.
+ *
+ * Sem DIALETO, gera a variante parametrizada em tempo de execucao, com o
+ * mesmo codigo lendo um RxEspec pela porta (p->e):
+ *
+ *   #define DIALETO_NOME generico
+ *   #define DIALETO_BUF  255      // maior payload entre os dialetos usados
+ *   #include "dialeto_rx.h"
+ *      -> generico_Porta, generico_configura(p, &espec), ...
+ *
+ * Precisa de checksum.h e, antes da inclusao, de RxState, FrameResult e
+ * RxQuadroFn (FSM.c). So quadros curtos (LEN de um byte); o payload fica
+ * valido na porta ate o proximo SOF.
+ */
+
+#ifndef DIALETO_RX_H_
+#define DIALETO_RX_H_
+
+#include "dialetos.h"
+
+typedef struct {
+    uint8_t sof, eof;
+    uint16_t max;           // LEN maximo
+    ChkModo modo;
+    bool chk_len;           // CHK cobre o byte de LEN
+} RxEspec;
+
+#define D_CAT_(a, b) a##_##b
+#define D_CAT(a, b)  D_CAT_(a, b)
+
+#endif /* DIALETO_RX_H_ */
+
+#if defined(DIALETO)
+#define D_NOME    ESPEC_NOME(DIALETO)
+#define D_SOF     ESPEC_SOF(DIALETO)
+#define D_EOF     ESPEC_EOF(DIALETO)
+#define D_MAX     ESPEC_MAX(DIALETO)
+#define D_CHK     ESPEC_CHK(DIALETO)
+#define D_CHK_LEN ESPEC_CHK_LEN(DIALETO)
+#define D_BUF     ESPEC_MAX(DIALETO)
+#if ESPEC_MAX(DIALETO) >= 255
+#define D_EXCEDE(n) 0           // LEN de um byte nunca passa do maximo
+#else
+#define D_EXCEDE(n) ((n) > D_MAX)
+#endif
+#else
+#define D_NOME    DIALETO_NOME
+#define D_SOF     (p->e->sof)
+#define D_EOF     (p->e->eof)
+#define D_MAX     (p->e->max)
+#define D_CHK     (p->e->modo)
+#define D_CHK_LEN (p->e->chk_len)
+#define D_BUF     DIALETO_BUF
+#define D_EXCEDE(n) ((n) > D_MAX)
+#endif
+
+#define D_(s) D_CAT(D_NOME, s)
+
+typedef struct {
+#if !defined(DIALETO)
+    const RxEspec* e;
+#endif
+    RxState estado;
+    uint16_t pos, tamanho;
+    uint32_t calc_chk;
+    uint8_t chk_idx;
+    uint8_t buf[D_BUF];
+} D_(Porta);
+
+static inline void D_(reset)(D_(Porta)* p) {
+    p->estado = RX_WAIT_SOF;
+    p->pos = 0;
+    p->tamanho = 0;
+    p->calc_chk = 0;
+    p->chk_idx = 0;
+}
+
+#if !defined(DIALETO)
+static inline void D_(configura)(D_(Porta)* p, const RxEspec* e) {
+    p->e = e;
+    D_(reset)(p);
+}
+#endif
+
+// Um byte no CHK; o XOR de um byte nao passa pelo kernel de bloco
+static inline uint32_t D_(chk_byte)(const D_(Porta)* p, uint32_t c, uint8_t b) {
+    (void)p;
+    return (D_CHK == CHK_XOR) ? c ^ b : chk_atualiza(D_CHK, c, &b, 1);
+}
+
+static inline FrameResult D_(byte)(D_(Porta)* p, uint8_t b) {
+    switch (p->estado) {
+        case RX_WAIT_SOF:
+            if (b == D_SOF) p->estado = RX_WAIT_LEN;
+            break;
+
+        case RX_WAIT_LEN:
+            if (D_EXCEDE(b)) {
+                D_(reset)(p);
+                return FRAME_FAIL;
+            }
+            p->tamanho = b;
+            p->pos = 0;
+            p->chk_idx = 0;
+            p->calc_chk = chk_inicia(D_CHK);
+            if (D_CHK_LEN) p->calc_chk = D_(chk_byte)(p, p->calc_chk, b);
+            p->estado = (b == 0) ? RX_WAIT_CHK : RX_READ_DATA;
+            break;
+
+        case RX_READ_DATA:
+            p->buf[p->pos++] = b;
+            p->calc_chk = D_(chk_byte)(p, p->calc_chk, b);
+            if (p->pos == p->tamanho) p->estado = RX_WAIT_CHK;
+            break;
+
+        case RX_WAIT_CHK: {
+            uint32_t esperado = chk_finaliza(D_CHK, p->calc_chk);
+            if (b != (uint8_t)(esperado >> (8 * p->chk_idx))) {
+                D_(reset)(p);
+                return FRAME_FAIL;
+            }
+            if (++p->chk_idx == chk_bytes(D_CHK)) p->estado = RX_WAIT_EOF;
+            break;
+        }
+
+        case RX_WAIT_EOF:
+            p->estado = RX_WAIT_SOF;
+            return (b == D_EOF) ? FRAME_OK : FRAME_FAIL;
+
+        default:                // RX_WAIT_LEN_EXT: dialetos nao tem quadro estendido
+            D_(reset)(p);
+            break;
+    }
+    return FRAME_PROGRESS;
+}
+
+// Bloco inteiro, como rx_handle_bytes(): memchr ate o SOF e payload em
+// bloco. Retorna o numero de quadros OK.
+static inline size_t D_(bytes)(D_(Porta)* p, const uint8_t* d, size_t n,
+                               RxQuadroFn cb, void* ctx) {
+    size_t i = 0, ok = 0;
+    while (i < n) {
+        if (p->estado == RX_WAIT_SOF) {
+            const uint8_t* s = memchr(&d[i], D_SOF, n - i);
+            if (!s) break;
+            i = (size_t)(s - d) + 1;
+            p->estado = RX_WAIT_LEN;
+        } else if (p->estado == RX_READ_DATA) {
+            size_t k = (size_t)(p->tamanho - p->pos);
+            if (k > n - i) k = n - i;
+            memcpy(&p->buf[p->pos], &d[i], k);
+            p->calc_chk = chk_atualiza(D_CHK, p->calc_chk, &d[i], k);
+            p->pos += (uint16_t)k;
+            i += k;
+            if (p->pos == p->tamanho) p->estado = RX_WAIT_CHK;
+        } else {
+            FrameResult r = D_(byte)(p, d[i]);
+            if (r == FRAME_OK) ok++;
+            if (r != FRAME_PROGRESS && cb) {
+                cb(ctx, r, i, r == FRAME_OK ? p->buf : NULL, r == FRAME_OK ? p->tamanho : 0);
+            }
+            i++;
+        }
+    }
+    return ok;
+}
+
+// Monta o quadro do dialeto em "buf" (n + 3 + chk_bytes bytes). Retorna o
+// tamanho do quadro, ou 0 se n passa do LEN maximo.
+static inline size_t D_(compose)(const D_(Porta)* p, const uint8_t* dados, uint8_t n,
+                                 uint8_t* buf) {
+    (void)p;
+    if (D_EXCEDE(n)) return 0;
+    uint32_t c = chk_inicia(D_CHK);
+    if (D_CHK_LEN) c = D_(chk_byte)(p, c, n);
+    c = chk_finaliza(D_CHK, chk_atualiza(D_CHK, c, dados, n));
+    buf[0] = D_SOF;
+    buf[1] = n;
+    memcpy(&buf[2], dados, n);
+    size_t idx = 2u + n;
+    for (uint8_t i = 0; i < chk_bytes(D_CHK); i++) buf[idx++] = (uint8_t)(c >> (8 * i));
+    buf[idx++] = D_EOF;
+    return idx;
+}
+
+#undef D_
+#undef D_NOME
+#undef D_SOF
+#undef D_EOF
+#undef D_MAX
+#undef D_CHK
+#undef D_CHK_LEN
+#undef D_BUF
+#undef D_EXCEDE
+#undef DIALETO
+#undef DIALETO_NOME
+#undef DIALETO_BUF
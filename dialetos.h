@@ -0,0 +1,41 @@
+/*
+ * dialetos.h
+ *
+ * Descritores dos dialetos de enquadramento (SOF LEN payload CHK EOF com
+ * constantes diferentes). Um descritor e uma lista de argumentos de
+ * macro, entao tudo se resolve em tempo de compilacao, inclusive em #if:
+ *
+ *   nome, SOF, EOF, payload maximo, CHK (ChkModo), CHK cobre o LEN
+ *
+ * ESPEC_ENLACE e o quadro de FSM.c e de Protothreads/main.c;
+ * ESPEC_PONTEIRO e o de "FSM e ponteiro/fsm.c" (STX/ETX, XOR sobre LEN e
+ * payload); ESPEC_RADIO e o da porta do radio (quadro curto, CRC-16).
+ * dialeto_rx.h instancia um receptor/transmissor por dialeto.
+ */
+
+#ifndef DIALETOS_H_
+#define DIALETOS_H_
+
+#define ESPEC_ENLACE    enlace,   0x02, 0x03, 255, CHK_XOR,   0
+#define ESPEC_PONTEIRO  ponteiro, 0x02, 0x03, 255, CHK_XOR,   1
+#define ESPEC_RADIO     radio,    0x7E, 0x7F, 64,  CHK_CRC16, 0
+
+/* Campos de um descritor: ESPEC_SOF(ESPEC_RADIO) == 0x7E */
+#define ESPEC_NOME_(n, s, f, m, c, l)   n
+#define ESPEC_SOF_(n, s, f, m, c, l)    s
+#define ESPEC_EOF_(n, s, f, m, c, l)    f
+#define ESPEC_MAX_(n, s, f, m, c, l)    m
+#define ESPEC_CHK_(n, s, f, m, c, l)    c
+#define ESPEC_CHK_LEN_(n, s, f, m, c, l) l
+#define ESPEC_NOME(e)     ESPEC_NOME_(e)
+#define ESPEC_SOF(e)      ESPEC_SOF_(e)
+#define ESPEC_EOF(e)      ESPEC_EOF_(e)
+#define ESPEC_MAX(e)      ESPEC_MAX_(e)
+#define ESPEC_CHK(e)      ESPEC_CHK_(e)
+#define ESPEC_CHK_LEN(e)  ESPEC_CHK_LEN_(e)
+
+/* Inicializador de RxEspec (dialeto escolhido em tempo de execucao) */
+#define ESPEC_RUNTIME_(n, s, f, m, c, l) {s, f, m, c, l}
+#define ESPEC_RUNTIME(e)  ESPEC_RUNTIME_(e)
+
+#endif /* DIALETOS_H_ */
@@ -0,0 +1,131 @@
+/*
+ * fec.h
+ *
+ * Correcao de erros (FEC) por bloco: Hamming SECDED (72,64). Cada bloco de
+ * 8 bytes ganha 1 byte de verificacao (12,5% a mais): 7 bits de Hamming,
+ * cujo valor e a soma (XOR) das posicoes dos bits de dado em 1, e 1 bit de
+ * paridade geral. Um bit errado por bloco e corrigido; dois sao detectados
+ * (e o quadro e descartado, como sem FEC). Tres ou mais podem passar como
+ * corrigidos errado: o CHK do quadro, conferido depois da correcao, pega.
+ *
+ * Os bits de dado ocupam as posicoes 3, 5, 6, 7, 9..15, 17..31, 33..63 e
+ * 65..71 (as que nao sao potencia de 2); FEC_POS(k) da a posicao do bit k.
+ *
+ * Duas implementacoes do byte de verificacao, com o mesmo resultado:
+ *  - fec_verif_tabela: tabela de 16 x 16 nibbles (256 bytes de flash), so
+ *    load e XOR, sem multiplicacao nem divisao (Cortex-M0+)
+ *  - fec_verif_palavra: 8 paridades de mascaras sobre uma palavra de 64
+ *    bits (host; no x86-64 a paridade e o flag PF)
+ * fec_verif() escolhe em tempo de compilacao.
+ */
+
+#ifndef FEC_H_
+#define FEC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define FEC_DADOS  8            /* bytes de dado por bloco */
+#define FEC_BLOCO  9            /* bytes no fio por bloco */
+/* blocos para n bytes de dado (o ultimo completado com zeros) */
+#define FEC_BLOCOS(n) (((n) + FEC_DADOS - 1) >> 3)
+
+#define FEC_POS(k) ((k) + 3 + ((k) >= 1) + ((k) >= 4) + ((k) >= 11) + ((k) >= 26) + ((k) >= 57))
+
+typedef enum {
+    FEC_OK,
+    FEC_CORRIGIDO,              /* um bit corrigido (dado ou verificacao) */
+    FEC_FALHA                   /* dois ou mais: bloco perdido */
+} FecResultado;
+
+/* [nibble do bloco][valor]: bits 0-6 = XOR das posicoes, bit 7 = paridade */
+static const uint8_t fec_nibble[16][16] = {
+    {0x00, 0x83, 0x85, 0x06, 0x86, 0x05, 0x03, 0x80, 0x87, 0x04, 0x02, 0x81, 0x01, 0x82, 0x84, 0x07},
+    {0x00, 0x89, 0x8A, 0x03, 0x8B, 0x02, 0x01, 0x88, 0x8C, 0x05, 0x06, 0x8F, 0x07, 0x8E, 0x8D, 0x04},
+    {0x00, 0x8D, 0x8E, 0x03, 0x8F, 0x02, 0x01, 0x8C, 0x91, 0x1C, 0x1F, 0x92, 0x1E, 0x93, 0x90, 0x1D},
+    {0x00, 0x92, 0x93, 0x01, 0x94, 0x06, 0x07, 0x95, 0x95, 0x07, 0x06, 0x94, 0x01, 0x93, 0x92, 0x00},
+    {0x00, 0x96, 0x97, 0x01, 0x98, 0x0E, 0x0F, 0x99, 0x99, 0x0F, 0x0E, 0x98, 0x01, 0x97, 0x96, 0x00},
+    {0x00, 0x9A, 0x9B, 0x01, 0x9C, 0x06, 0x07, 0x9D, 0x9D, 0x07, 0x06, 0x9C, 0x01, 0x9B, 0x9A, 0x00},
+    {0x00, 0x9E, 0x9F, 0x01, 0xA1, 0x3F, 0x3E, 0xA0, 0xA2, 0x3C, 0x3D, 0xA3, 0x03, 0x9D, 0x9C, 0x02},
+    {0x00, 0xA3, 0xA4, 0x07, 0xA5, 0x06, 0x01, 0xA2, 0xA6, 0x05, 0x02, 0xA1, 0x03, 0xA0, 0xA7, 0x04},
+    {0x00, 0xA7, 0xA8, 0x0F, 0xA9, 0x0E, 0x01, 0xA6, 0xAA, 0x0D, 0x02, 0xA5, 0x03, 0xA4, 0xAB, 0x0C},
+    {0x00, 0xAB, 0xAC, 0x07, 0xAD, 0x06, 0x01, 0xAA, 0xAE, 0x05, 0x02, 0xA9, 0x03, 0xA8, 0xAF, 0x04},
+    {0x00, 0xAF, 0xB0, 0x1F, 0xB1, 0x1E, 0x01, 0xAE, 0xB2, 0x1D, 0x02, 0xAD, 0x03, 0xAC, 0xB3, 0x1C},
+    {0x00, 0xB3, 0xB4, 0x07, 0xB5, 0x06, 0x01, 0xB2, 0xB6, 0x05, 0x02, 0xB1, 0x03, 0xB0, 0xB7, 0x04},
+    {0x00, 0xB7, 0xB8, 0x0F, 0xB9, 0x0E, 0x01, 0xB6, 0xBA, 0x0D, 0x02, 0xB5, 0x03, 0xB4, 0xBB, 0x0C},
+    {0x00, 0xBB, 0xBC, 0x07, 0xBD, 0x06, 0x01, 0xBA, 0xBE, 0x05, 0x02, 0xB9, 0x03, 0xB8, 0xBF, 0x04},
+    {0x00, 0xBF, 0xC1, 0x7E, 0xC2, 0x7D, 0x03, 0xBC, 0xC3, 0x7C, 0x02, 0xBD, 0x01, 0xBE, 0xC0, 0x7F},
+    {0x00, 0xC4, 0xC5, 0x01, 0xC6, 0x02, 0x03, 0xC7, 0xC7, 0x03, 0x02, 0xC6, 0x01, 0xC5, 0xC4, 0x00},
+};
+
+/* posicao (sindrome) -> bit de dado k; 255 = posicao de verificacao */
+static const uint8_t fec_bit[72] = {
+    255, 255, 255,   0, 255,   1,   2,   3, 255,   4,   5,   6,   7,   8,   9,  10,
+    255,  11,  12,  13,  14,  15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25,
+    255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,
+    255,  57,  58,  59,  60,  61,  62,  63,
+};
+
+/* paridade de um byte, sem tabela: 0x6996 e a paridade dos 16 nibbles */
+static inline uint8_t fec_paridade(uint8_t x) {
+    return (uint8_t)((0x6996u >> ((x ^ (x >> 4)) & 0x0F)) & 1u);
+}
+
+static inline uint8_t fec_verif_tabela(const uint8_t* d) {
+    uint8_t s = 0;
+    for (int i = 0; i < FEC_DADOS; i++) {
+        s ^= fec_nibble[2 * i][d[i] & 0x0F];
+        s ^= fec_nibble[2 * i + 1][d[i] >> 4];
+    }
+    return s;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+/* bit j da sindrome: dados cuja posicao tem o bit j (ver FEC_POS) */
+static const uint64_t fec_mascara[7] = {
+    0xAB55555556AAAD5BULL, 0xCD9999999B33366DULL, 0xF1E1E1E1E3C3C78EULL, 0x01FE01FE03FC07F0ULL,
+    0x01FFFE0003FFF800ULL, 0x01FFFFFFFC000000ULL, 0xFE00000000000000ULL,
+};
+
+static inline uint8_t fec_verif_palavra(const uint8_t* d) {
+    uint64_t w;
+    memcpy(&w, d, 8);                   /* little-endian: byte i = bits 8i.. */
+    uint8_t s = (uint8_t)(__builtin_parityll(w) << 7);
+    for (int j = 0; j < 7; j++) s |= (uint8_t)(__builtin_parityll(w & fec_mascara[j]) << j);
+    return s;
+}
+#define FEC_PALAVRA 1
+#endif
+
+/* Sindrome dos 8 bytes de dado (bits 0-6) e paridade deles (bit 7) */
+static inline uint8_t fec_verif(const uint8_t* d) {
+#if defined(FEC_PALAVRA)
+    return fec_verif_palavra(d);
+#else
+    return fec_verif_tabela(d);
+#endif
+}
+
+/* 8 bytes de dado -> 9 no fio (dados e o byte de verificacao) */
+static inline void fec_codifica(const uint8_t* d, uint8_t* out) {
+    uint8_t s = fec_verif(d);
+    memcpy(out, d, FEC_DADOS);
+    out[FEC_DADOS] = (uint8_t)(s ^ (fec_paridade(s & 0x7F) << 7));
+}
+
+/* Corrige os 8 bytes de dado de b[0..8] no lugar */
+static inline FecResultado fec_decodifica(uint8_t* b) {
+    uint8_t t = fec_verif(b), c = b[FEC_DADOS];
+    uint8_t s = (uint8_t)((t ^ c) & 0x7F);
+    uint8_t impar = (uint8_t)((t >> 7) ^ fec_paridade(c));   /* paridade dos 72 bits */
+    if (!impar) return s ? FEC_FALHA : FEC_OK;
+    if ((s & (s - 1)) == 0) return FEC_CORRIGIDO;           /* bit de verificacao */
+    if (s >= sizeof(fec_bit)) return FEC_FALHA;
+    uint8_t k = fec_bit[s];
+    b[k >> 3] ^= (uint8_t)(1u << (k & 7));
+    return FEC_CORRIGIDO;
+}
+
+#endif /* FEC_H_ */
@@ -0,0 +1,126 @@
+/*
+ * lzss.h
+ *
+ * Compressao LZSS para o payload dos quadros (FSM.c). A janela e de
+ * LZ_JANELA bytes e pode alcancar dados ja enviados antes do trecho
+ * comprimido (historico de quadros anteriores): telemetria repetitiva se
+ * parece mais com o quadro anterior do que consigo mesma.
+ *
+ * RAM: o compressor usa ~1,5 KB de indice de hash na pilha; o
+ * descompressor nao usa nada alem do buffer de saida.
+ *
+ * Formato: um byte de controle para cada 8 itens (bit i = 1: referencia,
+ * 0: literal, LSB primeiro), seguido dos itens:
+ *  - literal:    1 byte
+ *  - referencia: 2 bytes, distancia-1 (1..256) e comprimento-3 (3..258)
+ * Itens alinhados em byte: o laco de descompressao nao tem E/S de bits.
+ */
+
+#ifndef LZSS_H_
+#define LZSS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define LZ_JANELA   256   /* maior distancia de referencia */
+#define LZ_BUF_MAX  512   /* historico + trecho, no maximo */
+#define LZ_MIN      3
+#define LZ_MAX      (LZ_MIN + 255)
+#define LZ_CADEIA   8     /* candidatos examinados por posicao */
+
+static inline uint8_t lz_hash(const uint8_t* p) {
+    return (uint8_t)((p[0] << 5) ^ (p[1] << 2) ^ p[2] ^ (p[0] >> 3));
+}
+
+/* Comprime buf[ini..fim); buf[0..ini) e historico que as referencias podem
+   usar. Retorna o tamanho comprimido, ou 0 se fim > LZ_BUF_MAX ou a saida
+   nao couber em "cap" (o chamador envia o trecho cru). */
+static inline size_t lz_comprime(const uint8_t* buf, size_t ini, size_t fim,
+                                 uint8_t* out, size_t cap) {
+    uint16_t cabeca[256] = {0};   /* posicao+1 da ultima ocorrencia do hash */
+    uint16_t ant[LZ_BUF_MAX];     /* posicao+1 da ocorrencia anterior */
+    size_t o = 0, ctl = 0;
+    unsigned bit = 0;
+    if (fim > LZ_BUF_MAX || ini > fim) return 0;
+
+    size_t i = (ini > LZ_JANELA) ? ini - LZ_JANELA : 0;
+    for (; i < ini; i++) {   /* indexa o historico alcancavel */
+        if (i + LZ_MIN <= fim) {
+            uint8_t h = lz_hash(&buf[i]);
+            ant[i] = cabeca[h];
+            cabeca[h] = (uint16_t)(i + 1);
+        }
+    }
+    while (i < fim) {
+        if (bit == 0) {
+            if (o >= cap) return 0;
+            ctl = o++;
+            out[ctl] = 0;
+        }
+        size_t melhor = 0, dist = 0;
+        if (i + LZ_MIN <= fim) {
+            size_t lim = (fim - i < LZ_MAX) ? fim - i : LZ_MAX;
+            unsigned cand = cabeca[lz_hash(&buf[i])];
+            for (int c = 0; cand && c < LZ_CADEIA; c++, cand = ant[cand - 1]) {
+                size_t j = cand - 1, k = 0;
+                if (i - j > LZ_JANELA) break;   /* cadeia so fica mais longe */
+                while (k < lim && buf[j + k] == buf[i + k]) k++;
+                if (k > melhor) {
+                    melhor = k;
+                    dist = i - j;
+                    if (k == lim) break;
+                }
+            }
+        }
+        size_t passo = 1;
+        if (melhor >= LZ_MIN) {
+            if (o + 2 > cap) return 0;
+            out[ctl] |= (uint8_t)(1u << bit);
+            out[o++] = (uint8_t)(dist - 1);
+            out[o++] = (uint8_t)(melhor - LZ_MIN);
+            passo = melhor;
+        } else {
+            if (o >= cap) return 0;
+            out[o++] = buf[i];
+        }
+        for (size_t f = i + passo; i < f; i++) {   /* indexa o que consumiu */
+            if (i + LZ_MIN <= fim) {
+                uint8_t h = lz_hash(&buf[i]);
+                ant[i] = cabeca[h];
+                cabeca[h] = (uint16_t)(i + 1);
+            }
+        }
+        bit = (bit + 1) & 7;
+    }
+    return o;
+}
+
+/* Descomprime "n" bytes acrescentando a partir de buf[ini]; buf[0..ini) e o
+   mesmo historico usado na compressao. *fim recebe o fim da saida. Falha
+   com referencia antes do inicio de buf, item truncado ou saida alem de
+   "cap". */
+static inline bool lz_descomprime(const uint8_t* in, size_t n, uint8_t* buf,
+                                  size_t ini, size_t cap, size_t* fim) {
+    size_t i = 0, o = ini;
+    while (i < n) {
+        uint8_t ctl = in[i++];
+        for (unsigned bit = 0; bit < 8 && i < n; bit++) {
+            if (ctl & (1u << bit)) {
+                if (n - i < 2) return false;
+                size_t dist = (size_t)in[i] + 1, len = (size_t)in[i + 1] + LZ_MIN;
+                i += 2;
+                if (dist > o || len > cap - o) return false;
+                for (size_t k = 0; k < len; k++) buf[o + k] = buf[o - dist + k]; /* pode sobrepor */
+                o += len;
+            } else {
+                if (o >= cap) return false;
+                buf[o++] = in[i++];
+            }
+        }
+    }
+    *fim = o;
+    return true;
+}
+
+#endif /* LZSS_H_ */
@@ -0,0 +1,97 @@
+/*
+ * pool.h
+ *
+ * Pool de blocos de tamanho fixo para os payloads dos receptores (FSM.c
+ * com RX_POOL=1, "FSM e ponteiro/fsm.c" com FSM_POOL). Um receptor ocioso,
+ * procurando SOF, nao tem buffer: pega um bloco quando chega um LEN valido
+ * e devolve quando o quadro termina. Com N enlaces e B blocos a RAM de
+ * payload cai de N * FRAME_MAX para B * FRAME_MAX.
+ *
+ * Ate 32 blocos (mais que isso e limitado a 32); o mapa de ocupacao e um
+ * bitmap. Inicialize com POOL_INICIALIZA (estatico) ou pool_init(): um
+ * Pool zerado nao tem memoria nem blocos e pool_pega() sempre esgota.
+ *
+ * Esgotamento: pool_pega() devolve NULL e conta em "esgotado"; o receptor
+ * descarta o quadro ja no LEN, como um LEN invalido.
+ *
+ * Pool compartilhado entre contextos (ISRs de UARTs diferentes) precisa de
+ * exclusao: defina POOL_TRAVA()/POOL_DESTRAVA() antes de incluir, ex.
+ * cpu_irq_enter_critical()/cpu_irq_leave_critical() do ASF (rtos/).
+ */
+
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef POOL_TRAVA
+#define POOL_TRAVA()
+#define POOL_DESTRAVA()
+#endif
+
+typedef struct {
+    uint32_t pegos;         /* blocos emprestados */
+    uint32_t esgotado;      /* pedidos sem bloco livre */
+    uint8_t em_uso;
+    uint8_t pico;           /* maior em_uso desde o inicio */
+} PoolEstat;
+
+typedef struct {
+    uint8_t* mem;           /* qtd * tam bytes, do chamador */
+    uint16_t tam;           /* bytes por bloco */
+    uint8_t qtd;            /* 1..32 */
+    uint32_t ocupados;      /* bit i: bloco i emprestado */
+    PoolEstat est;
+} Pool;
+
+#define POOL_INICIALIZA(mem, tam, qtd) \
+    {(uint8_t*)(mem), (tam), (uint8_t)((qtd) > 32 ? 32 : (qtd)), 0, {0, 0, 0, 0}}
+
+static inline void pool_init(Pool* p, uint8_t* mem, uint16_t tam, uint8_t qtd) {
+    p->mem = mem;
+    p->tam = tam;
+    p->qtd = qtd > 32 ? 32 : qtd;
+    p->ocupados = 0;
+    p->est = (PoolEstat){0, 0, 0, 0};
+}
+
+/* Bloco livre de menor indice, ou NULL (pool esgotado) */
+static inline uint8_t* pool_pega(Pool* p) {
+    uint8_t* b = NULL;
+    POOL_TRAVA();
+    uint32_t todos = p->qtd >= 32 ? 0xFFFFFFFFu : (1u << p->qtd) - 1u;
+    uint32_t livres = ~p->ocupados & todos;
+    if (livres) {
+        unsigned i = (unsigned)__builtin_ctz(livres);
+        p->ocupados |= 1u << i;
+        b = &p->mem[(size_t)i * p->tam];
+        p->est.pegos++;
+        if (++p->est.em_uso > p->est.pico) p->est.pico = p->est.em_uso;
+    } else {
+        p->est.esgotado++;
+    }
+    POOL_DESTRAVA();
+    return b;
+}
+
+/* Devolver um bloco ja livre (liberacao dupla) nao faz nada */
+static inline void pool_devolve(Pool* p, uint8_t* b) {
+    unsigned i = (unsigned)((size_t)(b - p->mem) / p->tam);
+    POOL_TRAVA();
+    if (p->ocupados & (1u << i)) {
+        p->ocupados &= ~(1u << i);
+        p->est.em_uso--;
+    }
+    POOL_DESTRAVA();
+}
+
+/* Copia consistente dos contadores */
+static inline PoolEstat pool_estat(Pool* p) {
+    POOL_TRAVA();
+    PoolEstat e = p->est;
+    POOL_DESTRAVA();
+    return e;
+}
+
+#endif /* POOL_H_ */
@@ -12,8 +12,9 @@ stackptr_t	   ponteiro_de_pilha;
 prioridade_t       Prioridades[PRIORIDADE_MAXIMA+1];   /* vetor com as prioridades das tarefas */
 uint32_t	   SP;
 
-/* variavel auxiliar para guardar o numero de marcas de tempo */
-static tick_t contador_marcas = 0;
+/* variavel auxiliar para guardar o numero de marcas de tempo (escrita na
+   interrupcao do tick, lida por ContadorDeMarcas() no contexto das tarefas) */
+static volatile tick_t contador_marcas = 0;
 
 static uint8_t numero_tarefas = 0;
 
@@ -179,6 +180,13 @@ void ExecutaMarcaDeTempo(void)
 	 }
 }
 
+/* Valor atual do contador de marcas de tempo, para medir intervalos
+   (ex.: tempo maximo entre bytes no receptor de quadros) */
+tick_t ContadorDeMarcas(void)
+{
+	return contador_marcas;
+}
+
 /* Servicos de semaforos */
 void SemaforoAguarda(semaforo_t* sem)
 {
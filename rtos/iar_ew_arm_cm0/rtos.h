@@ -71,6 +71,7 @@ void CriaTarefa(tarefa_t p, const char * nome, stackptr_t pilha, uint16_t tamanh
 void IniciaMultitarefas(void);
 void ConfiguraMarcaTempo(void);
 void ExecutaMarcaDeTempo(void);
+tick_t ContadorDeMarcas(void);
 
 void TarefaSuspende(uint8_t id_tarefa);
 void TarefaContinua(uint8_t id_tarefa);